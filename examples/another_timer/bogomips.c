@@ -12,6 +12,8 @@ unsigned long calibrate_delay_converge(void)
 
 	lpj = (1<<12);
 
+	printk("Calibrating delay loop (cache=%d)...\n", mmu_is_enabled());
+
 	/* wait for "start of" clock tick */
 	ticks = jiffies;
 	while (ticks == jiffies)
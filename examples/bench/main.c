@@ -0,0 +1,135 @@
+#include <pmb887x.h>
+#include <printf.h>
+#include <string.h>
+#include <d1601aa.h>
+
+/*
+ * Standard benchmark suite, collect results with:
+ *   ../../tools/bench.pl run --out results.jsonl -- ./run.sh
+ */
+
+#define COPY_SIZE_SMALL		32
+#define COPY_SIZE_LARGE		4096
+
+static uint8_t copy_src[COPY_SIZE_LARGE] __attribute__((aligned(32)));
+static uint8_t copy_dst[COPY_SIZE_LARGE] __attribute__((aligned(32)));
+static char format_buffer[64];
+static volatile uint32_t sink;
+
+static void bench_cpu_loop(void *ctx) {
+	(void) ctx;
+	uint32_t cycles = 1000;
+	__asm__ volatile (
+		"1: \n"
+		"SUBS %0, #1\n"
+		"BNE 1b \n" : "+r" (cycles) : : "memory"
+	);
+}
+
+static void bench_memcpy(void *ctx) {
+	memcpy(copy_dst, copy_src, (uint32_t) ctx);
+}
+
+static void bench_memset(void *ctx) {
+	memset(copy_dst, 0x55, (uint32_t) ctx);
+}
+
+static void bench_sprintf(void *ctx) {
+	(void) ctx;
+	sprintf(format_buffer, "%d %08X %s", 123456789, 0xDEADBEEF, "test");
+}
+
+static void bench_i2c_read(void *ctx) {
+	(void) ctx;
+	sink = i2c_smbus_read_byte(D1601AA_I2C_ADDR, D1601AA_FAULT_REASON);
+}
+
+static void bench_uart_loopback(void *ctx) {
+	uint32_t usart = (uint32_t) ctx;
+	usart_putc(usart, 0x55);
+	sink = usart_getc(usart);
+}
+
+#ifdef GPIO_LED_FL_EN
+static void bench_gpio_toggle(void *ctx) {
+	(void) ctx;
+	gpio_toggle(GPIO_LED_FL_EN);
+}
+#endif
+
+// USART1 in internal loopback mode, TX/RX pins are not used
+static bool uart_loopback_init(uint32_t usart) {
+	USART_CLC(usart) = (1 << MOD_CLC_RMC_SHIFT);
+	USART_CON(usart) = USART_CON_M_ASYNC_8BIT | USART_CON_REN | USART_CON_LB;
+	usart_set_speed(usart, UART_SPEED_1600000);
+	USART_CON(usart) |= USART_CON_CON_R;
+
+	USART_ICR(usart) = USART_ICR_RX | USART_ICR_TX;
+	USART_TXB(usart) = 0x55;
+
+	stopwatch_t start = stopwatch_get();
+	while (!(USART_RIS(usart) & USART_RIS_RX)) {
+		if (stopwatch_elapsed_us(start) > 1000)
+			return false;
+	}
+
+	USART_ICR(usart) = USART_ICR_RX | USART_ICR_TX;
+	sink = USART_RXB(usart);
+	return true;
+}
+
+int main(void) {
+	wdt_init();
+	i2c_init();
+
+	for (uint32_t i = 0; i < sizeof(copy_src); i++)
+		copy_src[i] = i * 7;
+
+	static const struct bench_t benches[] = {
+		{ .name = "cpu_loop_1000",		.func = bench_cpu_loop },
+		{ .name = "memcpy_32",			.func = bench_memcpy, .ctx = (void *) COPY_SIZE_SMALL, .bytes = COPY_SIZE_SMALL },
+		{ .name = "memcpy_4096",		.func = bench_memcpy, .ctx = (void *) COPY_SIZE_LARGE, .bytes = COPY_SIZE_LARGE },
+		{ .name = "memset_4096",		.func = bench_memset, .ctx = (void *) COPY_SIZE_LARGE, .bytes = COPY_SIZE_LARGE },
+		{ .name = "sprintf_mixed",		.func = bench_sprintf },
+		{ .name = "i2c_smbus_read",		.func = bench_i2c_read, .iterations = 32 },
+	};
+
+	bench_begin("default");
+	bench_run_all(benches, ARRAY_SIZE(benches));
+
+	struct bench_result_t result;
+
+	if (uart_loopback_init(USART1)) {
+		struct bench_t uart_bench = { .name = "uart_loopback_byte", .func = bench_uart_loopback, .ctx = (void *) USART1, .iterations = 64 };
+		bench_run(&uart_bench, &result);
+	}
+
+#ifdef GPIO_LED_FL_EN
+	// Input mode: toggles the DATA latch only, pin is not driven
+	gpio_init_input(GPIO_LED_FL_EN, GPIO_IS_NONE, GPIO_PS_MANUAL, GPIO_PDPU_NONE, GPIO_ENAQ_OFF);
+	struct bench_t gpio_bench = { .name = "gpio_toggle", .func = bench_gpio_toggle };
+	bench_run(&gpio_bench, &result);
+#endif
+
+	bench_end();
+
+	while (true)
+		wdt_serve();
+
+	return 0;
+}
+
+__IRQ void data_abort_handler(void) {
+	printf("data_abort_handler\n");
+	while (true);
+}
+
+__IRQ void undef_handler(void) {
+	printf("undef_handler\n");
+	while (true);
+}
+
+__IRQ void prefetch_abort_handler(void) {
+	printf("prefetch_abort_handler\n");
+	while (true);
+}
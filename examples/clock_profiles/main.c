@@ -0,0 +1,70 @@
+#include <pmb887x.h>
+#include <printf.h>
+
+/*
+ * Switches between PLL profiles, UART output and stopwatch must stay correct after every switch.
+ */
+
+#define WORK_ITERATIONS		2000000
+
+static uint32_t __attribute__((noinline)) compute(uint32_t n) {
+	uint32_t x = 1;
+	for (uint32_t i = 0; i < n; i++)
+		x = x * 1103515245 + 12345;
+	return x;
+}
+
+static void run_profile(const char *name, enum cpu_clock_profile_t profile) {
+	cpu_set_clock_profile(profile);
+
+	printf("%s: fCPU=%d MHz, fAHB=%d MHz, fSYS=%d MHz, fSTM=%d MHz\n", name,
+		cpu_get_freq() / 1000000, cpu_get_ahb_freq() / 1000000, cpu_get_sys_freq() / 1000000, cpu_get_stm_freq() / 1000000);
+
+	wdt_serve();
+	stopwatch_t start = stopwatch_get();
+	uint32_t result = compute(WORK_ITERATIONS);
+	uint32_t elapsed = stopwatch_elapsed_us(start);
+	wdt_serve();
+
+	printf("  compute: %d us (%08X)\n", elapsed, result);
+
+	// 100 ms by stopwatch, compare with a stopwatch on the host side
+	start = stopwatch_get();
+	stopwatch_msleep_wd(100);
+	printf("  100 ms sleep: %d us\n", stopwatch_elapsed_us(start));
+}
+
+int main(void) {
+	wdt_init();
+
+	printf("Clock profiles test\n");
+
+	run_profile("default", CPU_CLOCK_PROFILE_DEFAULT);
+	run_profile("104 MHz", CPU_CLOCK_PROFILE_104MHZ);
+	run_profile("208 MHz", CPU_CLOCK_PROFILE_208MHZ);
+	run_profile("260 MHz", CPU_CLOCK_PROFILE_260MHZ);
+	run_profile("312 MHz", CPU_CLOCK_PROFILE_312MHZ);
+	run_profile("default", CPU_CLOCK_PROFILE_DEFAULT);
+
+	printf("Done!\n");
+
+	while (true)
+		wdt_serve();
+
+	return 0;
+}
+
+__IRQ void data_abort_handler(void) {
+	printf("data_abort_handler\n");
+	while (true);
+}
+
+__IRQ void undef_handler(void) {
+	printf("undef_handler\n");
+	while (true);
+}
+
+__IRQ void prefetch_abort_handler(void) {
+	printf("prefetch_abort_handler\n");
+	while (true);
+}
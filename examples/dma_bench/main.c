@@ -0,0 +1,129 @@
+#include <pmb887x.h>
+#include <printf.h>
+#include <string.h>
+
+#define BUF_SIZE		(2 * 1024 * 1024)
+
+static uint8_t src_buf[BUF_SIZE] __attribute__((aligned(32)));
+static uint8_t dst_buf[BUF_SIZE] __attribute__((aligned(32)));
+
+static struct dma_mem_t dma;
+
+// Returns speed in 0.01 MB/s
+static uint32_t calc_speed(uint32_t size, uint32_t elapsed) {
+	if (!elapsed)
+		elapsed = 1;
+	return ((uint64_t) size * 100) / elapsed;
+}
+
+static void print_speed(const char *title, uint32_t speed) {
+	printf(" %s %5d.%02d MB/s", title, speed / 100, speed % 100);
+}
+
+static uint32_t bench_cpu_memcpy(uint32_t size) {
+	wdt_serve();
+	stopwatch_t start = stopwatch_get();
+	memcpy(dst_buf, src_buf, size);
+	return calc_speed(size, stopwatch_elapsed_us(start));
+}
+
+static uint32_t bench_cpu_memset(uint32_t size) {
+	wdt_serve();
+	stopwatch_t start = stopwatch_get();
+	memset(dst_buf, 0x55, size);
+	return calc_speed(size, stopwatch_elapsed_us(start));
+}
+
+// CPU spins in a counting loop while DMA is working, shows how much CPU time is left for other work
+static uint32_t bench_dma(bool is_memset, uint32_t size, uint32_t *idle_loops) {
+	wdt_serve();
+	stopwatch_t start = stopwatch_get();
+	if (is_memset) {
+		dma_memset_async(&dma, dst_buf, 0x55, size);
+	} else {
+		dma_memcpy_async(&dma, dst_buf, src_buf, size);
+	}
+	
+	uint32_t loops = 0;
+	while (!dma_mem_is_done(&dma))
+		loops++;
+	uint32_t elapsed = stopwatch_elapsed_us(start);
+	
+	if (dma.error)
+		printf("DMA error!\n");
+	
+	*idle_loops = loops;
+	return calc_speed(size, elapsed);
+}
+
+static void check_dma_copy(uint32_t dst_offset, uint32_t src_offset, uint32_t size) {
+	memset(dst_buf, 0, size + 8);
+	dma_memcpy_async(&dma, dst_buf + dst_offset, src_buf + src_offset, size);
+	dma_mem_wait(&dma);
+	if (memcmp(dst_buf + dst_offset, src_buf + src_offset, size) != 0 || dst_buf[dst_offset + size] != 0) {
+		printf("dma_memcpy self-test failed! (dst+%d, src+%d)\n", dst_offset, src_offset);
+		while (true)
+			wdt_serve();
+	}
+}
+
+int main(void) {
+	wdt_init();
+	dmac_init();
+	cpu_enable_irq(true);
+	
+	static const uint32_t sizes[] = { 256, 1024, 4096, 16384, 65536, 262144, 1048576, 2097152 };
+	
+	for (uint32_t i = 0; i < sizeof(src_buf); i++)
+		src_buf[i] = i * 7;
+	
+	for (uint32_t dst_offset = 0; dst_offset < 4; dst_offset++) {
+		for (uint32_t src_offset = 0; src_offset < 4; src_offset++)
+			check_dma_copy(dst_offset, src_offset, 70000);
+	}
+	
+	printf("DMA benchmark, cpu: %d MHz, ahb: %d MHz\n", cpu_get_freq() / 1000000, cpu_get_ahb_freq() / 1000000);
+	
+	for (uint32_t i = 0; i < ARRAY_SIZE(sizes); i++) {
+		uint32_t size = sizes[i];
+		uint32_t memcpy_idle, memset_idle;
+		
+		printf("%7d bytes:", size);
+		print_speed("cpu memcpy", bench_cpu_memcpy(size));
+		print_speed("dma memcpy", bench_dma(false, size, &memcpy_idle));
+		print_speed("cpu memset", bench_cpu_memset(size));
+		print_speed("dma memset", bench_dma(true, size, &memset_idle));
+		printf(" idle loops: %d/%d\n", memcpy_idle, memset_idle);
+	}
+	
+	printf("Done!\n");
+	
+	while (true)
+		wdt_serve();
+	
+	return 0;
+}
+
+__IRQ void irq_handler(void) {
+	int irqn = NVIC_CURRENT_IRQ;
+	
+	if (irqn >= NVIC_DMAC_ERR_IRQ && irqn <= NVIC_DMAC_CH7_IRQ)
+		dmac_irq();
+	
+	NVIC_IRQ_ACK = 1;
+}
+
+__IRQ void data_abort_handler(void) {
+	printf("data_abort_handler\n");
+	while (true);
+}
+
+__IRQ void undef_handler(void) {
+	printf("undef_handler\n");
+	while (true);
+}
+
+__IRQ void prefetch_abort_handler(void) {
+	printf("prefetch_abort_handler\n");
+	while (true);
+}
@@ -1,74 +1,60 @@
 #include <pmb887x.h>
 
+static volatile bool transfer_done = false;
+static volatile bool transfer_error = false;
+
+static void dma_callback(int ch, bool error, void *ctx) {
+	(void) ch;
+	(void) ctx;
+	transfer_error = error;
+	transfer_done = true;
+}
+
 int main(void) {
 	wdt_init();
-	cpu_enable_irq(false);
 	
-	uint8_t src[8 * 4] = {
+	static uint8_t src[8 * 4] = {
 		1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
 		1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16
 	};
-	uint8_t dst[8 * 4] = {
+	static uint8_t dst[8 * 4] = {
 		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
 		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
 	};
 	
-	int ch = 1;
+	dmac_init();
+	cpu_enable_irq(true);
 	
-	DMAC_CONFIG = 0;
+	int ch = dmac_alloc(false);
+	dmac_set_callback(ch, dma_callback, NULL);
 	
-	SCU_DMARS = 1 << ch;
+	// Scatter-gather: swap halves of the buffer
+	struct dmac_iovec_t iov[] = {
+		{ (uint32_t) &src[16], (uint32_t) &dst[0], 16 },
+		{ (uint32_t) &src[0], (uint32_t) &dst[16], 16 },
+	};
+	struct dmac_lli_t lli[4];
 	
-	DMAC_CH_SRC_ADDR(ch) = (uint32_t) &src;
-	DMAC_CH_DST_ADDR(ch) = (uint32_t) &dst;
-	DMAC_CH_CONTROL(ch) =
-		(4 << DMAC_CH_CONTROL_TRANSFER_SIZE_SHIFT) |
-		DMAC_CH_CONTROL_SB_SIZE_SZ_256 |
-		DMAC_CH_CONTROL_DB_SIZE_SZ_256 |
-		DMAC_CH_CONTROL_S_WIDTH_WORD |
+	int lli_cnt = dmac_build_lli(lli, ARRAY_SIZE(lli), iov, ARRAY_SIZE(iov),
+		DMAC_CH_CONTROL_SB_SIZE_SZ_4 |
+		DMAC_CH_CONTROL_DB_SIZE_SZ_4 |
+		DMAC_CH_CONTROL_S_WIDTH_DWORD |
 		DMAC_CH_CONTROL_D_WIDTH_DWORD |
 		DMAC_CH_CONTROL_S_AHB2 |
 		DMAC_CH_CONTROL_D_AHB2 |
 		DMAC_CH_CONTROL_SI |
-		DMAC_CH_CONTROL_DI |
-		DMAC_CH_CONTROL_I;
-	DMAC_CH_CONFIG(ch) =
-		(8 << DMAC_CH_CONFIG_DST_PERIPH_SHIFT) |
-		DMAC_CH_CONFIG_FLOW_CTRL_MEM2PER |
-		DMAC_CH_CONFIG_INT_MASK_ERR |
-		DMAC_CH_CONFIG_INT_MASK_TC;
-	
-	// DMAC_CH_LLI(ch) = 1 << DMAC_CH_LLI_ITEM_SHIFT;
-	
-	printf("SRC: %08X\n", DMAC_CH_SRC_ADDR(ch));
-	printf("DST: %08X\n", DMAC_CH_DST_ADDR(ch));
-	printf("TS: %08X\n", (DMAC_CH_CONTROL(ch) & DMAC_CH_CONTROL_TRANSFER_SIZE) >> DMAC_CH_CONTROL_TRANSFER_SIZE_SHIFT);
-	
-	DMAC_CONFIG = DMAC_CONFIG_ENABLE;
+		DMAC_CH_CONTROL_DI);
 	
-	DMAC_CH_CONFIG(ch) |= DMAC_CH_CONFIG_ENABLE;
+	printf("ch=%d, lli_cnt=%d\n", ch, lli_cnt);
 	
-	NVIC_CON(NVIC_DMAC_ERR_IRQ) = 1;
-	NVIC_CON(NVIC_DMAC_CH0_IRQ) = 1;
+	dmac_start(ch, lli, lli_cnt, DMAC_CH_CONFIG_FLOW_CTRL_MEM2MEM);
 	
-	while (!(DMAC_RAW_TC_STATUS & (1 << ch))) {
-		if (DMAC_ERR_STATUS) {
-			printf("ERR=%08X\n", DMAC_ERR_STATUS);
-			// DMAC_ERR_CLEAR = DMAC_ERR_STATUS;
-			printf("irqn: %d\n", NVIC_CURRENT_IRQ);
-			break;
-		}
-	}
+	while (!transfer_done)
+		wdt_serve();
 	
-	printf("irqn: %d\n", NVIC_CURRENT_IRQ);
+	printf("done, error=%d\n", transfer_error);
 	
-	DMAC_TC_CLEAR = (1 << ch);
-	
-	stopwatch_msleep(10);
-	
-	printf("SRC: %08X\n", DMAC_CH_SRC_ADDR(ch));
-	printf("DST: %08X\n", DMAC_CH_DST_ADDR(ch));
-	printf("TS: %08X\n", (DMAC_CH_CONTROL(ch) & DMAC_CH_CONTROL_TRANSFER_SIZE) >> DMAC_CH_CONTROL_TRANSFER_SIZE_SHIFT);
+	dmac_free(ch);
 	
 	printf("src: ");
 	for (size_t i = 0; i < ARRAY_SIZE(src); i++)
@@ -83,6 +69,15 @@ int main(void) {
 	return 0;
 }
 
+__IRQ void irq_handler(void) {
+	int irqn = NVIC_CURRENT_IRQ;
+	
+	if (irqn >= NVIC_DMAC_ERR_IRQ && irqn <= NVIC_DMAC_CH7_IRQ)
+		dmac_irq();
+	
+	NVIC_IRQ_ACK = 1;
+}
+
 __IRQ void data_abort_handler(void) {
 	printf("data_abort_handler\n");
 	while (true);
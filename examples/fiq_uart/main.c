@@ -0,0 +1,60 @@
+#include <pmb887x.h>
+#include <printf.h>
+
+/*
+ * USART0 RX at 1.6 Mbaud through the FIQ fast path.
+ * Send a continuous stream from the host, received bytes/s and ring overflows are printed every second.
+ */
+
+static uint8_t rx_buffer[0x8000];
+
+int main(void) {
+	wdt_init();
+
+	USART_CON(USART0) = (USART_CON(USART0) & ~USART_CON_M) | USART_CON_M_ASYNC_8BIT;
+
+	printf("Switching to 1.6 Mbaud...\n");
+	stopwatch_msleep(10);
+	usart_set_speed(USART0, UART_SPEED_1600000);
+
+	// Half of the FIQ FIFO for a trigger: leaves 4 bytes (25 us) for FIQ latency
+	fiq_usart_rx_init(USART0, rx_buffer, sizeof(rx_buffer), USART_FIFO_SIZE / 2, 32);
+
+	uint32_t total = 0;
+	uint32_t last_total = 0;
+	uint32_t checksum = 0;
+	stopwatch_t last_report = stopwatch_get();
+
+	while (true) {
+		uint8_t buffer[256];
+		size_t size = fiq_read(buffer, sizeof(buffer));
+		for (size_t i = 0; i < size; i++)
+			checksum += buffer[i];
+		total += size;
+
+		if (stopwatch_elapsed_ms(last_report) >= 1000) {
+			printf("total=%d, rate=%d bytes/s, dropped=%d, checksum=%08X\n", total, total - last_total, fiq_get_dropped(), checksum);
+			last_total = total;
+			last_report = stopwatch_get();
+		}
+
+		wdt_serve();
+	}
+
+	return 0;
+}
+
+__IRQ void data_abort_handler(void) {
+	printf("data_abort_handler\n");
+	while (true);
+}
+
+__IRQ void undef_handler(void) {
+	printf("undef_handler\n");
+	while (true);
+}
+
+__IRQ void prefetch_abort_handler(void) {
+	printf("prefetch_abort_handler\n");
+	while (true);
+}
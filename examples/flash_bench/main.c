@@ -0,0 +1,124 @@
+#include <pmb887x.h>
+#include <printf.h>
+#include <string.h>
+
+/*
+ * NOR flash geometry, erase time and word vs buffered program throughput.
+ * Test cases destroy one block, set TEST_BLOCK_ADDR to a free block (e.g. FFS area) to enable them.
+ * Use BOOT=intram or BOOT=extram: the app must not run from the flash it writes.
+ */
+
+#define FLASH_BASE			0xA0000000
+#define TEST_BLOCK_ADDR		0
+#define TEST_SIZE			(64 * 1024)
+
+static uint16_t pattern[TEST_SIZE / 2];
+static uint16_t readback[256];
+
+static const char *flash_types[] = { "Intel", "AMD" };
+
+static void print_kbs(const char *name, uint32_t size, uint32_t us) {
+	printf("%s: %d bytes in %d us, %d KB/s\n", name, size, us, us ? (uint32_t) ((uint64_t) size * 1000000 / 1024 / us) : 0);
+}
+
+static int test_program(struct flash_t *flash, uint32_t addr, uint32_t size, bool buffered) {
+	uint32_t write_buffer_size = flash->write_buffer_size;
+	int ret = flash_erase(flash, addr);
+	if (ret)
+		return ret;
+
+	if (!buffered)
+		flash->write_buffer_size = 0;
+	stopwatch_t start = stopwatch_get();
+	ret = flash_program(flash, addr, pattern, size);
+	uint32_t elapsed = stopwatch_elapsed_us(start);
+	flash->write_buffer_size = write_buffer_size;
+
+	if (!ret)
+		print_kbs(buffered ? "buffer program" : "word program", size, elapsed);
+	return ret;
+}
+
+static int test_suspend(struct flash_t *flash, uint32_t addr) {
+	uint32_t reads = 0;
+	int ret = flash_erase_async(flash, addr);
+	if (ret)
+		return ret;
+
+	// Block next to the erased one is in the same bank in most cases
+	uint32_t read_addr = addr > flash->base ? addr - sizeof(readback) : addr + TEST_SIZE;
+	stopwatch_t start = stopwatch_get();
+	while ((ret = flash_erase_poll(flash)) == FLASH_ERR_BUSY) {
+		flash_read(flash, readback, read_addr, sizeof(readback));
+		reads++;
+		wdt_serve();
+	}
+	printf("async erase: %d ms, %d suspended reads, ret=%d\n", stopwatch_elapsed_ms(start), reads, ret);
+	return ret;
+}
+
+int main(void) {
+	wdt_init();
+
+	struct flash_t flash;
+	int ret = flash_init(&flash, FLASH_BASE);
+	if (ret) {
+		printf("flash_init error: %d\n", ret);
+		while (true)
+			wdt_serve();
+	}
+
+	printf("Flash: %s, cmdset %04X, PRI %d.%d, ID %04X:%04X, %d MB\n", flash_types[flash.type], flash.cmdset,
+		flash.pri_version >> 8, flash.pri_version & 0xFF, flash.vid, flash.pid, flash.size / 1024 / 1024);
+	printf("Write buffer: %d bytes, erase suspend: %d, program suspend: %d\n", flash.write_buffer_size,
+		flash.erase_suspend, flash.program_suspend);
+	printf("Max time: word %d us, buffer %d us, block erase %d ms\n", flash.word_program_us,
+		flash.buffer_program_us, flash.block_erase_ms);
+	for (uint32_t i = 0; i < flash.erase_regions_cnt; i++)
+		printf("Erase region %d: %d x %d KB\n", i, flash.erase_regions[i].count, flash.erase_regions[i].size / 1024);
+	for (uint32_t i = 0; i < flash.bank_regions_cnt; i++)
+		printf("Bank region %d: %d x %d KB\n", i, flash.bank_regions[i].count, flash.bank_regions[i].size / 1024);
+
+#if TEST_BLOCK_ADDR
+	uint32_t block_start, block_size;
+	if (!flash_get_block(&flash, TEST_BLOCK_ADDR, &block_start, &block_size) || block_start != TEST_BLOCK_ADDR) {
+		printf("TEST_BLOCK_ADDR is not a block start\n");
+	} else {
+		uint32_t size = MIN(block_size, TEST_SIZE);
+		for (uint32_t i = 0; i < ARRAY_SIZE(pattern); i++)
+			pattern[i] = i * 0x9E37;
+
+		stopwatch_t start = stopwatch_get();
+		ret = flash_erase(&flash, block_start);
+		printf("erase %d KB: %d ms, ret=%d\n", block_size / 1024, stopwatch_elapsed_ms(start), ret);
+
+		if (!ret)
+			ret = test_program(&flash, block_start, size, false);
+		if (!ret && flash.write_buffer_size)
+			ret = test_program(&flash, block_start, size, true);
+		if (!ret)
+			ret = test_suspend(&flash, block_start);
+		printf("ret=%d\n", ret);
+	}
+#endif
+
+	while (true)
+		wdt_serve();
+
+	return 0;
+}
+
+__IRQ void data_abort_handler(void) {
+	printf("data_abort_handler\n");
+	while (true);
+}
+
+__IRQ void undef_handler(void) {
+	printf("undef_handler\n");
+	while (true);
+}
+
+__IRQ void prefetch_abort_handler(void) {
+	printf("prefetch_abort_handler\n");
+	while (true);
+}
@@ -0,0 +1,7 @@
+#!/bin/bash
+# Same BOOT as used for "make BOOT=..."; the app must not run from the flash it writes
+if [ "$BOOT" == "extram" ]; then
+	perl ../../chaos-boot.pl --exec=app.bin --exec-addr=0xA8000000 --ign $@
+else
+	perl ../../boot.pl --boot=app.bin $@
+fi
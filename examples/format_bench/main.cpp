@@ -0,0 +1,89 @@
+#include <pmb887x.h>
+#include <printf.h>
+#include <format.hpp>
+
+/*
+ * Runtime format parser (snprintf) vs compile-time format (fmt::format), see "median_cycles" in the output.
+ *   ../../tools/bench.pl run --out format.jsonl -- ./run.sh
+ */
+
+#define VALUE		((void *) 123456789)
+
+static char buffer[64];
+
+static void bench_snprintf_hex(void *ctx) {
+	uint32_t value = (uint32_t) ctx;
+	snprintf(buffer, sizeof(buffer), "%08X: %08X (from %08X)\n", value, value ^ 0xFF, value + 4);
+}
+
+static void bench_fmt_hex(void *ctx) {
+	uint32_t value = (uint32_t) ctx;
+	fmt::format(buffer, sizeof(buffer), FMT("%08X: %08X (from %08X)\n"), value, value ^ 0xFF, value + 4);
+}
+
+static void bench_snprintf_dec(void *ctx) {
+	snprintf(buffer, sizeof(buffer), "value=%u, delta=%d", (uint32_t) ctx, -(int32_t) ctx);
+}
+
+static void bench_fmt_dec(void *ctx) {
+	fmt::format(buffer, sizeof(buffer), FMT("value=%u, delta=%d"), (uint32_t) ctx, -(int32_t) ctx);
+}
+
+static void bench_snprintf_u64(void *ctx) {
+	snprintf(buffer, sizeof(buffer), "t=%llu", (uint64_t) (uint32_t) ctx * 1000000007ULL);
+}
+
+static void bench_fmt_u64(void *ctx) {
+	fmt::format(buffer, sizeof(buffer), FMT("t=%llu"), (uint64_t) (uint32_t) ctx * 1000000007ULL);
+}
+
+static void bench_snprintf_str(void *ctx) {
+	(void) ctx;
+	snprintf(buffer, sizeof(buffer), "[%8s] %s", "usart", "tx done");
+}
+
+static void bench_fmt_str(void *ctx) {
+	(void) ctx;
+	fmt::format(buffer, sizeof(buffer), FMT("[%8s] %s"), "usart", "tx done");
+}
+
+int main(void) {
+	wdt_init();
+
+	static const struct bench_t benches[] = {
+		{ "snprintf_hex",	bench_snprintf_hex,	VALUE, 0, 0, 0 },
+		{ "fmt_hex",		bench_fmt_hex,		VALUE, 0, 0, 0 },
+		{ "snprintf_dec",	bench_snprintf_dec,	VALUE, 0, 0, 0 },
+		{ "fmt_dec",		bench_fmt_dec,		VALUE, 0, 0, 0 },
+		{ "snprintf_u64",	bench_snprintf_u64,	VALUE, 0, 0, 0 },
+		{ "fmt_u64",		bench_fmt_u64,		VALUE, 0, 0, 0 },
+		{ "snprintf_str",	bench_snprintf_str,	VALUE, 0, 0, 0 },
+		{ "fmt_str",		bench_fmt_str,		VALUE, 0, 0, 0 },
+	};
+
+	bench_begin("format");
+	bench_run_all(benches, ARRAY_SIZE(benches));
+	bench_end();
+
+	fmt::print(FMT("stopwatch_get() = %llu, &buffer = %p\n"), stopwatch_get(), buffer);
+
+	while (true)
+		wdt_serve();
+
+	return 0;
+}
+
+__IRQ void data_abort_handler(void) {
+	fmt::print(FMT("data_abort_handler\n"));
+	while (true);
+}
+
+__IRQ void undef_handler(void) {
+	fmt::print(FMT("undef_handler\n"));
+	while (true);
+}
+
+__IRQ void prefetch_abort_handler(void) {
+	fmt::print(FMT("prefetch_abort_handler\n"));
+	while (true);
+}
@@ -2,25 +2,6 @@
 #include <d1601aa.h>
 #include <printf.h>
 
-struct i2c_state_t {
-	bool is_write;
-	uint8_t addr;
-	uint8_t *buffer;
-	int size;
-	bool addr_sent;
-	int code;
-};
-
-enum {
-	ERR_SUCCESS		= 0,
-	ERR_BUSY		= -1,
-	ERR_OVERFLOW	= -2,
-	ERR_UNDERFLOW	= -3,
-	ERR_NACK		= -4
-};
-
-static volatile struct i2c_state_t i2c_state = {0};
-
 static void dump_all_regs(void) {
 	printf("Dump all Dialog registers...\n");
 	for (int i = 0; i <= 0xFF; ++i) {
@@ -29,6 +10,16 @@ static void dump_all_regs(void) {
 		wdt_serve();
 	}
 }
+
+static volatile uint32_t async_done = 0;
+
+static void async_callback(struct i2c_hw_xfer_t *xfer, void *ctx) {
+	(void) xfer;
+	(void) ctx;
+	async_done++;
+}
+
+// How stock firmware drives I2C module:
 /*
 
  READ[4] F4300090: 00008200 (GPIO_PIN28_I2C_SCL): IS(NONE) | OS(NONE) | PS(ALT) | DATA(HIGH) | DIR(IN) | PPEN(PUSHPULL) | PDPU(NONE) | ENAQ(ON) (PC: A04D1A44, LR: A04D1A44)
@@ -67,265 +58,44 @@ WRITE[4] F760002C: 00000001 (I2C_MRPSCTRL): MRPS(0x01) (PC: A057A58C, LR: 000000
 WRITE[4] F7600034: 00000001 (I2C_TPSCTRL): TPS(0x01) (PC: A057A58C, LR: 00000001)
  READ[4] F7600074: 00000000 (I2C_PIRQSS) (PC: A057AAC8, LR: 00000001)
 */
-static void i2c_hw_init(void) {
-	GPIO_PIN(GPIO_I2C_SCL) = GPIO_IS_ALT0 | GPIO_OS_ALT0 | GPIO_PPEN_OPENDRAIN | GPIO_PS_ALT | GPIO_DIR_IN;
-	GPIO_PIN(GPIO_I2C_SDA) = GPIO_IS_ALT0 | GPIO_OS_ALT0 | GPIO_PPEN_OPENDRAIN | GPIO_PS_ALT | GPIO_DIR_IN;
-	
-	I2C_CLC = 0xFF << MOD_CLC_RMC_SHIFT;
-	I2C_RUNCTRL = 0;
-	I2C_ADDRCFG = I2C_ADDRCFG_MnS;
-	I2C_FIFOCFG = I2C_FIFOCFG_RXBS_4_WORD | I2C_FIFOCFG_TXBS_4_WORD | I2C_FIFOCFG_RXFA_BYTE | I2C_FIFOCFG_TXFA_BYTE | I2C_FIFOCFG_RXFC | I2C_FIFOCFG_TXFC;
-	I2C_FDIVCFG = (0x3D << I2C_FDIVCFG_DEC_SHIFT) | (0x04 << I2C_FDIVCFG_INC_SHIFT);
-	I2C_RUNCTRL = I2C_RUNCTRL_RUN;
-}	
-
-static void i2c_hw_write_fifo(uint32_t value, int offset) {
-	if (!i2c_state.size) {
-		printf("WTF, internal buffer underflow\n");
-		while (true);
-	}
-	
-	int size = MIN(4 - offset, i2c_state.size);
-	for (int i = 0; i < size; i++) {
-		value |= *i2c_state.buffer++ << (8 * (offset + i));
-		i2c_state.size--;
-	}
-	
-	I2C_TXD = value;
-}
-
-static void i2c_hw_read_fifo(void) {
-	while (I2C_FFSSTAT > 0) {
-		if (!i2c_state.size) {
-			printf("WTF, internal buffer underflow\n");
-			while (true);
-		}
-		
-		printf("I2C_FFSSTAT=%d\n", I2C_FFSSTAT);
-		
-		uint32_t value = I2C_RXD;
-		int size = MIN(4, i2c_state.size);
-		for (int i = 0; i < size; i++) {
-			*i2c_state.buffer++ = (value >> (8 * i));
-			i2c_state.size--;
-		}
-	}
-}
-
-__IRQ void irq_handler(void) {
-	int irqn = NVIC_CURRENT_IRQ;
-	
-	if (irqn == NVIC_I2C_ERROR_IRQ) {
-		printf("-> NVIC_I2C_ERROR_IRQ\n");
-		if ((I2C_ERRIRQSS & I2C_ERRIRQSS_RXF_UFL)) {
-			printf("I2C_ERRIRQSS_RXF_UFL\n");
-			i2c_state.code = ERR_UNDERFLOW;
-			I2C_ERRIRQSC = I2C_ERRIRQSC_RXF_UFL;
-		} else if ((I2C_ERRIRQSS & I2C_ERRIRQSS_RXF_OFL)) {
-			printf("I2C_ERRIRQSS_RXF_OFL\n");
-			i2c_state.code = ERR_OVERFLOW;
-			I2C_ERRIRQSC = I2C_ERRIRQSC_RXF_OFL;
-		} else if ((I2C_ERRIRQSS & I2C_ERRIRQSS_TXF_UFL)) {
-			printf("I2C_ERRIRQSS_TXF_UFL\n");
-			i2c_state.code = ERR_UNDERFLOW;
-			I2C_ERRIRQSC = I2C_ERRIRQSC_TXF_UFL;
-		} else if ((I2C_ERRIRQSS & I2C_ERRIRQSS_TXF_OFL)) {
-			printf("I2C_ERRIRQSS_TXF_OFL\n");
-			i2c_state.code = ERR_OVERFLOW;
-			I2C_ERRIRQSC = I2C_ERRIRQSC_TXF_OFL;
-		} else {
-			printf("Unknown I2C_ERRIRQSS: %08X\n", I2C_ERRIRQSS);
-			while (true);
-		}
-	} else if (irqn == NVIC_I2C_BURST_REQ_IRQ) {
-		printf("-> NVIC_I2C_BURST_REQ_IRQ\n");
-		if ((I2C_RIS & I2C_RIS_BREQ_INT)) {
-			if ((i2c_state.addr & 1)) {
-				i2c_hw_read_fifo();
-			} else {
-				i2c_hw_write_fifo(0, 0);
-			}
-			I2C_ICR = I2C_ICR_BREQ_INT;
-		} else {
-			printf("Unknown I2C_RIS: %08X\n", I2C_RIS);
-			while (true);
-		}
-	} else if (irqn == NVIC_I2C_SINGLE_REQ_IRQ) {
-		printf("-> NVIC_I2C_SINGLE_REQ_IRQ\n");
-		if ((I2C_RIS & I2C_RIS_LSREQ_INT)) {
-			printf("--> I2C_RIS_LSREQ_INT\n");
-			if ((i2c_state.addr & 1)) {
-				if (!i2c_state.addr_sent) {
-					I2C_TXD = i2c_state.addr;
-					i2c_state.addr_sent = true;
-				} else {
-					i2c_hw_read_fifo();
-				}
-			} else {
-				int offset = 0;
-				uint32_t value = 0;
-				if (!i2c_state.addr_sent) {
-					value |= i2c_state.addr;
-					offset = 1;
-					i2c_state.addr_sent = true;
-				}
-				
-				i2c_hw_write_fifo(value, offset);
-			}
-			I2C_ICR = I2C_ICR_LSREQ_INT;
-		} else if ((I2C_RIS & I2C_RIS_SREQ_INT)) {
-			printf("--> I2C_RIS_SREQ_INT\n");
-			if ((i2c_state.addr & 1)) {
-				if (!i2c_state.addr_sent) {
-					I2C_TXD = i2c_state.addr;
-					i2c_state.addr_sent = true;
-				} else {
-					i2c_hw_read_fifo();
-				}
-			} else {
-				int offset = 0;
-				uint32_t value = 0;
-				if (!i2c_state.addr_sent) {
-					value |= i2c_state.addr;
-					offset = 1;
-					i2c_state.addr_sent = true;
-				}
-				
-				i2c_hw_write_fifo(value, offset);
-			}
-			I2C_ICR = I2C_ICR_SREQ_INT;
-		} else if ((I2C_RIS & I2C_RIS_LBREQ_INT)) {
-			printf("--> I2C_RIS_LBREQ_INT\n");
-			i2c_hw_read_fifo();
-			I2C_ICR = I2C_ICR_LBREQ_INT;
-		} else {
-			printf("Unknown I2C_RIS: %08X\n", I2C_RIS);
-			while (true);
-		}
-	} else if (irqn == NVIC_I2C_PROTOCOL_IRQ) {
-		printf("-> NVIC_I2C_PROTOCOL_IRQ\n");
-		if ((I2C_PIRQSS & I2C_PIRQSS_TX_END)) {
-			printf("-> I2C_PIRQSS_TX_END\n");
-			i2c_state.code = ERR_SUCCESS;
-			I2C_PIRQSC = I2C_PIRQSC_TX_END;
-		//	I2C_ENDDCTRL = I2C_ENDDCTRL_SETEND;
-		} else if ((I2C_PIRQSS & I2C_PIRQSS_RX)) {
-			printf("-> I2C_PIRQSS_RX\n");
-			I2C_PIRQSC = I2C_PIRQSC_RX;
-		} else if ((I2C_PIRQSS & I2C_PIRQSS_NACK)) {
-			printf("-> I2C_PIRQSS_NACK\n");
-			I2C_PIRQSC = I2C_PIRQSM_NACK;
-			i2c_state.code = ERR_NACK;
-		} else {
-			printf("Unknown I2C_PIRQSS: %08X\n", I2C_PIRQSS);
-			while (true);
-		}
-	} else {
-		printf("Unknown irq: %d\n", irqn);
-		while (true);
-	}
-	
-	NVIC_IRQ_ACK = 1;
-}
-
-static int hw_i2c_transfer(uint8_t addr, uint8_t *buffer, int size, bool is_write) {
-	i2c_state.addr = (addr << 1) | (is_write ? 0 : 1);
-	i2c_state.buffer = buffer;
-	i2c_state.size = size;
-	i2c_state.code = ERR_BUSY;
-	i2c_state.addr_sent = false;
-	
-	if ((i2c_state.addr & 1)) {
-		printf("i2c_read: addr: %02X, size: %d\n", addr, size);
-	} else {
-		printf("i2c_write: addr: %02X, data[%d]:", addr, size);
-		for (int i = 0; i < size; i++)
-			printf(" %02X", buffer[i]);
-		printf("\n");
-	}
-	
-	I2C_ICR = I2C_ICR_LSREQ_INT | I2C_ICR_SREQ_INT | I2C_ICR_LBREQ_INT | I2C_ICR_BREQ_INT;
-	I2C_PIRQSC = I2C_PIRQSC_AM | I2C_PIRQSC_GC | I2C_PIRQSC_MC | I2C_PIRQSC_AL | I2C_PIRQSC_NACK | I2C_PIRQSC_TX_END | I2C_PIRQSC_RX;
-	I2C_ERRIRQSC = I2C_ERRIRQSC_RXF_UFL | I2C_ERRIRQSC_RXF_OFL | I2C_ERRIRQSC_TXF_UFL | I2C_ERRIRQSC_TXF_OFL;
-	I2C_IMSC = I2C_IMSC_LSREQ_INT | I2C_IMSC_SREQ_INT | I2C_IMSC_LBREQ_INT | I2C_IMSC_BREQ_INT | I2C_IMSC_I2C_ERR_INT | I2C_IMSC_I2C_P_INT;
-	
-	if ((i2c_state.addr & 1)) {
-		I2C_MRPSCTRL = i2c_state.size;
-		I2C_TPSCTRL = 1;
-	} else {
-		I2C_TPSCTRL = i2c_state.size + 1;
-	}
-	
-	while (i2c_state.code == -1)
-		wdt_serve();
-	
-	if ((i2c_state.addr & 1)) {
-		printf("-> read:");
-		for (int i = 0; i < size; i++)
-			printf(" %02X", buffer[i]);
-		printf("\n");
-	}
-	
-	printf("-> done: %d\n", i2c_state.code);
-	
-	return i2c_state.code;
-}
-
-static int hw_i2c_write(uint8_t addr, uint8_t *buffer, int size) {
-	return hw_i2c_transfer(addr, buffer, size, true);
-}
-
-static int hw_i2c_read(uint8_t addr, uint8_t *buffer, int size) {
-	return hw_i2c_transfer(addr, buffer, size, false);
-}
-
-static void poweroff(void) {
-	uint8_t data[2];
-	
-	data[0] = 0x0E;
-	data[1] = 0x14;
-	hw_i2c_write(D1601AA_I2C_ADDR, data, 2);
-}
-
-static void pickoff(void) {
-	uint8_t data[2];
-	
-	data[0] = 0x44;
-	data[1] = 0x24;
-	hw_i2c_write(D1601AA_I2C_ADDR, data, 2);
-	
-	data[0] = 0x46;
-	data[1] = 0x5F;
-	hw_i2c_write(D1601AA_I2C_ADDR, data, 2);
-	
-	data[0] = 0x42;
-	data[1] = 0x5F;
-	hw_i2c_write(D1601AA_I2C_ADDR, data, 2);
-}
 
 int main(void) {
 	wdt_init();
 	
 	cpu_enable_irq(true);
-	for (int i = 0; i < 0x200; i++)
-		NVIC_CON(i) = 1;
+	i2c_hw_init(400000);
+	
+	dump_all_regs();
 	
-	i2c_hw_init();
+	// Async: queue two reads and do something useful while they are in progress
+	uint8_t regs0[16], regs1[16];
+	struct i2c_hw_xfer_t xfer0 = { .addr = D1601AA_I2C_ADDR, .reg = 0x00, .rx = regs0, .rx_len = sizeof(regs0), .callback = async_callback };
+	struct i2c_hw_xfer_t xfer1 = { .addr = D1601AA_I2C_ADDR, .reg = 0x10, .rx = regs1, .rx_len = sizeof(regs1), .callback = async_callback };
 	
-	uint8_t data[64] = {0xFF};
-	data[0] = 0x44;
-	data[1] = 0x24;
-//	hw_i2c_write(D1601AA_I2C_ADDR, data, 3);
+	stopwatch_t start = stopwatch_get();
+	i2c_hw_submit(&xfer0);
+	i2c_hw_submit(&xfer1);
 	
-	hw_i2c_read(D1601AA_I2C_ADDR, data, 64);
+	uint32_t idle_loops = 0;
+	while (async_done < 2)
+		idle_loops++;
 	
-	// pickoff();
+	printf("async: %d us, idle loops: %d, status: %d/%d\n", stopwatch_elapsed_us(start), idle_loops, xfer0.status, xfer1.status);
 	
 	printf("Done!\n");
 	
 	return 0;
 }
 
+__IRQ void irq_handler(void) {
+	int irqn = NVIC_CURRENT_IRQ;
+	
+	if (irqn >= NVIC_I2C_SINGLE_REQ_IRQ && irqn <= NVIC_I2C_PROTOCOL_IRQ)
+		i2c_hw_irq();
+	
+	NVIC_IRQ_ACK = 1;
+}
+
 __IRQ void data_abort_handler(void) {
 	printf("data_abort_handler\n");
 	while (true);
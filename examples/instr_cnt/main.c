@@ -24,7 +24,7 @@ int main(void) {
 	my_delay(cnt);
 	uint32_t elapsed = stopwatch_elapsed_us(start);
 	
-	printf("elapsed=%d\n", elapsed);
+	printf("elapsed=%d, cache=%d\n", elapsed, mmu_is_enabled());
 	
 	return 0;
 }
@@ -0,0 +1,106 @@
+#include <pmb887x.h>
+#include <printf.h>
+
+/*
+ * IRQ dispatch cost: TPU service request is triggered by software (SETR),
+ * measured time from trigger to handler and full round trip.
+ */
+
+#define ITERATIONS		10000
+
+static volatile bool fired;
+static volatile stopwatch_t handler_time;
+
+static inline void tpu_irq_handle(void) {
+	handler_time = stopwatch_get();
+	TPU_SRC(0) = MOD_SRC_SRE | MOD_SRC_CLRR;
+	fired = true;
+}
+
+static void tpu_irq(uint32_t irq, void *ctx) {
+	(void) irq;
+	(void) ctx;
+	tpu_irq_handle();
+}
+
+static uint32_t ticks_to_ns(uint64_t ticks) {
+	return ticks * 1000000000ULL / stopwatch_ticks_per_s();
+}
+
+static void bench(const char *name) {
+	uint64_t entry_ticks = 0;
+	uint64_t total_ticks = 0;
+
+	wdt_serve();
+
+	for (uint32_t i = 0; i < ITERATIONS; i++) {
+		fired = false;
+
+		stopwatch_t start = stopwatch_get();
+		TPU_SRC(0) |= MOD_SRC_SETR;
+		while (!fired);
+		stopwatch_t end = stopwatch_get();
+
+		entry_ticks += handler_time - start;
+		total_ticks += end - start;
+
+		if ((i % 1000) == 0)
+			wdt_serve();
+	}
+
+	printf("%s: trigger->handler %5d ns, round trip %5d ns\n", name,
+		ticks_to_ns(entry_ticks) / ITERATIONS, ticks_to_ns(total_ticks) / ITERATIONS);
+}
+
+int main(void) {
+	wdt_init();
+
+	TPU_CLC = 1 << MOD_CLC_RMC_SHIFT;
+	TPU_SRC(0) = MOD_SRC_SRE | MOD_SRC_CLRR;
+	NVIC_CON(NVIC_TPU_INT0_IRQ) = 1;
+
+	cpu_enable_irq(true);
+
+	printf("IRQ dispatch benchmark, cpu: %d MHz\n", cpu_get_freq() / 1000000);
+
+	// irq_handler() below, installed by reset_handler()
+	bench("switch");
+
+	irq_init();
+	irq_register(NVIC_TPU_INT0_IRQ, tpu_irq, NULL, 1);
+	bench("table ");
+
+	irq_print_stats();
+
+	while (true)
+		wdt_serve();
+
+	return 0;
+}
+
+__IRQ void irq_handler(void) {
+	int irqn = NVIC_CURRENT_IRQ;
+
+	switch (irqn) {
+		case NVIC_TPU_INT0_IRQ:
+			tpu_irq_handle();
+		break;
+	}
+
+	NVIC_IRQ_ACK = 1;
+}
+
+__IRQ void data_abort_handler(void) {
+	printf("data_abort_handler\n");
+	while (true);
+}
+
+__IRQ void undef_handler(void) {
+	printf("undef_handler\n");
+	while (true);
+}
+
+__IRQ void prefetch_abort_handler(void) {
+	printf("prefetch_abort_handler\n");
+	while (true);
+}
@@ -0,0 +1,3 @@
+#/bin/bash
+export PERL5LIB=.
+perl ../../boot.pl --boot=app.bin $@
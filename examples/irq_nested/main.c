@@ -0,0 +1,147 @@
+#include <pmb887x.h>
+#include <printf.h>
+
+/*
+ * Nested IRQ test: low priority GPTU timer handler does 2 ms of slow work (like I2C transfer or printf),
+ * in the middle of it RX IRQ is raised by software (USART_ISR). RX latency is measured for both modes.
+ * Send data to the UART during the test to see FIFO overruns with non-nested handling.
+ */
+
+#define PRIO_TIMER			1
+#define PRIO_UART_RX		10
+
+#define SLOW_WORK_US		2000
+#define PROBE_AFTER_US		500
+#define TEST_DURATION_MS	2000
+
+static uint8_t rx_buffer[0x4000];
+static struct timer_t slow_timer;
+
+static volatile bool slow_work_active;
+static volatile stopwatch_t probe_time;
+static volatile uint32_t probes;
+static volatile uint32_t preempted;
+static volatile uint64_t latency_sum;
+static volatile uint32_t latency_max;
+
+static void uart_rx_irq_handler(uint32_t irq, void *ctx) {
+	(void) irq;
+
+	if (probe_time) {
+		uint32_t latency = stopwatch_get() - probe_time;
+		probe_time = 0;
+		probes++;
+		latency_sum += latency;
+		latency_max = MAX(latency_max, latency);
+		if (slow_work_active)
+			preempted++;
+	}
+
+	usart_rx_irq((uint32_t) ctx);
+}
+
+static void timer_irq_handler(uint32_t irq, void *ctx) {
+	(void) irq;
+	(void) ctx;
+	timer_irq();
+}
+
+static void slow_timer_callback(struct timer_t *timer, void *ctx) {
+	(void) timer;
+	(void) ctx;
+
+	slow_work_active = true;
+	stopwatch_usleep(PROBE_AFTER_US);
+
+	probe_time = stopwatch_get();
+	USART_ISR(USART0) = USART_ISR_RX;
+
+	stopwatch_usleep(SLOW_WORK_US - PROBE_AFTER_US);
+	slow_work_active = false;
+}
+
+static uint32_t ticks_to_us(uint64_t ticks) {
+	return ticks / stopwatch_ticks_per_us();
+}
+
+static void run_test(bool nested) {
+	irq_set_nesting(nested);
+
+	probes = 0;
+	preempted = 0;
+	latency_sum = 0;
+	latency_max = 0;
+
+	struct usart_rx_stat_t stat_before, stat_after;
+	usart_rx_get_stat(USART0, &stat_before);
+
+	timer_start(&slow_timer, 10 * 1000, 10 * 1000);
+
+	stopwatch_t start = stopwatch_get();
+	while (stopwatch_elapsed_ms(start) < TEST_DURATION_MS) {
+		wdt_serve();
+
+		// Discard received data
+		uint8_t tmp[64];
+		usart_read(USART0, tmp, sizeof(tmp), 0);
+	}
+
+	timer_stop(&slow_timer);
+	usart_rx_get_stat(USART0, &stat_after);
+
+	uint32_t cnt = MAX(1, probes);
+	printf("%s: probes=%d, preempted=%d, rx latency avg=%d us, max=%d us, overruns=%d\n",
+		nested ? "nested    " : "non-nested", probes, preempted,
+		ticks_to_us(latency_sum / cnt), ticks_to_us(latency_max),
+		stat_after.overrun - stat_before.overrun);
+}
+
+int main(void) {
+	wdt_init();
+	irq_init();
+	timer_init();
+
+	usart_rx_init(USART0, rx_buffer, sizeof(rx_buffer), USART_FIFO_SIZE / 2, 32);
+
+	irq_register(NVIC_USART0_RX_IRQ, uart_rx_irq_handler, (void *) USART0, PRIO_UART_RX);
+	irq_register(NVIC_USART0_TMO_IRQ, uart_rx_irq_handler, (void *) USART0, PRIO_UART_RX);
+	irq_register(NVIC_USART0_ERR_IRQ, uart_rx_irq_handler, (void *) USART0, PRIO_UART_RX);
+	irq_register(NVIC_GPTU0_SRC0_IRQ, timer_irq_handler, NULL, PRIO_TIMER);
+
+	timer_setup(&slow_timer, slow_timer_callback, NULL);
+
+	cpu_enable_irq(true);
+
+	printf("Nested IRQ test, slow handler: %d us, probe after %d us\n", SLOW_WORK_US, PROBE_AFTER_US);
+
+	run_test(false);
+	run_test(true);
+
+	if (preempted > 0 && preempted == probes) {
+		printf("PASS: UART RX preempts timer handler\n");
+	} else {
+		printf("FAIL: UART RX was not preempting timer handler\n");
+	}
+
+	irq_print_stats();
+
+	while (true)
+		wdt_serve();
+
+	return 0;
+}
+
+__IRQ void data_abort_handler(void) {
+	printf("data_abort_handler\n");
+	while (true);
+}
+
+__IRQ void undef_handler(void) {
+	printf("undef_handler\n");
+	while (true);
+}
+
+__IRQ void prefetch_abort_handler(void) {
+	printf("prefetch_abort_handler\n");
+	while (true);
+}
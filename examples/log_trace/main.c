@@ -0,0 +1,91 @@
+#include <pmb887x.h>
+#include <printf.h>
+
+/*
+ * Register tracing with LOG(): GPIO_PIN registers are polled and every change is logged.
+ * Also compares the wire cost of the same line sent with printf() and LOG().
+ *   ./run.sh
+ *   ../../tools/log_decode.pl --elf app.elf --input serial.log
+ */
+
+#define TRACE_PINS		32
+#define COMPARE_LINES	1000
+
+static uint8_t tx_buffer[4096];
+
+static void usart_tx_irq_handler(uint32_t irq, void *ctx) {
+	(void) irq;
+	usart_tx_irq((uint32_t) ctx);
+}
+
+static uint32_t compare_printf(void) {
+	stopwatch_t start = stopwatch_get();
+	for (uint32_t i = 0; i < COMPARE_LINES; i++) {
+		printf("%08X: %08X (from %08X)\n", (uint32_t) &GPIO_PIN(i % TRACE_PINS), i, 0xA0000000 + i * 4);
+		wdt_serve();
+	}
+	usart_flush(USART0);
+	return stopwatch_elapsed_us(start);
+}
+
+static uint32_t compare_log(void) {
+	stopwatch_t start = stopwatch_get();
+	for (uint32_t i = 0; i < COMPARE_LINES; i++) {
+		LOG("%08X: %08X (from %08X)\n", (uint32_t) &GPIO_PIN(i % TRACE_PINS), i, 0xA0000000 + i * 4);
+		wdt_serve();
+	}
+	usart_flush(USART0);
+	return stopwatch_elapsed_us(start);
+}
+
+int main(void) {
+	wdt_init();
+	irq_init();
+
+	irq_register(NVIC_USART0_TX_IRQ, usart_tx_irq_handler, (void *) USART0, 1);
+	cpu_enable_irq(true);
+
+	usart_tx_init(USART0, tx_buffer, sizeof(tx_buffer));
+	log_init(USART0);
+	LOG("log_trace started\n");
+
+	uint32_t printf_us = compare_printf();
+	uint32_t log_us = compare_log();
+	LOG("%d lines: printf %u us, LOG %u us\n", COMPARE_LINES, printf_us, log_us);
+
+	uint32_t values[TRACE_PINS];
+	for (uint32_t i = 0; i < TRACE_PINS; i++) {
+		values[i] = GPIO_PIN(i);
+		LOG("GPIO_PIN%d = %08X\n", i, values[i]);
+	}
+
+	LOG("Tracing %d GPIO_PIN registers...\n", TRACE_PINS);
+
+	while (true) {
+		for (uint32_t i = 0; i < TRACE_PINS; i++) {
+			uint32_t value = GPIO_PIN(i);
+			if (value != values[i]) {
+				LOG("%08X: %08X (from %08X)\n", (uint32_t) &GPIO_PIN(i), value, values[i]);
+				values[i] = value;
+			}
+		}
+		wdt_serve();
+	}
+
+	return 0;
+}
+
+__IRQ void data_abort_handler(void) {
+	printf("data_abort_handler\n");
+	while (true);
+}
+
+__IRQ void undef_handler(void) {
+	printf("undef_handler\n");
+	while (true);
+}
+
+__IRQ void prefetch_abort_handler(void) {
+	printf("prefetch_abort_handler\n");
+	while (true);
+}
@@ -0,0 +1,2 @@
+#!/bin/bash
+perl ../../boot.pl --boot=app.bin $@ | tee serial.log | perl ../../tools/log_decode.pl --elf app.elf
@@ -0,0 +1,142 @@
+#include <pmb887x.h>
+#include <printf.h>
+#include <string.h>
+
+// Internal SRAM buffers come from alloc_intram, free after chaos bootloader jumped to our code in SDRAM
+#define SRAM_BUF_SIZE	0x8000
+
+#define FLASH_BASE		0xA0000000
+
+// Amount of data moved per measurement (must be small enough to not miss the watchdog)
+#define BENCH_BYTES		(256 * 1024)
+
+typedef void *(*copy_func_t)(void *, const void *, size_t);
+
+struct bench_region_t {
+	const char *name;
+	void *dst;
+	const void *src;
+	uint32_t max_size;
+};
+
+// Old implementation from lib/libc.c, for reference
+static void * __attribute__((noinline, optimize("no-tree-loop-distribute-patterns"))) byte_memcpy(void *dest, const void *src, size_t len) {
+	char *d = dest;
+	const char *s = src;
+	while (len--)
+		*d++ = *s++;
+	return dest;
+}
+
+static void *memset_wrap(void *dest, const void *src, size_t len) {
+	(void) src;
+	return memset(dest, 0x55, len);
+}
+
+// Returns speed in 0.01 MB/s
+static uint32_t bench(copy_func_t func, void *dst, const void *src, uint32_t size) {
+	uint32_t iterations = MAX(1, BENCH_BYTES / size);
+
+	wdt_serve();
+
+	stopwatch_t start = stopwatch_get();
+	for (uint32_t i = 0; i < iterations; i++)
+		func(dst, src, size);
+	uint32_t elapsed = stopwatch_elapsed_us(start);
+
+	wdt_serve();
+
+	if (!elapsed)
+		elapsed = 1;
+
+	// bytes per us == MB/s
+	return ((uint64_t) size * iterations * 100) / elapsed;
+}
+
+static void print_speed(const char *title, uint32_t speed) {
+	printf(" %s %5d.%02d MB/s", title, speed / 100, speed % 100);
+}
+
+static void check_copy(uint8_t *dst, const uint8_t *src, uint32_t size, uint32_t dst_offset, uint32_t src_offset) {
+	memset(dst, 0, size);
+	memcpy(dst + dst_offset, src + src_offset, size - 4);
+	if (memcmp(dst + dst_offset, src + src_offset, size - 4) != 0 || dst[dst_offset + size - 4] != 0) {
+		printf("memcpy self-test failed! (dst+%d, src+%d)\n", dst_offset, src_offset);
+		while (true)
+			wdt_serve();
+	}
+}
+
+int main(void) {
+	wdt_init();
+	alloc_init();
+
+	static const uint32_t sizes[] = { 32, 256, 1024, 4096, 32768, 262144 };
+
+	uint8_t *sram_src = arena_alloc(&alloc_intram, SRAM_BUF_SIZE, ALLOC_ALIGN_CACHE);
+	uint8_t *sram_dst = arena_alloc(&alloc_intram, SRAM_BUF_SIZE, ALLOC_ALIGN_CACHE);
+	uint8_t *sdram_src = arena_alloc(&alloc_extram, BENCH_BYTES, ALLOC_ALIGN_CACHE);
+	uint8_t *sdram_dst = arena_alloc(&alloc_extram, BENCH_BYTES, ALLOC_ALIGN_CACHE);
+
+	if (!sram_src || !sram_dst || !sdram_src || !sdram_dst) {
+		printf("Not enough memory for buffers!\n");
+		while (true)
+			wdt_serve();
+	}
+
+	struct bench_region_t regions[] = {
+		{ "SRAM->SRAM  ", sram_dst, sram_src, SRAM_BUF_SIZE },
+		{ "SDRAM->SDRAM", sdram_dst, sdram_src, BENCH_BYTES },
+		{ "FLASH->SDRAM", sdram_dst, (const void *) FLASH_BASE, BENCH_BYTES },
+		{ "SDRAM->SRAM ", sram_dst, sdram_src, SRAM_BUF_SIZE },
+	};
+
+	for (uint32_t i = 0; i < BENCH_BYTES; i++)
+		sdram_src[i] = i * 7;
+
+	for (uint32_t dst_offset = 0; dst_offset < 4; dst_offset++) {
+		for (uint32_t src_offset = 0; src_offset < 4; src_offset++)
+			check_copy(sdram_dst, sdram_src, 1024, dst_offset, src_offset);
+	}
+
+	printf("memcpy benchmark, cpu: %d MHz\n", cpu_get_freq() / 1000000);
+
+	for (uint32_t r = 0; r < ARRAY_SIZE(regions); r++) {
+		struct bench_region_t *region = &regions[r];
+
+		for (uint32_t i = 0; i < ARRAY_SIZE(sizes); i++) {
+			uint32_t size = sizes[i];
+			if (size > region->max_size)
+				continue;
+
+			printf("%s %6d bytes:", region->name, size);
+			print_speed("memcpy", bench(memcpy, region->dst, region->src, size));
+			print_speed("memcpy+1", bench(memcpy, (uint8_t *) region->dst + 1, region->src, size - 4));
+			print_speed("bytes", bench(byte_memcpy, region->dst, region->src, size));
+			print_speed("memset", bench(memset_wrap, region->dst, NULL, size));
+			printf("\n");
+		}
+	}
+
+	printf("Done!\n");
+
+	while (true)
+		wdt_serve();
+
+	return 0;
+}
+
+__IRQ void data_abort_handler(void) {
+	printf("data_abort_handler\n");
+	while (true);
+}
+
+__IRQ void undef_handler(void) {
+	printf("undef_handler\n");
+	while (true);
+}
+
+__IRQ void prefetch_abort_handler(void) {
+	printf("prefetch_abort_handler\n");
+	while (true);
+}
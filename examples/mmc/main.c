@@ -1,40 +1,45 @@
 #include <pmb887x.h>
 #include <printf.h>
 
+static const char *card_types[] = { "none", "MMC", "SD v1", "SD v2", "SDHC" };
+
+static uint32_t block[MMC_BLOCK_SIZE / 4];
+
 int main(void) {
 	wdt_init();
-	
-	/*
-		fSYS = 26 MHz
-		fMMC = fSYS / 4
-		
-		BYPASS = 6.5 MHz
-		
-		div(1)	= 1.624 (fMCI / 4)
-		div(2)	= 1.083 (fMCI / 6)
-		
-		mmc_freq = fSYS / ((clkdiv + 1) * 2)
-	*/
-	
-	printf("Init MMC pins\n");
-	GPIO_PIN(GPIO_MMC_VCC_EN) = GPIO_PS_MANUAL | GPIO_DIR_OUT | GPIO_DATA_HIGH;
-	GPIO_PIN(GPIO_MMCI_CLK) = GPIO_PS_ALT | GPIO_IS_ALT0 | GPIO_OS_ALT0;
-	GPIO_PIN(GPIO_MMCI_CMD) = GPIO_PS_ALT | GPIO_IS_ALT0 | GPIO_OS_ALT0;
-	GPIO_PIN(GPIO_MMCI_DAT0) = GPIO_PS_ALT | GPIO_IS_ALT0 | GPIO_OS_ALT0;
-	
-	printf("Enable MCI clock\n");
-	MMCI_CLC = 7 << MOD_CLC_RMC_SHIFT;
-	
-	printf("Start MCI\n");
-	MCI_POWER = MCI_POWER_CTRL_POWER_UP;
-	// MCI_CLOCK = MCI_CLOCK_BYPASS | MCI_CLOCK_ENABLE;
-	MCI_CLOCK = (3 << MCI_CLOCK_CLKDIV_SHIFT) | MCI_CLOCK_ENABLE;
-	MCI_POWER = MCI_POWER_CTRL_POWER_ON;
-	
-	printf("Wait 60 sec for oscilloscope!");
-	stopwatch_sleep_wd(5);
-	
-	while (1);
+
+	printf("Init MMC...\n");
+	int ret = mmc_init();
+	if (ret) {
+		printf("mmc_init error: %d\n", ret);
+		while (true)
+			wdt_serve();
+	}
+
+	const struct mmc_card_t *card = mmc_get_card();
+	printf("Card: %s, RCA %04X, OCR %08X\n", card_types[card->type], card->rca, card->ocr);
+	printf("CID: %08X%08X%08X%08X\n", card->cid[0], card->cid[1], card->cid[2], card->cid[3]);
+	printf("CSD: %08X%08X%08X%08X\n", card->csd[0], card->csd[1], card->csd[2], card->csd[3]);
+	printf("Size: %d MB, bus: %d bit, clock: %d kHz\n", card->blocks / 2048, card->bus_width, card->clock / 1000);
+
+	ret = mmc_read_blocks(0, block, 1);
+	if (ret) {
+		printf("mmc_read_blocks error: %d\n", ret);
+	} else {
+		const uint8_t *data = (const uint8_t *) block;
+		printf("Block 0:\n");
+		for (uint32_t i = 0; i < MMC_BLOCK_SIZE; i += 16) {
+			printf("%04X:", i);
+			for (uint32_t j = 0; j < 16; j++)
+				printf(" %02X", data[i + j]);
+			printf("\n");
+		}
+	}
+
+	while (true)
+		wdt_serve();
+
+	return 0;
 }
 
 __IRQ void data_abort_handler(void) {
@@ -0,0 +1,182 @@
+#include <pmb887x.h>
+#include <printf.h>
+#include <string.h>
+
+/*
+ * SD/MMC sequential and random throughput, CPU FIFO copy vs DMA, see "mb_s" in the output.
+ *   ../../tools/bench.pl run --out mmc.jsonl -- ./run.sh
+ * Write cases destroy data in the last TEST_AREA_SIZE bytes of the card, enable them with WRITE_TESTS.
+ */
+
+#define WRITE_TESTS			0
+#define TEST_AREA_SIZE		(16 * 1024 * 1024)
+#define MAX_BLOCKS			256
+#define SG_PARTS			4
+
+struct mmc_case_t {
+	uint32_t blocks;
+	bool write;
+	bool random;
+	bool dma;
+	bool sg;				// data in SG_PARTS buffers with gaps between them
+	uint32_t lba;
+};
+
+static uint32_t buffer[MAX_BLOCKS * MMC_BLOCK_SIZE / 4] __attribute__((aligned(32)));
+static uint32_t reference[8 * MMC_BLOCK_SIZE / 4];
+
+static uint32_t area_start;
+static uint32_t area_blocks;
+static int dma_periph = -1;
+static uint32_t rand_state = 1;
+static uint32_t errors;
+static int last_error;
+
+static void dmac_irq_handler(uint32_t irq, void *ctx) {
+	(void) irq;
+	(void) ctx;
+	dmac_irq();
+}
+
+static void bench_mmc(void *ctx) {
+	struct mmc_case_t *c = ctx;
+	uint32_t lba;
+
+	if (c->random) {
+		// Aligned to the transfer size, like filesystem clusters
+		rand_state = rand_state * 1664525 + 1013904223;
+		lba = ((rand_state >> 8) % (area_blocks / c->blocks)) * c->blocks;
+	} else {
+		lba = c->lba;
+		c->lba += c->blocks;
+		if (c->lba + c->blocks > area_blocks)
+			c->lba = 0;
+	}
+
+	mmc_set_dma(c->dma ? dma_periph : -1);
+
+	int ret;
+	if (c->sg) {
+		uint32_t part_size = c->blocks * MMC_BLOCK_SIZE / SG_PARTS;
+		struct mmc_buf_t bufs[SG_PARTS];
+		for (uint32_t i = 0; i < SG_PARTS; i++) {
+			bufs[i].data = (uint8_t *) buffer + i * sizeof(buffer) / SG_PARTS;
+			bufs[i].size = part_size;
+		}
+		ret = c->write ? mmc_write(area_start + lba, bufs, SG_PARTS) : mmc_read(area_start + lba, bufs, SG_PARTS);
+	} else if (c->write) {
+		ret = mmc_write_blocks(area_start + lba, buffer, c->blocks);
+	} else {
+		ret = mmc_read_blocks(area_start + lba, buffer, c->blocks);
+	}
+
+	if (ret) {
+		errors++;
+		last_error = ret;
+	}
+}
+
+// DMAC request line of MCI is unknown: try all and compare with CPU read
+// Lines 0..9 can also be switched to the alternative source with dmac_set_request_source()
+static int find_dma_periph(void) {
+	mmc_set_dma(-1);
+	if (mmc_read_blocks(area_start, reference, 8))
+		return -1;
+
+	for (int periph = 0; periph < 16; periph++) {
+		memset(buffer, 0, sizeof(reference));
+		mmc_set_dma(periph);
+		int ret = mmc_read_blocks(area_start, buffer, 8);
+		if (!ret && memcmp(buffer, reference, sizeof(reference)) == 0)
+			return periph;
+		wdt_serve();
+	}
+
+	return -1;
+}
+
+static struct mmc_case_t seq_read_cpu_32k = { 64, false, false, false, false, 0 };
+static struct mmc_case_t seq_read_512 = { 1, false, false, true, false, 0 };
+static struct mmc_case_t seq_read_4k = { 8, false, false, true, false, 0 };
+static struct mmc_case_t seq_read_32k = { 64, false, false, true, false, 0 };
+static struct mmc_case_t seq_read_128k = { 256, false, false, true, false, 0 };
+static struct mmc_case_t seq_read_sg_32k = { 64, false, false, true, true, 0 };
+static struct mmc_case_t rand_read_512 = { 1, false, true, true, false, 0 };
+static struct mmc_case_t rand_read_4k = { 8, false, true, true, false, 0 };
+#if WRITE_TESTS
+static struct mmc_case_t seq_write_cpu_32k = { 64, true, false, false, false, 0 };
+static struct mmc_case_t seq_write_4k = { 8, true, false, true, false, 0 };
+static struct mmc_case_t seq_write_32k = { 64, true, false, true, false, 0 };
+static struct mmc_case_t seq_write_128k = { 256, true, false, true, false, 0 };
+static struct mmc_case_t rand_write_4k = { 8, true, true, true, false, 0 };
+#endif
+
+int main(void) {
+	wdt_init();
+	irq_init();
+	dmac_init();
+
+	irq_register(NVIC_DMAC_ERR_IRQ, dmac_irq_handler, NULL, 1);
+	for (uint32_t i = 0; i < DMAC_CHANNELS; i++)
+		irq_register(NVIC_DMAC_CH0_IRQ + i, dmac_irq_handler, NULL, 1);
+	cpu_enable_irq(true);
+
+	int ret = mmc_init();
+	if (ret) {
+		printf("mmc_init error: %d\n", ret);
+		while (true)
+			wdt_serve();
+	}
+
+	const struct mmc_card_t *card = mmc_get_card();
+	area_blocks = MIN(card->blocks, TEST_AREA_SIZE / MMC_BLOCK_SIZE);
+	area_start = card->blocks - area_blocks;
+	printf("Card: %d MB, bus: %d bit, clock: %d kHz\n", card->blocks / 2048, card->bus_width, card->clock / 1000);
+
+	dma_periph = find_dma_periph();
+	printf("MCI DMA request line: %d\n", dma_periph);
+
+	static const struct bench_t benches[] = {
+		{ "seq_read_cpu_32k",	bench_mmc,	&seq_read_cpu_32k,	64 * MMC_BLOCK_SIZE,	32,		BENCH_KEEP_IRQ },
+		{ "seq_read_512",		bench_mmc,	&seq_read_512,		1 * MMC_BLOCK_SIZE,		0,		BENCH_KEEP_IRQ },
+		{ "seq_read_4k",		bench_mmc,	&seq_read_4k,		8 * MMC_BLOCK_SIZE,		0,		BENCH_KEEP_IRQ },
+		{ "seq_read_32k",		bench_mmc,	&seq_read_32k,		64 * MMC_BLOCK_SIZE,	32,		BENCH_KEEP_IRQ },
+		{ "seq_read_128k",		bench_mmc,	&seq_read_128k,		256 * MMC_BLOCK_SIZE,	16,		BENCH_KEEP_IRQ },
+		{ "seq_read_sg_32k",	bench_mmc,	&seq_read_sg_32k,	64 * MMC_BLOCK_SIZE,	32,		BENCH_KEEP_IRQ },
+		{ "rand_read_512",		bench_mmc,	&rand_read_512,		1 * MMC_BLOCK_SIZE,		0,		BENCH_KEEP_IRQ },
+		{ "rand_read_4k",		bench_mmc,	&rand_read_4k,		8 * MMC_BLOCK_SIZE,		0,		BENCH_KEEP_IRQ },
+#if WRITE_TESTS
+		{ "seq_write_cpu_32k",	bench_mmc,	&seq_write_cpu_32k,	64 * MMC_BLOCK_SIZE,	32,		BENCH_KEEP_IRQ },
+		{ "seq_write_4k",		bench_mmc,	&seq_write_4k,		8 * MMC_BLOCK_SIZE,		0,		BENCH_KEEP_IRQ },
+		{ "seq_write_32k",		bench_mmc,	&seq_write_32k,		64 * MMC_BLOCK_SIZE,	32,		BENCH_KEEP_IRQ },
+		{ "seq_write_128k",		bench_mmc,	&seq_write_128k,	256 * MMC_BLOCK_SIZE,	16,		BENCH_KEEP_IRQ },
+		{ "rand_write_4k",		bench_mmc,	&rand_write_4k,		8 * MMC_BLOCK_SIZE,		0,		BENCH_KEEP_IRQ },
+#endif
+	};
+
+	bench_begin("mmc");
+	bench_run_all(benches, ARRAY_SIZE(benches));
+	bench_end();
+
+	printf("errors: %d, last error: %d\n", errors, last_error);
+
+	while (true)
+		wdt_serve();
+
+	return 0;
+}
+
+__IRQ void data_abort_handler(void) {
+	printf("data_abort_handler\n");
+	while (true);
+}
+
+__IRQ void undef_handler(void) {
+	printf("undef_handler\n");
+	while (true);
+}
+
+__IRQ void prefetch_abort_handler(void) {
+	printf("prefetch_abort_handler\n");
+	while (true);
+}
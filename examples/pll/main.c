@@ -1,7 +1,7 @@
 #include <pmb887x.h>
 #include <math.h>
 
-struct bench_t {
+struct pll_bench_t {
 	uint32_t cpu;
 	uint32_t cpu_raw;
 	uint32_t tpu;
@@ -68,7 +68,7 @@ static void tpu_init(void) {
 	TPU_SRC(1) = MOD_SRC_SRE;
 }
 
-static void benchmark(struct bench_t *result) {
+static void benchmark(struct pll_bench_t *result) {
 	wdt_serve();
 	
 	uint32_t cycles = 100000;
@@ -133,7 +133,7 @@ static void clock_restore(void) {
 }
 
 int main(void) {
-	struct bench_t b;
+	struct pll_bench_t b;
 	
 	wdt_init();
 	rtc_init();
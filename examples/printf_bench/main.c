@@ -0,0 +1,123 @@
+#include <pmb887x.h>
+#include <printf.h>
+
+/*
+ * Integer formatting: old ui2a() from lib/printf.c vs current sprintf(), see "median_cycles" in the output.
+ * Old cases measure only the conversion, sprintf cases include format parsing too.
+ *   ../../tools/bench.pl run --out printf.jsonl -- ./run.sh
+ */
+
+// 9 digits, close to the worst case for 32 bit
+#define VALUE		((void *) 123456789)
+
+static char buffer[32];
+
+// Old implementation from lib/printf.c, for reference
+static void __attribute__((noinline)) old_ui2a(unsigned int num, unsigned int base, int uc, char *bf) {
+	int n = 0;
+	unsigned int d = 1;
+	while (num / d >= base)
+		d *= base;
+	while (d != 0) {
+		int dgt = num / d;
+		num %= d;
+		d /= base;
+		if (n || dgt > 0 || d == 0) {
+			*bf++ = dgt + (dgt < 10 ? '0' : (uc ? 'A' : 'a') - 10);
+			++n;
+		}
+	}
+	*bf = 0;
+}
+
+// Same algorithm for 64 bit, what "%llu" would cost with libgcc division
+static void __attribute__((noinline)) old_ull2a(unsigned long long num, unsigned int base, int uc, char *bf) {
+	int n = 0;
+	unsigned long long d = 1;
+	while (num / d >= base)
+		d *= base;
+	while (d != 0) {
+		int dgt = num / d;
+		num %= d;
+		d /= base;
+		if (n || dgt > 0 || d == 0) {
+			*bf++ = dgt + (dgt < 10 ? '0' : (uc ? 'A' : 'a') - 10);
+			++n;
+		}
+	}
+	*bf = 0;
+}
+
+static void bench_old_dec(void *ctx) {
+	old_ui2a((uint32_t) ctx, 10, 0, buffer);
+}
+
+static void bench_old_hex(void *ctx) {
+	old_ui2a((uint32_t) ctx, 16, 1, buffer);
+}
+
+static void bench_old_u64_dec(void *ctx) {
+	old_ull2a((uint64_t) (uint32_t) ctx * 1000000007ULL, 10, 0, buffer);
+}
+
+static void bench_sprintf_dec(void *ctx) {
+	sprintf(buffer, "%u", (uint32_t) ctx);
+}
+
+static void bench_sprintf_hex(void *ctx) {
+	sprintf(buffer, "%X", (uint32_t) ctx);
+}
+
+static void bench_sprintf_u64_dec(void *ctx) {
+	sprintf(buffer, "%llu", (uint64_t) (uint32_t) ctx * 1000000007ULL);
+}
+
+static void bench_sprintf_u64_hex(void *ctx) {
+	sprintf(buffer, "%llX", (uint64_t) (uint32_t) ctx * 1000000007ULL);
+}
+
+static void bench_snprintf_dec(void *ctx) {
+	snprintf(buffer, sizeof(buffer), "%u", (uint32_t) ctx);
+}
+
+int main(void) {
+	wdt_init();
+
+	static const struct bench_t benches[] = {
+		{ .name = "old_ui2a_dec",			.func = bench_old_dec, .ctx = VALUE },
+		{ .name = "old_ui2a_hex",			.func = bench_old_hex, .ctx = VALUE },
+		{ .name = "old_ull2a_dec",			.func = bench_old_u64_dec, .ctx = VALUE },
+		{ .name = "sprintf_u32_dec",		.func = bench_sprintf_dec, .ctx = VALUE },
+		{ .name = "sprintf_u32_hex",		.func = bench_sprintf_hex, .ctx = VALUE },
+		{ .name = "sprintf_u64_dec",		.func = bench_sprintf_u64_dec, .ctx = VALUE },
+		{ .name = "sprintf_u64_hex",		.func = bench_sprintf_u64_hex, .ctx = VALUE },
+		{ .name = "snprintf_u32_dec",		.func = bench_snprintf_dec, .ctx = VALUE },
+	};
+
+	bench_begin("printf");
+	bench_run_all(benches, ARRAY_SIZE(benches));
+	bench_end();
+
+	stopwatch_t now = stopwatch_get();
+	printf("stopwatch_get() = %llu (0x%016llX), &buffer = %p\n", now, now, buffer);
+
+	while (true)
+		wdt_serve();
+
+	return 0;
+}
+
+__IRQ void data_abort_handler(void) {
+	printf("data_abort_handler\n");
+	while (true);
+}
+
+__IRQ void undef_handler(void) {
+	printf("undef_handler\n");
+	while (true);
+}
+
+__IRQ void prefetch_abort_handler(void) {
+	printf("prefetch_abort_handler\n");
+	while (true);
+}
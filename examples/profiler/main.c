@@ -0,0 +1,99 @@
+#include <pmb887x.h>
+#include <printf.h>
+#include <string.h>
+
+/*
+ * Profiles a synthetic workload for PROFILE_TIME_MS at 10 kHz and dumps samples to USART0.
+ *   ./run.sh
+ *   ../../tools/profiler.pl --elf app.elf --input serial.log --folded app.folded
+ *   flamegraph.pl app.folded > app.svg
+ */
+
+#define PROFILE_RATE		10000
+#define PROFILE_TIME_MS		3000
+#define PROFILE_MAX_SAMPLES	(PROFILE_RATE * PROFILE_TIME_MS / 1000 * 2)
+
+#define WORK_BUFFER_SIZE	(64 * 1024)
+
+static uint32_t __attribute__((noinline)) crc32(const uint8_t *data, uint32_t len) {
+	uint32_t crc = 0xFFFFFFFF;
+	while (len--) {
+		crc ^= *data++;
+		for (int i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+	}
+	return ~crc;
+}
+
+static void __attribute__((noinline)) copy_buffers(uint8_t *dst, const uint8_t *src, uint32_t len) {
+	for (int i = 0; i < 16; i++)
+		memcpy(dst, src, len);
+}
+
+static uint32_t __attribute__((noinline)) format_numbers(void) {
+	char buffer[32];
+	uint32_t total = 0;
+	for (uint32_t i = 0; i < 1000; i++) {
+		sprintf(buffer, "%d %08X", i * 12345, i);
+		total += buffer[0];
+	}
+	return total;
+}
+
+int main(void) {
+	wdt_init();
+	alloc_init();
+
+	uint32_t *samples = arena_alloc(&alloc_extram, PROFILE_MAX_SAMPLES * 8, 4);
+	uint8_t *src = arena_alloc(&alloc_extram, WORK_BUFFER_SIZE, ALLOC_ALIGN_CACHE);
+	uint8_t *dst = arena_alloc(&alloc_extram, WORK_BUFFER_SIZE, ALLOC_ALIGN_CACHE);
+
+	if (!samples || !src || !dst) {
+		printf("Not enough memory for buffers!\n");
+		while (true)
+			wdt_serve();
+	}
+
+	for (uint32_t i = 0; i < WORK_BUFFER_SIZE; i++)
+		src[i] = i * 7;
+
+	printf("Profiling for %d ms at %d Hz...\n", PROFILE_TIME_MS, PROFILE_RATE);
+
+	profiler_init(samples, PROFILE_MAX_SAMPLES * 8, PROFILE_RATE, true);
+	cpu_enable_irq(true);
+	profiler_start();
+
+	uint32_t result = 0;
+	stopwatch_t start = stopwatch_get();
+	while (stopwatch_elapsed_ms(start) < PROFILE_TIME_MS) {
+		result += crc32(src, 4096);
+		copy_buffers(dst, src, WORK_BUFFER_SIZE);
+		result += format_numbers();
+		wdt_serve();
+	}
+
+	profiler_stop();
+	printf("Done, result=%08X, samples=%d, lost=%d\n", result, profiler_get_count(), profiler_get_lost());
+
+	profiler_dump(USART0);
+
+	while (true)
+		wdt_serve();
+
+	return 0;
+}
+
+__IRQ void data_abort_handler(void) {
+	printf("data_abort_handler\n");
+	while (true);
+}
+
+__IRQ void undef_handler(void) {
+	printf("undef_handler\n");
+	while (true);
+}
+
+__IRQ void prefetch_abort_handler(void) {
+	printf("prefetch_abort_handler\n");
+	while (true);
+}
@@ -0,0 +1,102 @@
+#include <pmb887x.h>
+#include <printf.h>
+
+#define ITERATIONS		10000
+
+typedef uint32_t (*bench_func_t)(void);
+
+static stopwatch_t bench_start;
+
+// Old implementation from lib/stopwatch.c, for reference
+static stopwatch_t __attribute__((noinline)) old_stopwatch_get(void) {
+	return ((stopwatch_t) STM_TIM6 << 32) | (stopwatch_t) STM_TIM0;
+}
+
+static uint32_t __attribute__((noinline)) old_stopwatch_elapsed_us(stopwatch_t start) {
+	return (old_stopwatch_get() - start) / stopwatch_ticks_per_us();
+}
+
+static uint32_t __attribute__((noinline)) old_stopwatch_elapsed_ms(stopwatch_t start) {
+	return (old_stopwatch_get() - start) / stopwatch_ticks_per_ms();
+}
+
+static uint32_t bench_old_get(void) {
+	return old_stopwatch_get();
+}
+
+static uint32_t bench_new_get(void) {
+	return stopwatch_get();
+}
+
+static uint32_t bench_old_elapsed_us(void) {
+	return old_stopwatch_elapsed_us(bench_start);
+}
+
+static uint32_t bench_new_elapsed_us(void) {
+	return stopwatch_elapsed_us(bench_start);
+}
+
+static uint32_t bench_old_elapsed_ms(void) {
+	return old_stopwatch_elapsed_ms(bench_start);
+}
+
+static uint32_t bench_new_elapsed_ms(void) {
+	return stopwatch_elapsed_ms(bench_start);
+}
+
+static uint32_t bench_wdt_serve(void) {
+	wdt_serve();
+	return 0;
+}
+
+// Returns ns per call
+static uint32_t bench(bench_func_t func) {
+	uint32_t sum = 0;
+	
+	wdt_serve();
+	
+	stopwatch_t start = stopwatch_get();
+	for (uint32_t i = 0; i < ITERATIONS; i++)
+		sum += func();
+	uint32_t elapsed = stopwatch_elapsed_us(start);
+	
+	(void) sum;
+	
+	return elapsed * (1000 / 100) / (ITERATIONS / 100);
+}
+
+int main(void) {
+	wdt_init();
+	
+	bench_start = stopwatch_get();
+	
+	printf("stopwatch benchmark, cpu: %d MHz, stm: %d Hz\n", cpu_get_freq() / 1000000, stopwatch_ticks_per_s());
+	boot_timeline_print();
+	printf("                      old, ns  new, ns\n");
+	printf("stopwatch_get        %8d %8d\n", bench(bench_old_get), bench(bench_new_get));
+	printf("stopwatch_elapsed_us %8d %8d\n", bench(bench_old_elapsed_us), bench(bench_new_elapsed_us));
+	printf("stopwatch_elapsed_ms %8d %8d\n", bench(bench_old_elapsed_ms), bench(bench_new_elapsed_ms));
+	printf("wdt_serve                   - %8d\n", bench(bench_wdt_serve));
+	
+	printf("Done!\n");
+	
+	while (true)
+		wdt_serve();
+	
+	return 0;
+}
+
+__IRQ void data_abort_handler(void) {
+	printf("data_abort_handler\n");
+	while (true);
+}
+
+__IRQ void undef_handler(void) {
+	printf("undef_handler\n");
+	while (true);
+}
+
+__IRQ void prefetch_abort_handler(void) {
+	printf("prefetch_abort_handler\n");
+	while (true);
+}
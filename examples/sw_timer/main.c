@@ -0,0 +1,104 @@
+#include <pmb887x.h>
+#include <printf.h>
+
+static struct timer_t tick_timer;
+static struct timer_t jitter_timer;
+static struct timer_t oneshot_timer;
+
+static volatile uint32_t ticks;
+static volatile uint32_t jitter_cnt;
+static volatile uint32_t jitter_max_us;
+static volatile bool oneshot_fired;
+static stopwatch_t jitter_last;
+
+static void tick_timer_callback(struct timer_t *timer, void *ctx) {
+	(void) timer;
+	(void) ctx;
+	ticks++;
+}
+
+// Measures how late 1 ms periodic timer is
+static void jitter_timer_callback(struct timer_t *timer, void *ctx) {
+	(void) timer;
+	(void) ctx;
+
+	uint32_t elapsed = stopwatch_elapsed_us(jitter_last);
+	jitter_last = stopwatch_get();
+
+	if (jitter_cnt++ > 0 && elapsed > 1000)
+		jitter_max_us = MAX(jitter_max_us, elapsed - 1000);
+}
+
+static void oneshot_timer_callback(struct timer_t *timer, void *ctx) {
+	(void) timer;
+	*(stopwatch_t *) ctx = stopwatch_get();
+	oneshot_fired = true;
+}
+
+int main(void) {
+	wdt_init();
+	timer_init();
+
+	cpu_enable_irq(true);
+
+	static stopwatch_t oneshot_time;
+
+	timer_setup(&tick_timer, tick_timer_callback, NULL);
+	timer_setup(&jitter_timer, jitter_timer_callback, NULL);
+	timer_setup(&oneshot_timer, oneshot_timer_callback, &oneshot_time);
+
+	wdt_start_background();
+	timer_start(&tick_timer, 1000 * 1000, 1000 * 1000);
+
+	jitter_last = stopwatch_get();
+	timer_start(&jitter_timer, 1000, 1000);
+
+	// One-shot accuracy
+	static const uint32_t timeouts[] = { 50, 100, 1000, 12345, 500000 };
+	for (uint32_t i = 0; i < ARRAY_SIZE(timeouts); i++) {
+		oneshot_fired = false;
+		stopwatch_t start = stopwatch_get();
+		timer_start(&oneshot_timer, timeouts[i], 0);
+		while (!oneshot_fired);
+
+		uint32_t elapsed = stopwatch_elapsed_us(start) - stopwatch_elapsed_us(oneshot_time);
+		printf("one-shot %6d us: fired after %6d us\n", timeouts[i], elapsed);
+	}
+
+	uint32_t last_ticks = 0;
+	while (true) {
+		if (last_ticks != ticks) {
+			last_ticks = ticks;
+			printf("tick %d, 1 ms timer: %d calls, max latency %d us\n", last_ticks, jitter_cnt, jitter_max_us);
+		}
+	}
+
+	return 0;
+}
+
+__IRQ void irq_handler(void) {
+	int irqn = NVIC_CURRENT_IRQ;
+
+	switch (irqn) {
+		case NVIC_GPTU0_SRC0_IRQ:
+			timer_irq();
+		break;
+	}
+
+	NVIC_IRQ_ACK = 1;
+}
+
+__IRQ void data_abort_handler(void) {
+	printf("data_abort_handler\n");
+	while (true);
+}
+
+__IRQ void undef_handler(void) {
+	printf("undef_handler\n");
+	while (true);
+}
+
+__IRQ void prefetch_abort_handler(void) {
+	printf("prefetch_abort_handler\n");
+	while (true);
+}
@@ -0,0 +1,130 @@
+#include <pmb887x.h>
+#include <printf.h>
+
+/*
+ * Flasher-like pipeline: "receiver" gets blocks signaled from IRQ, "writer" programs them in the background.
+ * GPTU software timer emulates incoming blocks.
+ */
+
+#define BLOCKS_CNT			8
+
+struct pipeline_t {
+	struct task_event_t block_received;
+	uint32_t received;
+	uint32_t written;
+	uint32_t timeouts;
+};
+
+static struct pipeline_t pipeline;
+static struct task_t wdt_task;
+static struct task_t writer_task;
+static struct task_t echo_task;
+static struct timer_t rx_timer;
+static uint32_t idle_cnt;
+
+// Emulates "block received" IRQ
+static void rx_timer_callback(struct timer_t *timer, void *ctx) {
+	struct pipeline_t *p = ctx;
+	(void) timer;
+
+	if (p->received < BLOCKS_CNT) {
+		p->received++;
+		task_event_signal(&p->block_received);
+	}
+}
+
+static int wdt_task_func(struct task_t *task) {
+	TASK_BEGIN(task);
+	while (true) {
+		wdt_serve();
+		TASK_SLEEP_MS(task, 100);
+	}
+	TASK_END(task);
+}
+
+static int writer_task_func(struct task_t *task) {
+	struct pipeline_t *p = task->ctx;
+
+	TASK_BEGIN(task);
+	while (p->written < BLOCKS_CNT) {
+		TASK_WAIT_EVENT_TIMEOUT(task, &p->block_received, 50 * 1000);
+		if (task->timed_out) {
+			p->timeouts++;
+			continue;
+		}
+
+		printf("writing block %d...\n", p->written);
+
+		// Emulate slow programming, next block is received meanwhile
+		TASK_SLEEP_MS(task, 15);
+		p->written++;
+
+		printf("block %d done\n", p->written - 1);
+	}
+
+	printf("all blocks written, timeouts: %d, idle: %d\n", p->timeouts, idle_cnt);
+	TASK_END(task);
+}
+
+static int echo_task_func(struct task_t *task) {
+	TASK_BEGIN(task);
+	while (true) {
+		TASK_WAIT_UNTIL(task, usart_has_byte(USART0));
+		usart_putc(USART0, usart_getc(USART0));
+	}
+	TASK_END(task);
+}
+
+static void idle_hook(uint64_t next_wakeup) {
+	(void) next_wakeup;
+	idle_cnt++;
+}
+
+int main(void) {
+	wdt_init();
+	timer_init();
+	task_init();
+
+	cpu_enable_irq(true);
+
+	task_event_init(&pipeline.block_received);
+
+	task_set_idle_hook(idle_hook);
+	task_create(&wdt_task, wdt_task_func, NULL);
+	task_create(&writer_task, writer_task_func, &pipeline);
+	task_create(&echo_task, echo_task_func, NULL);
+
+	timer_setup(&rx_timer, rx_timer_callback, &pipeline);
+	timer_start(&rx_timer, 100 * 1000, 10 * 1000);
+
+	task_run();
+
+	return 0;
+}
+
+__IRQ void irq_handler(void) {
+	int irqn = NVIC_CURRENT_IRQ;
+
+	switch (irqn) {
+		case NVIC_GPTU0_SRC0_IRQ:
+			timer_irq();
+		break;
+	}
+
+	NVIC_IRQ_ACK = 1;
+}
+
+__IRQ void data_abort_handler(void) {
+	printf("data_abort_handler\n");
+	while (true);
+}
+
+__IRQ void undef_handler(void) {
+	printf("undef_handler\n");
+	while (true);
+}
+
+__IRQ void prefetch_abort_handler(void) {
+	printf("prefetch_abort_handler\n");
+	while (true);
+}
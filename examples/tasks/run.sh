@@ -0,0 +1,2 @@
+#!/bin/bash
+perl ../../boot.pl --boot=app.bin $@
@@ -1,58 +1,57 @@
 #include <pmb887x.h>
 #include <printf.h>
 
-static char buffer[0x4000] = {0};
-static uint32_t buffer_size = 0;
+static uint8_t rx_buffer[0x4000];
+static uint8_t tx_buffer[1024];
+
+static void usart_tx_irq_handler(uint32_t irq, void *ctx) {
+	(void) irq;
+	usart_tx_irq((uint32_t) ctx);
+}
+
+static void usart_rx_irq_handler(uint32_t irq, void *ctx) {
+	(void) irq;
+	usart_rx_irq((uint32_t) ctx);
+}
 
 int main(void) {
 	wdt_init();
+	irq_init();
+	
+	irq_register(NVIC_USART0_TX_IRQ, usart_tx_irq_handler, (void *) USART0, 1);
+	irq_register(NVIC_USART0_RX_IRQ, usart_rx_irq_handler, (void *) USART0, 1);
+	irq_register(NVIC_USART0_TMO_IRQ, usart_rx_irq_handler, (void *) USART0, 1);
+	irq_register(NVIC_USART0_ERR_IRQ, usart_rx_irq_handler, (void *) USART0, 1);
 	
 	cpu_enable_irq(true);
 	
 	// set async mode 
 	USART_CON(USART0) = (USART_CON(USART0) & ~USART_CON_M) | USART_CON_M_ASYNC_8BIT;
 	
-	// set fifo trigger
-	USART_RXFCON(USART0) = USART_RXFCON_RXFEN | (1 << USART_RXFCON_RXFITL_SHIFT);
-	USART_TXFCON(USART0) = USART_TXFCON_TXFEN | (1 << USART_TXFCON_TXFITL_SHIFT);
-	
-	// enable RX irq
-	USART_IMSC(USART0) = USART_IMSC_RX;
+	// buffered RX: irq at half of FIFO, timeout irq for the rest
+	usart_rx_init(USART0, rx_buffer, sizeof(rx_buffer), USART_FIFO_SIZE / 2, 32);
 	
-	for (int i = 0; i < 0xFF; i++) {
-		NVIC_CON(i) = 1; // RX
-	}
+	// buffered TX for printf
+	usart_tx_init(USART0, tx_buffer, sizeof(tx_buffer));
 	
 	printf("Xuj!\r\n");
 	
+	uint32_t total = 0;
 	while (true) {
-		printf("buffer_size=%d\r\n", buffer_size);
+		char buffer[64];
+		uint32_t size = usart_read(USART0, buffer, sizeof(buffer), 100);
+		total += size;
+		
+		struct usart_rx_stat_t stat;
+		usart_rx_get_stat(USART0, &stat);
+		
+		printf("total=%d, overrun=%d, framing=%d, dropped=%d, rx_irq=%d, tmo_irq=%d\r\n", total, stat.overrun, stat.framing, stat.dropped,
+			irq_get_count(NVIC_USART0_RX_IRQ), irq_get_count(NVIC_USART0_TMO_IRQ));
 		
-		if (buffer_size >= sizeof(buffer) - 1) {
-			printf("read done!\r\n");
-		}
 		wdt_serve();
 	}
 }
 
-__IRQ void irq_handler(void) {
-	int irqn = NVIC_CURRENT_IRQ;
-	
-	// RX
-	if (irqn == 0x6) {
-		while ((USART_FSTAT(USART0) & USART_FSTAT_RXFFL)) {
-			char ch = USART_RXB(USART0) & 0xff;
-			if (buffer_size < sizeof(buffer) - 1) {
-				buffer[buffer_size++] = ch;
-				buffer[buffer_size] = 0;
-			}
-		}
-		USART_ICR(USART0) = USART_ICR_ERR | USART_ICR_RX;
-	}
-	
-	NVIC_IRQ_ACK = 1;
-}
-
 __IRQ void data_abort_handler(void) {
 	printf("data_abort_handler\n");
 	while (true);
@@ -36,6 +36,27 @@ DLL_PUBLIC int i2c_receive(I2C_MSG *msg) {
 	return 0;
 }
 
+// Bit-bang pin helpers, lib/i2c.c keeps its own (precomputed) ones private
+static inline void i2c_delay(void) {
+	__asm__ volatile("NOP");
+}
+
+static inline void i2c_scl_lo(void) {
+	gpio_init_output(GPIO_I2C_SCL, GPIO_OS_NONE, GPIO_PS_MANUAL, false, GPIO_PPEN_OPENDRAIN, GPIO_PDPU_NONE, false);
+}
+
+static inline void i2c_scl_hi(void) {
+	gpio_init_input(GPIO_I2C_SCL, GPIO_IS_NONE, GPIO_PS_MANUAL, GPIO_PDPU_PULLUP, false);
+}
+
+static inline void i2c_sda_lo(void) {
+	gpio_init_output(GPIO_I2C_SDA, GPIO_OS_NONE, GPIO_PS_MANUAL, false, GPIO_PPEN_OPENDRAIN, GPIO_PDPU_NONE, false);
+}
+
+static inline void i2c_sda_hi(void) {
+	gpio_init_input(GPIO_I2C_SDA, GPIO_IS_NONE, GPIO_PS_MANUAL, GPIO_PDPU_PULLUP, false);
+}
+
 void i2c_start_read(uint8_t addr) {
 	i2c_start();
 	i2c_write((addr & 0x7F) << 1 | 1);
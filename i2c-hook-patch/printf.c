@@ -87,8 +87,8 @@ static int a2d(char ch) {
 	else return -1;
 }
 
-static char a2i(char ch, char **src, int base, int *nump) {
-	char *p = *src;
+static char a2i(char ch, const char **src, int base, int *nump) {
+	const char *p = *src;
 	int num = 0;
 	int digit;
 	while ((digit = a2d(ch)) >= 0) {
@@ -114,7 +114,7 @@ static void putchw(void *putp, putcf putf, int n, char z, char *bf) {
 		putf(putp, ch);
 }
 
-void tfp_format(void *putp, putcf putf, char *fmt, va_list va) {
+void tfp_format(void *putp, putcf putf, const char *fmt, va_list va) {
 	char bf[12];
 
 	char ch;
@@ -201,7 +201,7 @@ static void stdout_putf(void *p, char c) {
 	usart_putc(USART0, c);
 }
 
-void tfp_printf(char *fmt, ...) {
+void tfp_printf(const char *fmt, ...) {
 	va_list va;
 	va_start(va, fmt);
 	tfp_format(NULL, stdout_putf, fmt, va);
@@ -212,7 +212,7 @@ static void putcp(void *p, char c) {
 	*(*((char **) p))++ = c;
 }
 
-void tfp_sprintf(char *s, char *fmt, ...) {
+void tfp_sprintf(char *s, const char *fmt, ...) {
 	va_list va;
 	va_start(va, fmt);
 	tfp_format(&s, putcp, fmt, va);
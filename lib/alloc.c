@@ -0,0 +1,124 @@
+#include "alloc.h"
+
+extern uint32_t end, _stack_sys;
+
+struct arena_t alloc_intram;
+struct arena_t alloc_extram;
+
+static inline uint32_t _align_up(uint32_t value, uint32_t align) {
+	return (value + align - 1) & ~(align - 1);
+}
+
+void alloc_init(void) {
+	uint32_t image_start = _align_up((uint32_t) &end, 8);
+	uint32_t image_end = (uint32_t) &_stack_sys - ALLOC_STACK_SIZE;
+	uint32_t image_size = image_end > image_start ? image_end - image_start : 0;
+
+#ifdef BOOT_EXTRAM
+	arena_init(&alloc_extram, image_start, image_size);
+	arena_init(&alloc_intram, ALLOC_INTRAM_BASE, ALLOC_INTRAM_SIZE);
+#else
+	arena_init(&alloc_intram, image_start, image_size);
+	arena_init(&alloc_extram, ALLOC_EXTRAM_BASE, ALLOC_EXTRAM_SIZE);
+#endif
+}
+
+void arena_init(struct arena_t *arena, uint32_t base, uint32_t size) {
+	arena->start = base;
+	arena->end = base + size;
+	arena->cur = base;
+	arena->high_water = 0;
+}
+
+void *arena_alloc(struct arena_t *arena, size_t size, size_t align) {
+	uint32_t addr = _align_up(arena->cur, MAX(align, 4));
+	if (addr < arena->cur || addr > arena->end || size > arena->end - addr)
+		return NULL;
+
+	arena->cur = addr + size;
+	arena->high_water = MAX(arena->high_water, arena->cur - arena->start);
+	return (void *) addr;
+}
+
+arena_mark_t arena_mark(const struct arena_t *arena) {
+	return arena->cur;
+}
+
+void arena_reset(struct arena_t *arena, arena_mark_t mark) {
+	if (mark >= arena->start && mark <= arena->cur)
+		arena->cur = mark;
+}
+
+size_t arena_available(const struct arena_t *arena, size_t align) {
+	uint32_t addr = _align_up(arena->cur, MAX(align, 4));
+	return addr < arena->end ? arena->end - addr : 0;
+}
+
+void arena_get_stat(const struct arena_t *arena, struct alloc_stat_t *stat) {
+	stat->size = arena->end - arena->start;
+	stat->used = arena->cur - arena->start;
+	stat->high_water = arena->high_water;
+	stat->failed = 0;
+}
+
+bool pool_init(struct pool_t *pool, struct arena_t *arena, size_t block_size, uint32_t count, size_t align) {
+	align = MAX(align, sizeof(void *));
+	block_size = _align_up(MAX(block_size, sizeof(void *)), align);
+
+	uint8_t *blocks = arena_alloc(arena, block_size * count, align);
+	if (!blocks)
+		return false;
+
+	// Free list is stored in the first word of each free block
+	pool->free_list = NULL;
+	for (uint32_t i = count; i-- > 0; ) {
+		void **block = (void **) (blocks + i * block_size);
+		*block = pool->free_list;
+		pool->free_list = block;
+	}
+
+	pool->block_size = block_size;
+	pool->count = count;
+	pool->used = 0;
+	pool->high_water = 0;
+	pool->failed = 0;
+
+	return true;
+}
+
+void *pool_alloc(struct pool_t *pool) {
+	bool irq_disabled = cpu_enable_irq(false);
+
+	void **block = pool->free_list;
+	if (block) {
+		pool->free_list = *block;
+		pool->used++;
+		pool->high_water = MAX(pool->high_water, pool->used);
+	} else {
+		pool->failed++;
+	}
+
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+
+	return block;
+}
+
+void pool_free(struct pool_t *pool, void *block) {
+	if (!block)
+		return;
+
+	bool irq_disabled = cpu_enable_irq(false);
+	*(void **) block = pool->free_list;
+	pool->free_list = block;
+	pool->used--;
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+void pool_get_stat(const struct pool_t *pool, struct alloc_stat_t *stat) {
+	stat->size = pool->count;
+	stat->used = pool->used;
+	stat->high_water = pool->high_water;
+	stat->failed = pool->failed;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <pmb887x.h>
+
+/*
+ * Bump arenas and fixed-size block pools, there is no general purpose heap.
+ *
+ * alloc_intram, alloc_extram:
+ *   RAM of the linked image (BOOT_INTRAM/BOOT_FLASH: internal SRAM, BOOT_EXTRAM: SDRAM) - from the end of .bss
+ *   to the SYS stack minus ALLOC_STACK_SIZE. The other region is a window from ALLOC_INTRAM_* or ALLOC_EXTRAM_*.
+ */
+
+// Reserved for the SYS stack, which grows down to .bss
+#ifndef ALLOC_STACK_SIZE
+#define ALLOC_STACK_SIZE		0x4000
+#endif
+
+// Internal SRAM window for BOOT_EXTRAM, free after chaos bootloader has started the app
+#ifndef ALLOC_INTRAM_BASE
+#define ALLOC_INTRAM_BASE		0x00088000
+#define ALLOC_INTRAM_SIZE		0x00010000
+#endif
+
+// SDRAM window for BOOT_INTRAM/BOOT_FLASH, empty by default: SDRAM may not be initialized
+#ifndef ALLOC_EXTRAM_BASE
+#define ALLOC_EXTRAM_BASE		0xA8000000
+#define ALLOC_EXTRAM_SIZE		0
+#endif
+
+// Blocks don't share cache lines with other data (DMA buffers)
+#define ALLOC_ALIGN_CACHE		MMU_CACHE_LINE_SIZE
+
+struct arena_t {
+	uint32_t start;
+	uint32_t end;
+	uint32_t cur;
+	uint32_t high_water;
+};
+
+typedef uint32_t arena_mark_t;
+
+struct pool_t {
+	void *free_list;
+	uint32_t block_size;
+	uint32_t count;
+	uint32_t used;
+	uint32_t high_water;
+	uint32_t failed;
+};
+
+struct alloc_stat_t {
+	uint32_t size;			// bytes for arena, blocks for pool
+	uint32_t used;
+	uint32_t high_water;
+	uint32_t failed;		// pool only
+};
+
+extern struct arena_t alloc_intram;
+extern struct arena_t alloc_extram;
+
+void alloc_init(void);
+
+// Arenas are not IRQ-safe, use them from thread context only
+void arena_init(struct arena_t *arena, uint32_t base, uint32_t size);
+void *arena_alloc(struct arena_t *arena, size_t size, size_t align);
+arena_mark_t arena_mark(const struct arena_t *arena);
+void arena_reset(struct arena_t *arena, arena_mark_t mark);
+size_t arena_available(const struct arena_t *arena, size_t align);
+void arena_get_stat(const struct arena_t *arena, struct alloc_stat_t *stat);
+
+// O(1) alloc/free, safe to use from IRQ; block_size is rounded up to align
+bool pool_init(struct pool_t *pool, struct arena_t *arena, size_t block_size, uint32_t count, size_t align);
+void *pool_alloc(struct pool_t *pool);
+void pool_free(struct pool_t *pool, void *block);
+void pool_get_stat(const struct pool_t *pool, struct alloc_stat_t *stat);
@@ -0,0 +1,123 @@
+#include "bench.h"
+#include "printf.h"
+
+static uint32_t samples[BENCH_MAX_SAMPLES];
+static uint32_t cases_count;
+
+static void _bench_nop(void *ctx) {
+	(void) ctx;
+	__asm__ volatile("" ::: "memory");
+}
+
+static uint32_t __attribute__((noinline)) _sample(bench_case_func_t func, void *ctx, uint32_t batch, bool keep_irq) {
+	bool irq_disabled = keep_irq || cpu_enable_irq(false);
+
+	uint32_t start = STM_TIM0;
+	for (uint32_t i = 0; i < batch; i++)
+		func(ctx);
+	uint32_t elapsed = STM_TIM0 - start;
+
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+
+	return elapsed;
+}
+
+// Min of several runs: IRQ or cache misses can only make timed loop slower
+static uint32_t _overhead(uint32_t batch) {
+	uint32_t min = 0xFFFFFFFF;
+	for (uint32_t i = 0; i < 16; i++)
+		min = MIN(min, _sample(_bench_nop, NULL, batch, false));
+	return min;
+}
+
+static void _sort(uint32_t *values, uint32_t count) {
+	for (uint32_t gap = count / 2; gap > 0; gap /= 2) {
+		for (uint32_t i = gap; i < count; i++) {
+			uint32_t value = values[i];
+			uint32_t j = i;
+			for (; j >= gap && values[j - gap] > value; j -= gap)
+				values[j] = values[j - gap];
+			values[j] = value;
+		}
+	}
+}
+
+static void _print_fixed(const char *key, uint32_t value) {
+	printf(",\"%s\":%d.%02d", key, value / BENCH_NS_SCALE, value % BENCH_NS_SCALE);
+}
+
+void bench_begin(const char *suite) {
+	const char *boot = "intram";
+#if defined(BOOT_EXTRAM)
+	boot = "extram";
+#elif defined(BOOT_FLASH)
+	boot = "flash";
+#endif
+
+	cases_count = 0;
+
+	printf("{\"type\":\"env\",\"suite\":\"%s\",\"cpu_hz\":%d,\"sys_hz\":%d,\"stm_hz\":%d,\"boot\":\"%s\",\"cache\":%d,\"overhead_ticks\":%d}\n",
+		suite, cpu_get_freq(), cpu_get_sys_freq(), stopwatch_ticks_per_s(), boot, mmu_is_enabled(), _overhead(1));
+}
+
+void bench_run(const struct bench_t *bench, struct bench_result_t *result) {
+	bool keep_irq = (bench->flags & BENCH_KEEP_IRQ) != 0;
+	uint32_t iterations = MIN(bench->iterations ? bench->iterations : BENCH_DEFAULT_ITERATIONS, BENCH_MAX_SAMPLES);
+
+	wdt_serve();
+
+	for (uint32_t i = 0; i < BENCH_WARMUP_ITERATIONS; i++)
+		_sample(bench->func, bench->ctx, 1, keep_irq);
+
+	uint32_t batch = 1;
+	while (batch < BENCH_MAX_BATCH && _sample(bench->func, bench->ctx, batch, keep_irq) < BENCH_MIN_SAMPLE_TICKS)
+		batch *= 2;
+
+	uint32_t overhead = _overhead(batch);
+
+	// ticks per batch -> 1/BENCH_NS_SCALE ns per call
+	uint64_t ticks_per_s = stopwatch_ticks_per_s();
+	uint64_t mul = ((uint64_t) 1000000000 * BENCH_NS_SCALE << 16) / (ticks_per_s * batch);
+
+	for (uint32_t i = 0; i < iterations; i++) {
+		uint32_t ticks = _sample(bench->func, bench->ctx, batch, keep_irq);
+		ticks = ticks > overhead ? ticks - overhead : 0;
+		samples[i] = MIN(((uint64_t) ticks * mul) >> 16, 0xFFFFFFFF);
+		wdt_serve();
+	}
+
+	_sort(samples, iterations);
+
+	result->iterations = iterations;
+	result->batch = batch;
+	result->min = samples[0];
+	result->median = samples[iterations / 2];
+	result->p99 = samples[MIN(iterations * 99 / 100, iterations - 1)];
+	result->max = samples[iterations - 1];
+
+	printf("{\"type\":\"bench\",\"name\":\"%s\",\"iterations\":%d,\"batch\":%d", bench->name, iterations, batch);
+	_print_fixed("min_ns", result->min);
+	_print_fixed("median_ns", result->median);
+	_print_fixed("p99_ns", result->p99);
+	_print_fixed("max_ns", result->max);
+	printf(",\"median_cycles\":%d", (uint32_t) (((uint64_t) result->median * cpu_get_freq()) / (1000000000ULL * BENCH_NS_SCALE)));
+
+	// bytes per us == MB/s
+	if (bench->bytes && result->median)
+		_print_fixed("mb_s", ((uint64_t) bench->bytes * 1000 * BENCH_NS_SCALE * BENCH_NS_SCALE) / result->median);
+
+	printf("}\n");
+
+	cases_count++;
+}
+
+void bench_run_all(const struct bench_t *benches, uint32_t count) {
+	struct bench_result_t result;
+	for (uint32_t i = 0; i < count; i++)
+		bench_run(&benches[i], &result);
+}
+
+void bench_end(void) {
+	printf("{\"type\":\"end\",\"count\":%d}\n", cases_count);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <pmb887x.h>
+
+/*
+ * Microbenchmark harness, results are printed as JSON lines and collected by tools/bench.pl.
+ *
+ * Each sample times `batch` back-to-back calls with raw STM_TIM0 reads, batch is doubled until one sample takes at
+ * least BENCH_MIN_SAMPLE_TICKS. Cost of the empty timed loop (STM reads + indirect calls) is measured with the same
+ * batch and subtracted. IRQs are disabled while a sample is taken, unless BENCH_KEEP_IRQ is set.
+ */
+
+#define BENCH_MAX_SAMPLES			256
+#define BENCH_DEFAULT_ITERATIONS	128
+#define BENCH_WARMUP_ITERATIONS		4
+#define BENCH_MIN_SAMPLE_TICKS		256
+#define BENCH_MAX_BATCH				65536
+
+// Times in bench_result_t are in 1/BENCH_NS_SCALE ns
+#define BENCH_NS_SCALE				100
+
+// Case needs IRQ (buffered USART, DMA completion, ...)
+#define BENCH_KEEP_IRQ				(1 << 0)
+
+typedef void (*bench_case_func_t)(void *ctx);
+
+struct bench_t {
+	const char *name;			// [a-z0-9_] only, used as JSON string without escaping
+	bench_case_func_t func;
+	void *ctx;
+	uint32_t bytes;				// processed per call, adds "mb_s" to the output
+	uint32_t iterations;		// samples, 0 = BENCH_DEFAULT_ITERATIONS
+	uint32_t flags;
+};
+
+struct bench_result_t {
+	uint32_t iterations;
+	uint32_t batch;				// calls per sample
+	uint32_t min;				// per call
+	uint32_t median;
+	uint32_t p99;
+	uint32_t max;
+};
+
+// Prints {"type":"env"} line: suite name, clocks, boot mode, cache
+void bench_begin(const char *suite);
+
+// Runs case and prints {"type":"bench"} line
+void bench_run(const struct bench_t *bench, struct bench_result_t *result);
+void bench_run_all(const struct bench_t *benches, uint32_t count);
+
+// Prints {"type":"end"} line, tools/bench.pl stops reading there
+void bench_end(void);
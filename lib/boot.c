@@ -0,0 +1,32 @@
+#include "boot.h"
+#include "printf.h"
+
+uint32_t boot_timeline[BOOT_PHASE_COUNT] __attribute__((section(".noinit")));
+
+static const char * const phase_names[] = {
+	[BOOT_PHASE_START]			= "_start",
+	[BOOT_PHASE_DATA_INIT]		= "data init",
+	[BOOT_PHASE_MMU_INIT]		= "mmu init",
+	[BOOT_PHASE_CONSTRUCTORS]	= "constructors",
+	[BOOT_PHASE_MAIN]			= "main",
+};
+
+static uint32_t _ticks_to_us(uint32_t ticks) {
+	if (!stopwatch_ticks_per_us())
+		stopwatch_init();
+	return ticks / stopwatch_ticks_per_us();
+}
+
+uint32_t boot_timeline_get_us(enum boot_phase_t phase) {
+	return _ticks_to_us(boot_timeline[phase] - boot_timeline[BOOT_PHASE_START]);
+}
+
+void boot_timeline_print(void) {
+	// STM is started by BootROM, so TIM0 at _start is the time spent in BootROM and bootloader
+	printf("boot: _start at %d us after reset\n", _ticks_to_us(boot_timeline[BOOT_PHASE_START]));
+
+	for (uint32_t i = BOOT_PHASE_DATA_INIT; i < BOOT_PHASE_COUNT; i++) {
+		printf("boot: %12s: +%6d us (%6d us)\n", phase_names[i], boot_timeline_get_us(i),
+			_ticks_to_us(boot_timeline[i] - boot_timeline[i - 1]));
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <pmb887x.h>
+
+/*
+ * Startup timeline: raw STM_TIM0 values captured by _start and reset_handler().
+ * Stored in .noinit, so the _start stamp survives .data/.bss init.
+ */
+enum boot_phase_t {
+	BOOT_PHASE_START = 0,		// first instruction of _start
+	BOOT_PHASE_DATA_INIT,		// .data/.bss and vectors are ready
+	BOOT_PHASE_MMU_INIT,		// same as previous without ENABLE_CACHE
+	BOOT_PHASE_CONSTRUCTORS,	// after preinit/init arrays
+	BOOT_PHASE_MAIN,			// entering main()
+	BOOT_PHASE_COUNT
+};
+
+extern uint32_t boot_timeline[BOOT_PHASE_COUNT];
+
+inline void boot_timeline_mark(enum boot_phase_t phase) {
+	boot_timeline[phase] = STM_TIM0;
+}
+
+// Time from _start to the phase
+uint32_t boot_timeline_get_us(enum boot_phase_t phase);
+void boot_timeline_print(void);
@@ -37,8 +37,9 @@ uint32_t cpu_get_sys_freq(void) {
 uint32_t cpu_get_stm_freq(void) {
 	uint32_t freq = CPU_OSC_FREQ;
 	if ((PLL_CON1 & PLL_CON1_FSTM_DIV_EN)) {
+		// fSTM = fOSC / 2^n
 		uint32_t div = (PLL_CON1 & PLL_CON1_FSTM_DIV) >> PLL_CON1_FSTM_DIV_SHIFT;
-		return freq / div;
+		return freq >> div;
 	}
 	return freq;
 }
@@ -103,3 +104,108 @@ uint32_t cpu_get_ahb_freq(void) {
 	}
 	return 0;
 }
+
+/*
+ * PLL configurations validated with examples/pll:
+ * fPLL = fOSC * (NDIV + 1), fAHB = fPLL * 12 / (K1 * 6 + (K2 - 1)), fCPU = fAHB / (CPU_DIV + 1), fSYS = fPLL / 2
+ */
+struct cpu_clock_config_t {
+	uint32_t ndiv;
+	uint32_t k1;
+	uint32_t k2;
+	uint32_t cpu_div;
+};
+
+static const struct cpu_clock_config_t clock_profiles[] = {
+	[CPU_CLOCK_PROFILE_104MHZ]	= { .ndiv = 3, .k1 = 1, .k2 = 1, .cpu_div = 1 },
+	[CPU_CLOCK_PROFILE_208MHZ]	= { .ndiv = 3, .k1 = 1, .k2 = 1, .cpu_div = 0 },
+	[CPU_CLOCK_PROFILE_260MHZ]	= { .ndiv = 4, .k1 = 1, .k2 = 1, .cpu_div = 0 },
+	[CPU_CLOCK_PROFILE_312MHZ]	= { .ndiv = 5, .k1 = 1, .k2 = 1, .cpu_div = 0 },
+};
+
+struct cpu_pll_regs_t {
+	uint32_t osc;
+	uint32_t con0;
+	uint32_t con1;
+	uint32_t con2;
+};
+
+static struct cpu_pll_regs_t default_pll;
+static bool default_pll_saved;
+
+static void _pll_save(struct cpu_pll_regs_t *regs) {
+	regs->osc = PLL_OSC;
+	regs->con0 = PLL_CON0;
+	regs->con1 = PLL_CON1;
+	regs->con2 = PLL_CON2;
+}
+
+static void _pll_apply(const struct cpu_pll_regs_t *regs) {
+	PLL_OSC = regs->osc;
+	PLL_CON0 = regs->con0;
+	PLL_CON1 = regs->con1;
+	PLL_CON2 = regs->con2;
+	while (!(PLL_STAT & PLL_STAT_LOCK));
+}
+
+static void _pll_from_config(struct cpu_pll_regs_t *regs, const struct cpu_clock_config_t *cfg) {
+	regs->osc = (PLL_OSC & ~PLL_OSC_NDIV) | (cfg->ndiv << PLL_OSC_NDIV_SHIFT);
+	regs->con0 = (PLL_CON0 & ~(PLL_CON0_PLL1_K1 | PLL_CON0_PLL1_K2)) |
+		(cfg->k1 << PLL_CON0_PLL1_K1_SHIFT) | (cfg->k2 << PLL_CON0_PLL1_K2_SHIFT);
+	regs->con1 = (PLL_CON1 & ~(PLL_CON1_AHB_CLKSEL | PLL_CON1_FSYS_CLKSEL)) | PLL_CON1_AHB_CLKSEL_PLL1 | PLL_CON1_FSYS_CLKSEL_PLL;
+	regs->con2 = (PLL_CON2 & ~PLL_CON2_CPU_DIV) | (cfg->cpu_div << PLL_CON2_CPU_DIV_SHIFT) | PLL_CON2_CPU_DIV_EN;
+}
+
+static bool _usart_is_active(uint32_t usart) {
+	return (USART_CON(usart) & USART_CON_CON_R) != 0;
+}
+
+bool cpu_set_clock_profile(enum cpu_clock_profile_t profile) {
+	static const uint32_t usarts[] = { USART0, USART1 };
+	struct cpu_pll_regs_t regs;
+	
+	if (profile > CPU_CLOCK_PROFILE_MAX)
+		return false;
+	
+	if (!default_pll_saved) {
+		_pll_save(&default_pll);
+		default_pll_saved = true;
+	}
+	
+	if (profile == CPU_CLOCK_PROFILE_DEFAULT) {
+		regs = default_pll;
+	} else {
+		_pll_from_config(&regs, &clock_profiles[profile]);
+	}
+	
+	// Baudrate must not change in the middle of a byte
+	for (uint32_t i = 0; i < ARRAY_SIZE(usarts); i++) {
+		if (_usart_is_active(usarts[i])) {
+			usart_flush(usarts[i]);
+			while ((USART_FSTAT(usarts[i]) & USART_FSTAT_TXFFL));
+		}
+	}
+	stopwatch_usleep(CPU_CLOCK_TX_DRAIN_US);
+	
+	bool irq_disabled = cpu_enable_irq(false);
+	
+	uint32_t old_sys_freq = cpu_get_sys_freq();
+	_pll_apply(&regs);
+	uint32_t new_sys_freq = cpu_get_sys_freq();
+	
+	// Peripherals clocked from fSYS
+	for (uint32_t i = 0; i < ARRAY_SIZE(usarts); i++) {
+		if (_usart_is_active(usarts[i]))
+			usart_update_clock(usarts[i], old_sys_freq, new_sys_freq);
+	}
+	timer_update_clock(old_sys_freq, new_sys_freq);
+	
+	// STM divider is preserved, but keep stopwatch (and the watchdog interval based on it) in sync with PLL_CON1
+	stopwatch_init();
+	wdt_serve();
+	
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+	
+	return true;
+}
@@ -17,6 +17,23 @@ static inline bool cpu_enable_fiq(bool flag) {
 	return cpu_enable_irq_or_fiq(flag, 0x40);
 }
 
+// Time for the last byte in the USART shift register (one byte at 12000 baud)
+#define CPU_CLOCK_TX_DRAIN_US	1000
+
+enum cpu_clock_profile_t {
+	CPU_CLOCK_PROFILE_DEFAULT = 0,		// PLL configuration before the first cpu_set_clock_profile()
+	CPU_CLOCK_PROFILE_104MHZ,
+	CPU_CLOCK_PROFILE_208MHZ,
+	CPU_CLOCK_PROFILE_260MHZ,
+	CPU_CLOCK_PROFILE_312MHZ,
+	CPU_CLOCK_PROFILE_MAX = CPU_CLOCK_PROFILE_312MHZ,
+};
+
+/*
+ * Switch PLL and wait for lock. Active USARTs, stopwatch and software timers are updated for the new fSYS,
+ * so serial link and timeouts survive the switch.
+ */
+bool cpu_set_clock_profile(enum cpu_clock_profile_t profile);
 
 uint32_t cpu_get_freq(void);
 uint32_t cpu_get_ahb_freq(void);
@@ -0,0 +1,151 @@
+#include "dma_mem.h"
+
+#include <string.h>
+
+// Smaller transfers are faster with CPU
+#define DMA_MEM_MIN_SIZE	256
+
+#define DMA_MEM_CONTROL ( \
+	DMAC_CH_CONTROL_SB_SIZE_SZ_256 | \
+	DMAC_CH_CONTROL_DB_SIZE_SZ_256 | \
+	DMAC_CH_CONTROL_S_AHB2 | \
+	DMAC_CH_CONTROL_D_AHB2 | \
+	DMAC_CH_CONTROL_DI \
+)
+
+static void _start_batch(struct dma_mem_t *h) {
+	uint32_t width_shift = (h->control & DMAC_CH_CONTROL_S_WIDTH) >> DMAC_CH_CONTROL_S_WIDTH_SHIFT;
+	uint32_t max_batch = (DMAC_MAX_TRANSFER_SIZE << width_shift) * DMA_MEM_LLI_CNT;
+	
+	struct dmac_iovec_t iov = { h->src, h->dst, MIN(h->remain, max_batch) };
+	int lli_cnt = dmac_build_lli(h->lli, DMA_MEM_LLI_CNT, &iov, 1, h->control);
+	
+	if ((h->control & DMAC_CH_CONTROL_SI))
+		h->src += iov.size;
+	h->dst += iov.size;
+	h->remain -= iov.size;
+	
+	dmac_start(h->ch, h->lli, lli_cnt, DMAC_CH_CONFIG_FLOW_CTRL_MEM2MEM);
+}
+
+static void _dma_callback(int ch, bool error, void *ctx) {
+	struct dma_mem_t *h = ctx;
+	
+	if (!error && h->remain > 0) {
+		_start_batch(h);
+		return;
+	}
+	
+	dmac_free(ch);
+	h->error = error;
+	h->done = true;
+}
+
+static bool _start(struct dma_mem_t *h, uint8_t *dst, uint32_t src, uint32_t len, uint32_t control) {
+	h->ch = dmac_alloc(false);
+	if (h->ch < 0)
+		return false;
+	
+	h->src = src;
+	h->dst = (uint32_t) dst;
+	h->remain = len;
+	h->control = control;
+	h->error = false;
+	h->done = false;
+	
+	// Write back dirty lines and drop stale ones, CPU must not touch dst until done
+	mmu_dcache_flush_range(dst, len);
+	
+	dmac_set_callback(h->ch, _dma_callback, h);
+	_start_batch(h);
+	
+	return true;
+}
+
+static void _set_done(struct dma_mem_t *h) {
+	h->ch = -1;
+	h->error = false;
+	h->done = true;
+}
+
+bool dma_memcpy_async(struct dma_mem_t *h, void *dst, const void *src, size_t len) {
+	uint8_t *d = dst;
+	const uint8_t *s = src;
+	uint32_t control = DMA_MEM_CONTROL | DMAC_CH_CONTROL_SI;
+	
+	if (len < DMA_MEM_MIN_SIZE) {
+		memcpy(d, s, len);
+		_set_done(h);
+		return false;
+	}
+	
+	if ((((uint32_t) d ^ (uint32_t) s) & 3) == 0) {
+		// Same alignment: CPU copies head and tail, DMAC copies words
+		uint32_t head = (4 - ((uint32_t) d & 3)) & 3;
+		uint32_t tail = (len - head) & 3;
+		
+		memcpy(d, s, head);
+		memcpy(d + len - tail, s + len - tail, tail);
+		d += head;
+		s += head;
+		len -= head + tail;
+		
+		control |= DMAC_CH_CONTROL_S_WIDTH_DWORD | DMAC_CH_CONTROL_D_WIDTH_DWORD;
+	} else {
+		control |= DMAC_CH_CONTROL_S_WIDTH_BYTE | DMAC_CH_CONTROL_D_WIDTH_BYTE;
+	}
+	
+	// Source must be in memory before DMA reads it
+	mmu_dcache_clean_range(s, len);
+	
+	if (!_start(h, d, (uint32_t) s, len, control)) {
+		memcpy(d, s, len);
+		_set_done(h);
+		return false;
+	}
+	
+	return true;
+}
+
+bool dma_memset_async(struct dma_mem_t *h, void *dst, int c, size_t len) {
+	uint8_t *d = dst;
+	uint32_t control = DMA_MEM_CONTROL | DMAC_CH_CONTROL_S_WIDTH_DWORD | DMAC_CH_CONTROL_D_WIDTH_DWORD;
+	
+	if (len < DMA_MEM_MIN_SIZE) {
+		memset(d, c, len);
+		_set_done(h);
+		return false;
+	}
+	
+	uint32_t head = (4 - ((uint32_t) d & 3)) & 3;
+	uint32_t tail = (len - head) & 3;
+	
+	memset(d, c, head);
+	memset(d + len - tail, c, tail);
+	d += head;
+	len -= head + tail;
+	
+	// Fixed source address: DMAC reads the same word
+	h->fill = (uint8_t) c;
+	h->fill |= h->fill << 8;
+	h->fill |= h->fill << 16;
+	mmu_dcache_clean_range(&h->fill, sizeof(h->fill));
+	
+	if (!_start(h, d, (uint32_t) &h->fill, len, control)) {
+		memset(d, c, len);
+		_set_done(h);
+		return false;
+	}
+	
+	return true;
+}
+
+bool dma_mem_is_done(struct dma_mem_t *h) {
+	return h->done;
+}
+
+bool dma_mem_wait(struct dma_mem_t *h) {
+	while (!h->done)
+		wdt_serve();
+	return !h->error;
+}
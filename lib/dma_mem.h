@@ -0,0 +1,31 @@
+#pragma once
+
+#include <pmb887x.h>
+
+// Items per batch, next batch is started from the DMAC irq
+#define DMA_MEM_LLI_CNT		16
+
+struct dma_mem_t {
+	int ch;
+	volatile bool done;
+	volatile bool error;
+	uint32_t src;
+	uint32_t dst;
+	uint32_t remain;
+	uint32_t control;
+	uint32_t fill;
+	struct dmac_lli_t lli[DMA_MEM_LLI_CNT];
+};
+
+/*
+ * Memory copy/fill with DMAC, handle must stay valid until transfer is done.
+ * Returns false when transfer was done synchronously by CPU (too small or no free DMA channels).
+ * Unaligned head/tail are always copied by CPU.
+ * */
+bool dma_memcpy_async(struct dma_mem_t *h, void *dst, const void *src, size_t len);
+bool dma_memset_async(struct dma_mem_t *h, void *dst, int c, size_t len);
+
+bool dma_mem_is_done(struct dma_mem_t *h);
+
+// Wait for transfer with watchdog serving, returns false on DMA error
+bool dma_mem_wait(struct dma_mem_t *h);
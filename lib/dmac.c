@@ -0,0 +1,155 @@
+#include "dmac.h"
+
+struct dmac_channel_t {
+	bool used;
+	dmac_callback_t callback;
+	void *ctx;
+};
+
+static struct dmac_channel_t channels[DMAC_CHANNELS];
+
+void dmac_init(void) {
+	for (int ch = 0; ch < DMAC_CHANNELS; ch++) {
+		DMAC_CH_CONFIG(ch) = 0;
+		channels[ch].used = false;
+		channels[ch].callback = NULL;
+	}
+
+	DMAC_TC_CLEAR = 0xFF;
+	DMAC_ERR_CLEAR = 0xFF;
+	DMAC_CONFIG = DMAC_CONFIG_ENABLE | DMAC_CONFIG_M1_LE | DMAC_CONFIG_M2_LE;
+
+	NVIC_CON(NVIC_DMAC_ERR_IRQ) = 1;
+	for (int ch = 0; ch < DMAC_CHANNELS; ch++)
+		NVIC_CON(NVIC_DMAC_CH0_IRQ + ch) = 1;
+}
+
+int dmac_alloc(bool high_priority) {
+	int found = -1;
+	bool irq_disabled = cpu_enable_irq(false);
+
+	for (int i = 0; i < DMAC_CHANNELS; i++) {
+		int ch = high_priority ? i : DMAC_CHANNELS - 1 - i;
+		if (!channels[ch].used) {
+			channels[ch].used = true;
+			channels[ch].callback = NULL;
+			channels[ch].ctx = NULL;
+			found = ch;
+			break;
+		}
+	}
+
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+
+	return found;
+}
+
+void dmac_free(int ch) {
+	dmac_stop(ch);
+	channels[ch].callback = NULL;
+	channels[ch].used = false;
+}
+
+void dmac_set_callback(int ch, dmac_callback_t callback, void *ctx) {
+	channels[ch].callback = callback;
+	channels[ch].ctx = ctx;
+}
+
+void dmac_set_request_source(uint32_t line, bool alt) {
+	if (alt) {
+		SCU_DMARS |= BIT(line);
+	} else {
+		SCU_DMARS &= ~BIT(line);
+	}
+}
+
+int dmac_build_lli(struct dmac_lli_t *lli, uint32_t max_lli, const struct dmac_iovec_t *iov, uint32_t iov_cnt, uint32_t control) {
+	uint32_t width_shift = (control & DMAC_CH_CONTROL_S_WIDTH) >> DMAC_CH_CONTROL_S_WIDTH_SHIFT;
+	uint32_t lli_master = (control & DMAC_CH_CONTROL_S) ? DMAC_CH_LLI_LM_AHB2 : DMAC_CH_LLI_LM_AHB1;
+	uint32_t max_chunk = DMAC_MAX_TRANSFER_SIZE << width_shift;
+	uint32_t n = 0;
+
+	control &= ~(DMAC_CH_CONTROL_TRANSFER_SIZE | DMAC_CH_CONTROL_I);
+
+	for (uint32_t i = 0; i < iov_cnt; i++) {
+		uint32_t src = iov[i].src;
+		uint32_t dst = iov[i].dst;
+		uint32_t size = iov[i].size;
+
+		// Split chunks larger than TRANSFER_SIZE
+		while (size > 0) {
+			if (n >= max_lli)
+				return -1;
+
+			uint32_t chunk = MIN(size, max_chunk);
+			lli[n].src = src;
+			lli[n].dst = dst;
+			lli[n].control = control | (chunk >> width_shift);
+			lli[n].next = 0;
+			if (n > 0)
+				lli[n - 1].next = (uint32_t) &lli[n] | lli_master;
+
+			if ((control & DMAC_CH_CONTROL_SI))
+				src += chunk;
+			if ((control & DMAC_CH_CONTROL_DI))
+				dst += chunk;
+			size -= chunk;
+			n++;
+		}
+	}
+
+	// Interrupt only at the end of chain
+	if (n > 0)
+		lli[n - 1].control |= DMAC_CH_CONTROL_I;
+
+	return n;
+}
+
+void dmac_start(int ch, const struct dmac_lli_t *lli, uint32_t lli_cnt, uint32_t config) {
+	// Items are fetched by DMAC from memory
+	mmu_dcache_clean_range(lli, lli_cnt * sizeof(*lli));
+
+	DMAC_TC_CLEAR = BIT(ch);
+	DMAC_ERR_CLEAR = BIT(ch);
+
+	DMAC_CH_SRC_ADDR(ch) = lli[0].src;
+	DMAC_CH_DST_ADDR(ch) = lli[0].dst;
+	DMAC_CH_LLI(ch) = lli[0].next;
+	DMAC_CH_CONTROL(ch) = lli[0].control;
+	DMAC_CH_CONFIG(ch) = (config & ~DMAC_CH_CONFIG_ENABLE) | DMAC_CH_CONFIG_INT_MASK_ERR | DMAC_CH_CONFIG_INT_MASK_TC;
+	DMAC_CH_CONFIG(ch) |= DMAC_CH_CONFIG_ENABLE;
+}
+
+void dmac_stop(int ch) {
+	if (!(DMAC_CH_CONFIG(ch) & DMAC_CH_CONFIG_ENABLE))
+		return;
+
+	// Wait for the FIFO to drain before disabling channel
+	DMAC_CH_CONFIG(ch) |= DMAC_CH_CONFIG_HALT;
+	while ((DMAC_CH_CONFIG(ch) & DMAC_CH_CONFIG_ACTIVE));
+	DMAC_CH_CONFIG(ch) &= ~(DMAC_CH_CONFIG_ENABLE | DMAC_CH_CONFIG_HALT);
+}
+
+bool dmac_is_busy(int ch) {
+	return (DMAC_EN_CHAN & BIT(ch)) != 0;
+}
+
+void dmac_irq(void) {
+	uint32_t tc = DMAC_TC_STATUS;
+	uint32_t err = DMAC_ERR_STATUS;
+
+	DMAC_TC_CLEAR = tc;
+	DMAC_ERR_CLEAR = err;
+
+	for (int ch = 0; ch < DMAC_CHANNELS; ch++) {
+		if (!((tc | err) & BIT(ch)))
+			continue;
+
+		if ((err & BIT(ch)))
+			DMAC_CH_CONFIG(ch) &= ~DMAC_CH_CONFIG_ENABLE;
+
+		if (channels[ch].callback)
+			channels[ch].callback(ch, (err & BIT(ch)) != 0, channels[ch].ctx);
+	}
+}
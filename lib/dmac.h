@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+// Defined before pmb887x.h: dma_mem.h (included from there) embeds struct dmac_lli_t
+
+// Hardware linked list item (PL080)
+struct dmac_lli_t {
+	uint32_t src;
+	uint32_t dst;
+	uint32_t next;
+	uint32_t control;
+};
+
+// One chunk of scatter-gather transfer
+struct dmac_iovec_t {
+	uint32_t src;
+	uint32_t dst;
+	uint32_t size;			// in bytes, must be multiple of the source width
+};
+
+#include <pmb887x.h>
+
+#define DMAC_CHANNELS			8
+#define DMAC_MAX_TRANSFER_SIZE	4095
+
+typedef void (*dmac_callback_t)(int ch, bool error, void *ctx);
+
+void dmac_init(void);
+
+// Channel 0 has highest priority, channel 7 - lowest
+int dmac_alloc(bool high_priority);
+void dmac_free(int ch);
+void dmac_set_callback(int ch, dmac_callback_t callback, void *ctx);
+
+// Select between two peripheral request sources for the DMA request line (0..9)
+void dmac_set_request_source(uint32_t line, bool alt);
+
+// control - DMAC_CH_CONTROL_* without TRANSFER_SIZE; returns number of used items or -1 when lli[] is too small
+int dmac_build_lli(struct dmac_lli_t *lli, uint32_t max_lli, const struct dmac_iovec_t *iov, uint32_t iov_cnt, uint32_t control);
+
+// config - DMAC_CH_CONFIG_* flow control and peripherals; lli[] must stay valid until transfer is done
+void dmac_start(int ch, const struct dmac_lli_t *lli, uint32_t lli_cnt, uint32_t config);
+void dmac_stop(int ch);
+bool dmac_is_busy(int ch);
+
+// Must be called from NVIC_DMAC_ERR_IRQ and NVIC_DMAC_CH0_IRQ...NVIC_DMAC_CH7_IRQ
+void dmac_irq(void);
@@ -0,0 +1,138 @@
+#include "fiq.h"
+
+#include <string.h>
+
+// Shared with fiq_entry.S
+extern volatile uint32_t fiq_ring_head;
+extern volatile uint32_t fiq_ring_start;
+extern volatile uint32_t fiq_clear_addr;
+extern volatile uint32_t fiq_clear_value;
+
+void fiq_usart_rx_handler(void);
+void fiq_sampler_handler(void);
+void fiq_set_banked_regs(const uint32_t regs[4]);
+
+struct fiq_ring_t {
+	uint8_t *buffer;
+	uint32_t size;			// in items
+	uint32_t item_size;
+	uint32_t tail;
+	uint32_t dropped;
+	uint32_t irqs[2];
+	uint32_t irqs_cnt;
+};
+
+static struct fiq_ring_t ring;
+
+static void _fiq_setup(void (*handler)(void), uint32_t src, void *buffer, uint32_t size, uint32_t item_size) {
+	cpu_enable_fiq(false);
+
+	ring.buffer = buffer;
+	ring.size = size;
+	ring.item_size = item_size;
+	ring.tail = 0;
+	ring.dropped = 0;
+
+	fiq_ring_head = 0;
+	fiq_ring_start = (uint32_t) buffer;
+
+	// r8 - source, r9 - write pointer, r10 - end of ring, r11 - head
+	uint32_t regs[4] = { src, (uint32_t) buffer, (uint32_t) buffer + size * item_size, 0 };
+	fiq_set_banked_regs(regs);
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Warray-bounds"
+	// FIQ entry of the vectors table copied by reset_handler()
+	void (**fiq_vector)(void) = (void (**)(void)) 0x3C;
+	*fiq_vector = handler;
+#pragma GCC diagnostic pop
+
+	for (uint32_t i = 0; i < ring.irqs_cnt; i++)
+		NVIC_CON(ring.irqs[i]) = NVIC_CON_FIQ | (1 << NVIC_CON_PRIORITY_SHIFT);
+
+	cpu_enable_fiq(true);
+}
+
+void fiq_usart_rx_init(uint32_t usart, uint8_t *buffer, uint32_t size, uint32_t trigger_level, uint32_t timeout) {
+	fiq_stop();
+
+	trigger_level = MAX(1, MIN(trigger_level, USART_FIFO_SIZE));
+	USART_RXFCON(usart) = USART_RXFCON_RXFEN | USART_RXFCON_RXFFLU | (trigger_level << USART_RXFCON_RXFITL_SHIFT);
+	USART_TMO(usart) = timeout;
+
+	USART_WHBCON(usart) = USART_WHBCON_CLRPE | USART_WHBCON_CLRFE | USART_WHBCON_CLROE;
+	USART_CON(usart) |= USART_CON_FEN | USART_CON_OEN;
+
+	// Errors are not handled by FIQ
+	USART_ICR(usart) = USART_ICR_RX | USART_ICR_TMO | USART_ICR_ERR;
+	USART_IMSC(usart) = (USART_IMSC(usart) & ~USART_IMSC_ERR) | USART_IMSC_RX | USART_IMSC_TMO;
+
+	ring.irqs[0] = usart == USART0 ? NVIC_USART0_RX_IRQ : NVIC_USART1_RX_IRQ;
+	ring.irqs[1] = usart == USART0 ? NVIC_USART0_TMO_IRQ : NVIC_USART1_TMO_IRQ;
+	ring.irqs_cnt = 2;
+
+	_fiq_setup(fiq_usart_rx_handler, usart, buffer, size, 1);
+}
+
+void fiq_sampler_init(uint32_t irq, volatile uint32_t *src_reg, volatile uint32_t *clear_reg, uint32_t clear_value, uint32_t *buffer, uint32_t count) {
+	fiq_stop();
+
+	fiq_clear_addr = (uint32_t) clear_reg;
+	fiq_clear_value = clear_value;
+
+	ring.irqs[0] = irq;
+	ring.irqs_cnt = 1;
+
+	_fiq_setup(fiq_sampler_handler, (uint32_t) src_reg, buffer, count, 4);
+}
+
+void fiq_stop(void) {
+	bool fiq_disabled = cpu_enable_fiq(false);
+
+	for (uint32_t i = 0; i < ring.irqs_cnt; i++)
+		NVIC_CON(ring.irqs[i]) = 0;
+	ring.irqs_cnt = 0;
+
+	if (!fiq_disabled)
+		cpu_enable_fiq(true);
+}
+
+size_t fiq_available(void) {
+	return MIN(fiq_ring_head - ring.tail, ring.size);
+}
+
+size_t fiq_read(void *data, size_t len) {
+	uint8_t *dst = data;
+	size_t done = 0;
+
+	while (done < len) {
+		uint32_t head = fiq_ring_head;
+		uint32_t avail = head - ring.tail;
+		if (!avail)
+			break;
+
+		// Writer has overwritten the oldest items
+		if (avail > ring.size) {
+			ring.dropped += avail - ring.size;
+			ring.tail = head - ring.size;
+			avail = ring.size;
+		}
+
+		uint32_t offset = ring.tail & (ring.size - 1);
+		uint32_t chunk = MIN(MIN(len - done, avail), ring.size - offset);
+		memcpy(dst + done * ring.item_size, ring.buffer + offset * ring.item_size, chunk * ring.item_size);
+
+		// Writer could overtake us during copy, retry
+		if (fiq_ring_head - ring.tail > ring.size)
+			continue;
+
+		ring.tail += chunk;
+		done += chunk;
+	}
+
+	return done;
+}
+
+uint32_t fiq_get_dropped(void) {
+	return ring.dropped;
+}
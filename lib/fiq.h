@@ -0,0 +1,30 @@
+#pragma once
+
+#include <pmb887x.h>
+
+/*
+ * FIQ fast path for one high-rate source.
+ * Handlers (fiq_entry.S) use only banked r8-r13 and don't touch the stack, data is written to a ring buffer.
+ * Ring overflow is detected by the reader: FIQ never blocks, oldest data is overwritten and counted as dropped.
+ */
+
+// Routes NVIC_USARTx_RX_IRQ and NVIC_USARTx_TMO_IRQ to FIQ, size must be power of 2
+void fiq_usart_rx_init(uint32_t usart, uint8_t *buffer, uint32_t size, uint32_t trigger_level, uint32_t timeout);
+
+/*
+ * Stores one 32-bit sample of src_reg per FIQ (GPIO port, EXTI status, ...).
+ * clear_reg = clear_value is written after sampling when clear_reg != 0, to acknowledge the source.
+ * count must be power of 2.
+ */
+void fiq_sampler_init(uint32_t irq, volatile uint32_t *src_reg, volatile uint32_t *clear_reg, uint32_t clear_value, uint32_t *buffer, uint32_t count);
+
+// Disables NVIC lines routed to FIQ
+void fiq_stop(void);
+
+// Number of available items (bytes or samples)
+size_t fiq_available(void);
+
+// len in items, returns number of copied items
+size_t fiq_read(void *data, size_t len);
+
+uint32_t fiq_get_dropped(void);
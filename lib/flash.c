@@ -0,0 +1,935 @@
+#include "flash.h"
+
+#include <string.h>
+
+// Code which runs while flash is not in read array mode: no calls to .text (libgcc included) from there
+#define FLASH_RAMTEXT			__attribute__((section(".ramtext"), noinline))
+
+// CFI query, low byte of each word: CFI table, then PRI from its P_ADR (0x10A on Intel/ST L18/M18/P30)
+#define FLASH_QUERY_CFI_SIZE	0x40
+#define FLASH_QUERY_PRI_SIZE	0x100
+#define FLASH_QUERY_PRI			FLASH_QUERY_CFI_SIZE
+#define FLASH_QUERY_SIZE		(FLASH_QUERY_CFI_SIZE + FLASH_QUERY_PRI_SIZE)
+#define FLASH_QUERY_ADDR		(0x55 << 1)
+
+// AMD unlock cycles (x16), sent to the bank of the target address as boot/chaos_x85.S does
+#define FLASH_AMD_UNLOCK1		(0x555 << 1)
+#define FLASH_AMD_UNLOCK2		(0x2AA << 1)
+#define FLASH_AMD_BANK_MASK		0xFFFF
+
+// Watchdog toggle interval of the BOOT=flash default yield, wdt_init() uses 550 ms
+#define FLASH_WDT_INTERVAL_MS	500
+
+// Chunk of word programming, for blank skipping and verify
+#define FLASH_WORD_CHUNK		32
+#define FLASH_MIN_TIMEOUT_US	1000
+
+// CFI command set IDs
+#define FLASH_CMDSET_INTEL_EXT	0x0001
+#define FLASH_CMDSET_AMD		0x0002
+#define FLASH_CMDSET_INTEL		0x0003
+#define FLASH_CMDSET_ST			0x0200
+
+// CFI
+#define CFI_CMD_QUERY			0x98
+#define CFI_QRY					0x10
+#define CFI_PRI_VENDOR			0x13
+#define CFI_PRI_ADDR			0x15
+#define CFI_WORD_PROGRAM_TYP	0x1F
+#define CFI_BUFFER_PROGRAM_TYP	0x20
+#define CFI_BLOCK_ERASE_TYP		0x21
+#define CFI_WORD_PROGRAM_MAX	0x23
+#define CFI_BUFFER_PROGRAM_MAX	0x24
+#define CFI_BLOCK_ERASE_MAX		0x25
+#define CFI_SIZE				0x27
+#define CFI_WRITE_BUFFER		0x2A
+#define CFI_ERASE_REGIONS		0x2C
+
+// Intel/ST PRI features
+#define INTEL_PRI_SUSPEND_ERASE			BIT(1)
+#define INTEL_PRI_SUSPEND_PROGRAM		BIT(2)
+#define INTEL_PRI_PROTECTION_BITS		BIT(6)
+#define INTEL_PRI_SIMULTANEOUS_OPS		BIT(9)
+
+// AMD PRI, offsets from "PRI"
+#define AMD_PRI_ERASE_SUSPEND			0x06
+#define AMD_PRI_PROGRAM_SUSPEND			0x10
+#define AMD_PRI_BANKS					0x17
+
+// Intel/ST commands
+#define INTEL_CMD_READ_ARRAY			0xFF
+#define INTEL_CMD_READ_ID				0x90
+#define INTEL_CMD_READ_STATUS			0x70
+#define INTEL_CMD_CLEAR_STATUS			0x50
+#define INTEL_CMD_WORD_PROGRAM			0x40
+#define INTEL_CMD_BUFFER_PROGRAM		0xE8
+#define INTEL_CMD_ERASE					0x20
+#define INTEL_CMD_CONFIRM				0xD0
+#define INTEL_CMD_SUSPEND				0xB0
+#define INTEL_CMD_LOCK_SETUP			0x60
+#define INTEL_CMD_UNLOCK				0xD0
+
+#define INTEL_SR_READY					BIT(7)
+#define INTEL_SR_ERASE_SUSPENDED		BIT(6)
+#define INTEL_SR_ERASE_ERR				BIT(5)
+#define INTEL_SR_PROGRAM_ERR			BIT(4)
+#define INTEL_SR_VPP_ERR				BIT(3)
+#define INTEL_SR_LOCKED					BIT(1)
+#define INTEL_SR_ERRORS					(INTEL_SR_ERASE_ERR | INTEL_SR_PROGRAM_ERR | INTEL_SR_VPP_ERR | INTEL_SR_LOCKED)
+
+// AMD commands
+#define AMD_CMD_RESET					0xF0
+#define AMD_CMD_UNLOCK1					0xAA
+#define AMD_CMD_UNLOCK2					0x55
+#define AMD_CMD_AUTOSELECT				0x90
+#define AMD_CMD_PROGRAM					0xA0
+#define AMD_CMD_WRITE_BUFFER			0x25
+#define AMD_CMD_WRITE_BUFFER_CONFIRM	0x29
+#define AMD_CMD_ERASE_SETUP				0x80
+#define AMD_CMD_SECTOR_ERASE			0x30
+#define AMD_CMD_ERASE_SUSPEND			0xB0
+#define AMD_CMD_ERASE_RESUME			0x30
+#define AMD_CMD_DYB_ENTER				0xE0
+#define AMD_CMD_DYB_SET					0xA0
+#define AMD_CMD_DYB_UNPROTECT			0x01
+#define AMD_CMD_EXIT1					0x90
+#define AMD_CMD_EXIT2					0x00
+
+#define AMD_DQ7							BIT(7)
+#define AMD_DQ6							BIT(6)
+#define AMD_DQ5							BIT(5)
+#define AMD_DQ2							BIT(2)
+#define AMD_DQ1							BIT(1)
+
+// CP15 control register
+#define CP15_CTRL_C						BIT(2)	// D-cache
+#define CP15_CTRL_I						BIT(12)	// I-cache
+
+struct flash_query_t {
+	uint8_t data[FLASH_QUERY_SIZE];
+	uint32_t pos;
+};
+
+#ifdef BOOT_FLASH
+extern uint32_t _text, _etext;
+
+// wdt_serve() is in .text, which is in flash: toggle the watchdog pin from RAM
+static FLASH_RAMTEXT void _wdt_yield(void *ctx) {
+	struct flash_t *flash = ctx;
+	if (STM_TIM0 - flash->wdt_last >= flash->wdt_interval) {
+		GPIO_PIN(GPIO_PM_WADOG) ^= GPIO_DATA_HIGH;
+		flash->wdt_last = STM_TIM0;
+	}
+}
+#else
+static void _wdt_yield(void *ctx) {
+	(void) ctx;
+	wdt_serve();
+}
+#endif
+
+/*
+ * Cache, CACHE=1 maps flash write-through (lib/mmu.c). Cached reads of a busy bank would return stale status, and
+ * linefills would eat AMD toggle bits: D-cache is off while the flash is not in read array mode. It is cleaned and
+ * invalidated before, so nothing there can become stale. I-cache is invalidated after, flash contents have changed.
+ * Nested calls are fine: the inner one sees D-cache already off.
+ * */
+static inline __attribute__((always_inline)) uint32_t _cp15_get_ctrl(void) {
+	uint32_t value;
+	__asm__ volatile("MRC p15, 0, %0, c1, c0, 0" : "=r" (value));
+	return value;
+}
+
+static inline __attribute__((always_inline)) void _cp15_set_ctrl(uint32_t value) {
+	__asm__ volatile("MCR p15, 0, %0, c1, c0, 0" : : "r" (value) : "memory");
+}
+
+// Returns the previous CP15 control for _cache_restore()
+static FLASH_RAMTEXT uint32_t _cache_disable(void) {
+	bool irq_disabled = cpu_enable_irq(false);
+	uint32_t ctrl = _cp15_get_ctrl();
+	if ((ctrl & CP15_CTRL_C)) {
+		// Test, clean and invalidate
+		__asm__ volatile(
+			"1: \n"
+			"MRC p15, 0, r15, c7, c14, 3 \n"
+			"BNE 1b \n"
+			: : : "cc", "memory"
+		);
+		__asm__ volatile("MCR p15, 0, %0, c7, c10, 4" : : "r" (0) : "memory");
+		_cp15_set_ctrl(ctrl & ~CP15_CTRL_C);
+	}
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+	return ctrl;
+}
+
+static FLASH_RAMTEXT void _cache_restore(uint32_t ctrl) {
+	if ((ctrl & CP15_CTRL_I))
+		__asm__ volatile("MCR p15, 0, %0, c7, c5, 0" : : "r" (0) : "memory");
+	if ((ctrl & CP15_CTRL_C))
+		_cp15_set_ctrl(_cp15_get_ctrl() | CP15_CTRL_C);
+}
+
+static FLASH_RAMTEXT void _yield(struct flash_t *flash) {
+	if (flash->yield)
+		flash->yield(flash->yield_ctx);
+}
+
+static FLASH_RAMTEXT bool _is_timeout(uint32_t start, uint32_t timeout) {
+	return STM_TIM0 - start > timeout;
+}
+
+static FLASH_RAMTEXT void _copy(uint8_t *dst, const volatile uint8_t *src, uint32_t size) {
+	while (size--)
+		*dst++ = *src++;
+}
+
+// start is relative to the flash base
+static FLASH_RAMTEXT bool _find_region(const struct flash_region_t *regions, uint32_t cnt, uint32_t offset, uint32_t *start, uint32_t *size) {
+	uint32_t pos = 0;
+	for (uint32_t i = 0; i < cnt; i++) {
+		for (uint32_t j = 0; j < regions[i].count; j++) {
+			if (offset < pos + regions[i].size) {
+				*start = pos;
+				*size = regions[i].size;
+				return true;
+			}
+			pos += regions[i].size;
+		}
+	}
+	return false;
+}
+
+/*
+ * CFI query and ID
+ * */
+static FLASH_RAMTEXT void _read_query(uint32_t base, uint8_t *data) {
+	bool irq_disabled = cpu_enable_irq(false);
+	uint32_t cache = _cache_disable();
+
+	MMIO16(base + FLASH_QUERY_ADDR) = CFI_CMD_QUERY;
+	for (uint32_t i = 0; i < FLASH_QUERY_CFI_SIZE; i++)
+		data[i] = MMIO16(base + i * 2);
+
+	uint32_t pri_addr = data[CFI_PRI_ADDR] | (data[CFI_PRI_ADDR + 1] << 8);
+	if (pri_addr) {
+		for (uint32_t i = 0; i < FLASH_QUERY_PRI_SIZE; i++)
+			data[FLASH_QUERY_PRI + i] = MMIO16(base + (pri_addr + i) * 2);
+	}
+
+	// Command set is not known yet: AMD and Intel way
+	MMIO16(base) = AMD_CMD_RESET;
+	MMIO16(base) = INTEL_CMD_READ_ARRAY;
+
+	_cache_restore(cache);
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+static FLASH_RAMTEXT void _amd_unlock(struct flash_t *flash, uint32_t addr) {
+	uint32_t bank = addr & ~FLASH_AMD_BANK_MASK;
+	MMIO16(bank + flash->amd_unlock1) = AMD_CMD_UNLOCK1;
+	MMIO16(bank + flash->amd_unlock2) = AMD_CMD_UNLOCK2;
+}
+
+static FLASH_RAMTEXT void _amd_cmd(struct flash_t *flash, uint32_t addr, uint16_t cmd) {
+	_amd_unlock(flash, addr);
+	MMIO16((addr & ~FLASH_AMD_BANK_MASK) + flash->amd_unlock1) = cmd;
+}
+
+static FLASH_RAMTEXT void _read_id(struct flash_t *flash) {
+	uint32_t base = flash->base;
+	bool irq_disabled = cpu_enable_irq(false);
+	uint32_t cache = _cache_disable();
+
+	if (flash->type == FLASH_TYPE_AMD) {
+		_amd_cmd(flash, base, AMD_CMD_AUTOSELECT);
+		flash->vid = MMIO16(base);
+		flash->pid = MMIO16(base + 2);
+		MMIO16(base) = AMD_CMD_RESET;
+	} else {
+		MMIO16(base) = INTEL_CMD_READ_ID;
+		flash->vid = MMIO16(base);
+		flash->pid = MMIO16(base + 2);
+		// 0xF0 from _read_query() is a command sequence error for Intel
+		MMIO16(base) = INTEL_CMD_CLEAR_STATUS;
+		MMIO16(base) = INTEL_CMD_READ_ARRAY;
+	}
+
+	_cache_restore(cache);
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+/*
+ * Intel/ST
+ * */
+static FLASH_RAMTEXT int _intel_result(uint32_t addr, uint16_t status) {
+	int ret = FLASH_OK;
+	if ((status & INTEL_SR_LOCKED)) {
+		ret = FLASH_ERR_LOCKED;
+	} else if ((status & INTEL_SR_VPP_ERR)) {
+		ret = FLASH_ERR_VPP;
+	} else if ((status & INTEL_SR_ERASE_ERR)) {
+		ret = FLASH_ERR_ERASE;
+	} else if ((status & INTEL_SR_PROGRAM_ERR)) {
+		ret = FLASH_ERR_PROGRAM;
+	}
+
+	if ((status & INTEL_SR_ERRORS))
+		MMIO16(addr) = INTEL_CMD_CLEAR_STATUS;
+	MMIO16(addr) = INTEL_CMD_READ_ARRAY;
+	return ret;
+}
+
+static FLASH_RAMTEXT int _intel_wait(struct flash_t *flash, uint32_t addr, uint32_t timeout) {
+	uint32_t start = STM_TIM0;
+	uint16_t status;
+	while (!((status = MMIO16(addr)) & INTEL_SR_READY)) {
+		if (_is_timeout(start, timeout)) {
+			MMIO16(addr) = INTEL_CMD_READ_ARRAY;
+			return FLASH_ERR_TIMEOUT;
+		}
+		_yield(flash);
+	}
+	return _intel_result(addr, status);
+}
+
+static FLASH_RAMTEXT void _intel_unlock(uint32_t addr) {
+	bool irq_disabled = cpu_enable_irq(false);
+	uint32_t cache = _cache_disable();
+	MMIO16(addr) = INTEL_CMD_LOCK_SETUP;
+	MMIO16(addr) = INTEL_CMD_UNLOCK;
+	MMIO16(addr) = INTEL_CMD_READ_ARRAY;
+	_cache_restore(cache);
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+static FLASH_RAMTEXT int _intel_program_word(struct flash_t *flash, uint32_t addr, uint16_t value) {
+	bool irq_disabled = cpu_enable_irq(false);
+	MMIO16(addr) = INTEL_CMD_WORD_PROGRAM;
+	MMIO16(addr) = value;
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+	return _intel_wait(flash, addr, flash->word_timeout);
+}
+
+static FLASH_RAMTEXT int _intel_program_buffer(struct flash_t *flash, uint32_t addr, const uint16_t *data, uint32_t words) {
+	bool irq_disabled = cpu_enable_irq(false);
+
+	// Buffer is not available while the previous operation is running, 0xE8 is repeated until it is
+	uint32_t start = STM_TIM0;
+	bool ready;
+	do {
+		MMIO16(addr) = INTEL_CMD_BUFFER_PROGRAM;
+		ready = (MMIO16(addr) & INTEL_SR_READY) != 0;
+	} while (!ready && !_is_timeout(start, flash->buffer_timeout));
+
+	if (ready) {
+		MMIO16(addr) = words - 1;
+		for (uint32_t i = 0; i < words; i++)
+			MMIO16(addr + i * 2) = data[i];
+		MMIO16(addr) = INTEL_CMD_CONFIRM;
+	} else {
+		MMIO16(addr) = INTEL_CMD_READ_ARRAY;
+	}
+
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+
+	if (!ready)
+		return FLASH_ERR_TIMEOUT;
+	return _intel_wait(flash, addr, flash->buffer_timeout);
+}
+
+/*
+ * AMD
+ * */
+static FLASH_RAMTEXT void _amd_reset(struct flash_t *flash, uint32_t addr) {
+	// Also leaves write-to-buffer-abort state
+	_amd_unlock(flash, addr);
+	MMIO16(addr) = AMD_CMD_RESET;
+}
+
+// Data polling on the last written word
+static FLASH_RAMTEXT int _amd_wait_program(struct flash_t *flash, uint32_t addr, uint16_t value, uint32_t timeout) {
+	uint32_t start = STM_TIM0;
+	while (true) {
+		uint16_t status = MMIO16(addr);
+		if (!((status ^ value) & AMD_DQ7))
+			return FLASH_OK;
+
+		// DQ5 - internal timeout, DQ1 - write buffer abort; DQ7 can change together with them
+		if ((status & (AMD_DQ5 | AMD_DQ1))) {
+			status = MMIO16(addr);
+			if (!((status ^ value) & AMD_DQ7))
+				return FLASH_OK;
+			_amd_reset(flash, addr);
+			return FLASH_ERR_PROGRAM;
+		}
+
+		if (_is_timeout(start, timeout)) {
+			_amd_reset(flash, addr);
+			return FLASH_ERR_TIMEOUT;
+		}
+
+		_yield(flash);
+	}
+}
+
+// Dynamic protection bit of the sector, same sequence as boot/chaos_x85.S
+static FLASH_RAMTEXT void _amd_unlock_sector(struct flash_t *flash, uint32_t addr) {
+	bool irq_disabled = cpu_enable_irq(false);
+	uint32_t cache = _cache_disable();
+	_amd_cmd(flash, addr, AMD_CMD_DYB_ENTER);
+	MMIO16(addr) = AMD_CMD_DYB_SET;
+	MMIO16(addr) = AMD_CMD_DYB_UNPROTECT;
+	MMIO16(addr) = AMD_CMD_EXIT1;
+	MMIO16(addr) = AMD_CMD_EXIT2;
+	_cache_restore(cache);
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+static FLASH_RAMTEXT int _amd_program_word(struct flash_t *flash, uint32_t addr, uint16_t value) {
+	bool irq_disabled = cpu_enable_irq(false);
+	_amd_cmd(flash, addr, AMD_CMD_PROGRAM);
+	MMIO16(addr) = value;
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+	return _amd_wait_program(flash, addr, value, flash->word_timeout);
+}
+
+static FLASH_RAMTEXT int _amd_program_buffer(struct flash_t *flash, uint32_t addr, const uint16_t *data, uint32_t words) {
+	bool irq_disabled = cpu_enable_irq(false);
+	_amd_unlock(flash, addr);
+	MMIO16(addr) = AMD_CMD_WRITE_BUFFER;
+	MMIO16(addr) = words - 1;
+	for (uint32_t i = 0; i < words; i++)
+		MMIO16(addr + i * 2) = data[i];
+	MMIO16(addr) = AMD_CMD_WRITE_BUFFER_CONFIRM;
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+	return _amd_wait_program(flash, addr + (words - 1) * 2, data[words - 1], flash->buffer_timeout);
+}
+
+// DQ6 toggles while erasing
+static FLASH_RAMTEXT int _amd_erase_status(struct flash_t *flash, uint32_t addr) {
+	uint16_t a = MMIO16(addr);
+	uint16_t b = MMIO16(addr);
+	if (!((a ^ b) & AMD_DQ6))
+		return FLASH_OK;
+
+	if ((b & AMD_DQ5)) {
+		a = MMIO16(addr);
+		b = MMIO16(addr);
+		if (!((a ^ b) & AMD_DQ6))
+			return FLASH_OK;
+		_amd_reset(flash, addr);
+		return FLASH_ERR_ERASE;
+	}
+
+	return FLASH_ERR_BUSY;
+}
+
+/*
+ * Erase
+ * */
+static FLASH_RAMTEXT void _erase_start(struct flash_t *flash, uint32_t addr) {
+	// Restored by _erase_done()
+	flash->erase_cache = _cache_disable();
+
+	if (flash->type == FLASH_TYPE_AMD) {
+		_amd_unlock_sector(flash, addr);
+	} else {
+		_intel_unlock(addr);
+	}
+
+	bool irq_disabled = cpu_enable_irq(false);
+	if (flash->type == FLASH_TYPE_AMD) {
+		_amd_cmd(flash, addr, AMD_CMD_ERASE_SETUP);
+		_amd_unlock(flash, addr);
+		MMIO16(addr) = AMD_CMD_SECTOR_ERASE;
+	} else {
+		MMIO16(addr) = INTEL_CMD_ERASE;
+		MMIO16(addr) = INTEL_CMD_CONFIRM;
+	}
+	flash->erase_addr = addr;
+	flash->erase_start = STM_TIM0;
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+static FLASH_RAMTEXT void _erase_done(struct flash_t *flash, int result) {
+	flash->erase_addr = 0;
+	flash->erase_result = result;
+	_cache_restore(flash->erase_cache);
+}
+
+// Erase result, or FLASH_ERR_BUSY
+static FLASH_RAMTEXT int _erase_status(struct flash_t *flash) {
+	uint32_t addr = flash->erase_addr;
+	int ret;
+
+	if (flash->type == FLASH_TYPE_AMD) {
+		ret = _amd_erase_status(flash, addr);
+	} else {
+		uint16_t status = MMIO16(addr);
+		ret = (status & INTEL_SR_READY) ? _intel_result(addr, status) : FLASH_ERR_BUSY;
+	}
+
+	if (ret == FLASH_ERR_BUSY && _is_timeout(flash->erase_start, flash->erase_timeout)) {
+		if (flash->type == FLASH_TYPE_AMD) {
+			_amd_reset(flash, addr);
+		} else {
+			MMIO16(addr) = INTEL_CMD_READ_ARRAY;
+		}
+		ret = FLASH_ERR_TIMEOUT;
+	}
+
+	if (ret != FLASH_ERR_BUSY)
+		_erase_done(flash, ret);
+	return ret;
+}
+
+// FLASH_ERR_BUSY when suspended (bank is in read array mode), otherwise erase is already done and this is its result
+static FLASH_RAMTEXT int _erase_suspend(struct flash_t *flash) {
+	uint32_t addr = flash->erase_addr;
+	uint32_t start = STM_TIM0;
+	bool irq_disabled = cpu_enable_irq(false);
+	int ret;
+
+	if (flash->type == FLASH_TYPE_AMD) {
+		MMIO16(addr) = AMD_CMD_ERASE_SUSPEND;
+
+		// DQ6 stops toggling when suspended, then DQ2 still toggles in the suspended sector
+		while (((MMIO16(addr) ^ MMIO16(addr)) & AMD_DQ6) && !_is_timeout(start, flash->word_timeout));
+		ret = ((MMIO16(addr) ^ MMIO16(addr)) & AMD_DQ2) ? FLASH_ERR_BUSY : FLASH_OK;
+	} else {
+		MMIO16(addr) = INTEL_CMD_SUSPEND;
+		MMIO16(addr) = INTEL_CMD_READ_STATUS;
+
+		uint16_t status;
+		while (!((status = MMIO16(addr)) & INTEL_SR_READY) && !_is_timeout(start, flash->word_timeout));
+
+		if ((status & INTEL_SR_ERASE_SUSPENDED)) {
+			MMIO16(addr) = INTEL_CMD_READ_ARRAY;
+			ret = FLASH_ERR_BUSY;
+		} else {
+			ret = _intel_result(addr, status);
+		}
+	}
+
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+
+	if (ret != FLASH_ERR_BUSY)
+		_erase_done(flash, ret);
+	return ret;
+}
+
+static FLASH_RAMTEXT void _erase_resume(struct flash_t *flash, uint32_t suspended_ticks) {
+	uint32_t addr = flash->erase_addr;
+	bool irq_disabled = cpu_enable_irq(false);
+	MMIO16(addr) = flash->type == FLASH_TYPE_AMD ? AMD_CMD_ERASE_RESUME : INTEL_CMD_CONFIRM;
+	// Suspended time doesn't count for the erase timeout
+	flash->erase_start += suspended_ticks;
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+FLASH_RAMTEXT int flash_erase_wait(struct flash_t *flash) {
+	while (flash->erase_addr && _erase_status(flash) == FLASH_ERR_BUSY)
+		_yield(flash);
+	return flash->erase_result;
+}
+
+FLASH_RAMTEXT int flash_read(struct flash_t *flash, void *dst, uint32_t addr, uint32_t size) {
+	uint32_t offset = addr - flash->base;
+	if (addr < flash->base || offset > flash->size || size > flash->size - offset)
+		return FLASH_ERR_INVALID;
+
+	uint32_t bank_start = 0;
+	uint32_t bank_size = 0;
+	if (flash->erase_addr)
+		_find_region(flash->bank_regions, flash->bank_regions_cnt, flash->erase_addr - flash->base, &bank_start, &bank_size);
+
+	// Other banks are readable while erasing
+	if (!flash->erase_addr || offset >= bank_start + bank_size || offset + size <= bank_start) {
+		_copy(dst, (const volatile uint8_t *) addr, size);
+		return FLASH_OK;
+	}
+
+	if (!flash->erase_suspend) {
+		flash_erase_wait(flash);
+		_copy(dst, (const volatile uint8_t *) addr, size);
+		return FLASH_OK;
+	}
+
+	uint32_t suspended_at = STM_TIM0;
+	int ret = _erase_suspend(flash);
+	_copy(dst, (const volatile uint8_t *) addr, size);
+	if (ret == FLASH_ERR_BUSY)
+		_erase_resume(flash, STM_TIM0 - suspended_at);
+
+	return FLASH_OK;
+}
+
+/*
+ * CFI/PRI parsing, same layout as tools/lib/Sie/CFI.pm
+ * */
+static uint32_t _query_read(struct flash_query_t *q, uint32_t bytes) {
+	uint32_t value = 0;
+	for (uint32_t i = 0; i < bytes; i++) {
+		if (q->pos < FLASH_QUERY_SIZE)
+			value |= q->data[q->pos] << (i * 8);
+		q->pos++;
+	}
+	return value;
+}
+
+static void _add_region(struct flash_region_t *regions, uint32_t *cnt, uint32_t max, uint32_t count, uint32_t size) {
+	if (*cnt > 0 && regions[*cnt - 1].size == size) {
+		regions[*cnt - 1].count += count;
+	} else if (*cnt < max) {
+		regions[*cnt].count = count;
+		regions[*cnt].size = size;
+		(*cnt)++;
+	}
+}
+
+static uint32_t _regions_size(const struct flash_region_t *regions, uint32_t cnt) {
+	uint32_t size = 0;
+	for (uint32_t i = 0; i < cnt; i++)
+		size += regions[i].count * regions[i].size;
+	return size;
+}
+
+static void _parse_intel_pri(struct flash_t *flash, struct flash_query_t *q) {
+	uint32_t features = _query_read(q, 4);
+	q->pos += 1 + 2 + 2;	// functions after suspend, block protect status, Vdd/Vpp optimum
+
+	flash->erase_suspend = (features & INTEL_PRI_SUSPEND_ERASE) != 0;
+	flash->program_suspend = (features & INTEL_PRI_SUSPEND_PROGRAM) != 0;
+
+	// Partitions are known only since PRI 1.3
+	if (flash->pri_version < 0x0103)
+		return;
+
+	if ((features & INTEL_PRI_PROTECTION_BITS)) {
+		uint32_t otp_fields = _query_read(q, 1);
+		if (otp_fields)
+			q->pos += 4 + (otp_fields - 1) * 10;
+	}
+
+	q->pos += 1;	// page mode
+	q->pos += _query_read(q, 1);	// sync mode configurations
+
+	if (!(features & INTEL_PRI_SIMULTANEOUS_OPS))
+		return;
+
+	uint32_t regions = _query_read(q, 1);
+	for (uint32_t i = 0; i < regions; i++) {
+		uint32_t region_start = q->pos;
+		uint32_t region_size = flash->cmdset == FLASH_CMDSET_ST ? _query_read(q, 2) : 0;
+
+		uint32_t banks = _query_read(q, 2);
+		q->pos += 3;	// simultaneous operations
+
+		uint32_t erase_regions = _query_read(q, 1);
+		uint32_t bank_size = 0;
+		for (uint32_t j = 0; j < erase_regions; j++) {
+			uint32_t blocks = _query_read(q, 2) + 1;
+			uint32_t block_size = _query_read(q, 2) * 256;
+			q->pos += flash->cmdset == FLASH_CMDSET_ST ? 10 : 4;
+			bank_size += blocks * block_size;
+		}
+
+		if (region_size)
+			q->pos = region_start + region_size;
+
+		_add_region(flash->bank_regions, &flash->bank_regions_cnt, FLASH_MAX_BANK_REGIONS, banks, bank_size);
+	}
+}
+
+// pri - PRI position in the query data
+static void _parse_amd_pri(struct flash_t *flash, struct flash_query_t *q, uint32_t pri) {
+	q->pos = pri + AMD_PRI_ERASE_SUSPEND;
+	flash->erase_suspend = _query_read(q, 1) != 0;
+
+	if (flash->pri_version < 0x0103)
+		return;
+
+	q->pos = pri + AMD_PRI_PROGRAM_SUSPEND;
+	flash->program_suspend = _query_read(q, 1) != 0;
+
+	// Sectors per bank, bank size is the sum of its sectors from CFI erase regions
+	q->pos = pri + AMD_PRI_BANKS;
+	uint32_t banks = _query_read(q, 1);
+	uint32_t region = 0;
+	uint32_t block = 0;
+	for (uint32_t i = 0; i < banks; i++) {
+		uint32_t sectors = _query_read(q, 1);
+		uint32_t bank_size = 0;
+		while (sectors-- && region < flash->erase_regions_cnt) {
+			bank_size += flash->erase_regions[region].size;
+			if (++block >= flash->erase_regions[region].count) {
+				region++;
+				block = 0;
+			}
+		}
+		_add_region(flash->bank_regions, &flash->bank_regions_cnt, FLASH_MAX_BANK_REGIONS, 1, bank_size);
+	}
+}
+
+static uint32_t _timeout_ticks(uint32_t us) {
+	return (uint64_t) MAX(us, FLASH_MIN_TIMEOUT_US) * stopwatch_ticks_per_s() / 1000000;
+}
+
+int flash_init(struct flash_t *flash, uint32_t base) {
+	memset(flash, 0, sizeof(*flash));
+	flash->base = base;
+	flash->amd_unlock1 = FLASH_AMD_UNLOCK1;
+	flash->amd_unlock2 = FLASH_AMD_UNLOCK2;
+	flash->yield = _wdt_yield;
+	flash->yield_ctx = flash;
+
+	struct flash_query_t q = { .pos = 0 };
+	_read_query(base, q.data);
+
+	if (q.data[CFI_QRY] != 'Q' || q.data[CFI_QRY + 1] != 'R' || q.data[CFI_QRY + 2] != 'Y')
+		return FLASH_ERR_NOT_FOUND;
+
+	q.pos = CFI_PRI_VENDOR;
+	flash->cmdset = _query_read(&q, 2);
+	uint32_t pri_addr = _query_read(&q, 2);
+
+	if (flash->cmdset == FLASH_CMDSET_AMD) {
+		flash->type = FLASH_TYPE_AMD;
+	} else if (flash->cmdset == FLASH_CMDSET_INTEL_EXT || flash->cmdset == FLASH_CMDSET_INTEL || flash->cmdset == FLASH_CMDSET_ST) {
+		flash->type = FLASH_TYPE_INTEL;
+	} else {
+		return FLASH_ERR_UNSUPPORTED;
+	}
+
+	// Typical time 2^N, max time is typical * 2^M
+	const uint8_t *cfi = q.data;
+	flash->word_program_us = (1 << cfi[CFI_WORD_PROGRAM_TYP]) << cfi[CFI_WORD_PROGRAM_MAX];
+	flash->buffer_program_us = cfi[CFI_BUFFER_PROGRAM_TYP] ? (1 << cfi[CFI_BUFFER_PROGRAM_TYP]) << cfi[CFI_BUFFER_PROGRAM_MAX] : 0;
+	flash->block_erase_ms = (1 << cfi[CFI_BLOCK_ERASE_TYP]) << cfi[CFI_BLOCK_ERASE_MAX];
+	flash->size = 1 << cfi[CFI_SIZE];
+
+	// Write buffer is unsupported when its program time is 0
+	q.pos = CFI_WRITE_BUFFER;
+	uint32_t write_buffer = _query_read(&q, 2);
+	flash->write_buffer_size = write_buffer && flash->buffer_program_us ? 1 << write_buffer : 0;
+
+	q.pos = CFI_ERASE_REGIONS;
+	uint32_t erase_regions = _query_read(&q, 1);
+	for (uint32_t i = 0; i < erase_regions; i++) {
+		uint32_t blocks = _query_read(&q, 2) + 1;
+		uint32_t block_size = _query_read(&q, 2) * 256;
+		_add_region(flash->erase_regions, &flash->erase_regions_cnt, FLASH_MAX_ERASE_REGIONS, blocks, block_size ? block_size : 128);
+	}
+
+	if (_regions_size(flash->erase_regions, flash->erase_regions_cnt) != flash->size)
+		return FLASH_ERR_UNSUPPORTED;
+
+	q.pos = FLASH_QUERY_PRI;
+	if (pri_addr && _query_read(&q, 3) == ('P' | ('R' << 8) | ('I' << 16))) {
+		uint32_t major = _query_read(&q, 1) - '0';
+		uint32_t minor = _query_read(&q, 1) - '0';
+		flash->pri_version = (major << 8) | minor;
+
+		if (flash->type == FLASH_TYPE_AMD) {
+			_parse_amd_pri(flash, &q, FLASH_QUERY_PRI);
+		} else {
+			_parse_intel_pri(flash, &q);
+		}
+	}
+
+	// Whole chip is one bank when PRI has no (valid) bank info
+	if (_regions_size(flash->bank_regions, flash->bank_regions_cnt) != flash->size) {
+		flash->bank_regions[0].count = 1;
+		flash->bank_regions[0].size = flash->size;
+		flash->bank_regions_cnt = 1;
+	}
+
+	flash->word_timeout = _timeout_ticks(flash->word_program_us);
+	flash->buffer_timeout = _timeout_ticks(flash->buffer_program_us);
+	flash->erase_timeout = _timeout_ticks(flash->block_erase_ms * 1000);
+	flash->wdt_interval = _timeout_ticks(FLASH_WDT_INTERVAL_MS * 1000);
+	flash->wdt_last = STM_TIM0;
+
+	_read_id(flash);
+
+	return FLASH_OK;
+}
+
+void flash_set_yield(struct flash_t *flash, flash_yield_t yield, void *ctx) {
+	flash->yield = yield;
+	flash->yield_ctx = ctx;
+}
+
+bool flash_get_block(const struct flash_t *flash, uint32_t addr, uint32_t *start, uint32_t *size) {
+	if (addr < flash->base || !_find_region(flash->erase_regions, flash->erase_regions_cnt, addr - flash->base, start, size))
+		return false;
+	*start += flash->base;
+	return true;
+}
+
+bool flash_get_bank(const struct flash_t *flash, uint32_t addr, uint32_t *start, uint32_t *size) {
+	if (addr < flash->base || !_find_region(flash->bank_regions, flash->bank_regions_cnt, addr - flash->base, start, size))
+		return false;
+	*start += flash->base;
+	return true;
+}
+
+// Banks with .text, IRQ handlers included: nothing from there can run while they are busy
+static bool _is_code_bank(const struct flash_t *flash, uint32_t addr, uint32_t size) {
+#ifdef BOOT_FLASH
+	uint32_t text_start, text_end, bank_start, bank_size;
+	if (!flash_get_bank(flash, (uint32_t) &_text, &text_start, &bank_size))
+		return false;
+
+	if (flash_get_bank(flash, (uint32_t) &_etext - 1, &bank_start, &bank_size)) {
+		text_end = bank_start + bank_size;
+	} else {
+		text_end = flash->base + flash->size;
+	}
+
+	return addr < text_end && addr + size > text_start;
+#else
+	(void) flash;
+	(void) addr;
+	(void) size;
+	return false;
+#endif
+}
+
+// Whole erase from .ramtext with IRQs masked
+static FLASH_RAMTEXT void _erase_sync(struct flash_t *flash, uint32_t addr) {
+	bool irq_disabled = cpu_enable_irq(false);
+	_erase_start(flash, addr);
+	flash_erase_wait(flash);
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+int flash_erase_async(struct flash_t *flash, uint32_t addr) {
+	if (flash->erase_addr)
+		return FLASH_ERR_BUSY;
+
+	uint32_t start, size;
+	if (!flash_get_block(flash, addr, &start, &size) || start != addr)
+		return FLASH_ERR_INVALID;
+
+	// Returning to .text is not possible while its bank is busy: flash_erase_poll() gets the result right away
+	if (_is_code_bank(flash, addr, size)) {
+		_erase_sync(flash, addr);
+		return FLASH_OK;
+	}
+
+	_erase_start(flash, addr);
+	return FLASH_OK;
+}
+
+int flash_erase_poll(struct flash_t *flash) {
+	if (!flash->erase_addr)
+		return flash->erase_result;
+	return _erase_status(flash);
+}
+
+int flash_erase(struct flash_t *flash, uint32_t addr) {
+	int ret = flash_erase_async(flash, addr);
+	if (ret)
+		return ret;
+	return flash_erase_wait(flash);
+}
+
+static bool _is_blank(const uint16_t *data, uint32_t words) {
+	for (uint32_t i = 0; i < words; i++) {
+		if (data[i] != 0xFFFF)
+			return false;
+	}
+	return true;
+}
+
+static int _program_chunk(struct flash_t *flash, uint32_t addr, const uint16_t *data, uint32_t words) {
+	if (flash->write_buffer_size) {
+		if (flash->type == FLASH_TYPE_AMD)
+			return _amd_program_buffer(flash, addr, data, words);
+		return _intel_program_buffer(flash, addr, data, words);
+	}
+
+	for (uint32_t i = 0; i < words; i++) {
+		int ret;
+		if (flash->type == FLASH_TYPE_AMD) {
+			ret = _amd_program_word(flash, addr + i * 2, data[i]);
+		} else {
+			ret = _intel_program_word(flash, addr + i * 2, data[i]);
+		}
+		if (ret)
+			return ret;
+	}
+	return FLASH_OK;
+}
+
+static int _program(struct flash_t *flash, uint32_t addr, const void *data, uint32_t size) {
+	const uint16_t *src = data;
+	uint32_t block_end = addr;
+	while (size > 0) {
+		// Buffer chunks must not cross the write buffer boundary
+		uint32_t chunk;
+		if (flash->write_buffer_size) {
+			chunk = MIN(size, flash->write_buffer_size - (addr & (flash->write_buffer_size - 1)));
+		} else {
+			chunk = MIN(size, FLASH_WORD_CHUNK);
+		}
+
+		if (!_is_blank(src, chunk / 2)) {
+			if (addr >= block_end) {
+				uint32_t block_start, block_size;
+				flash_get_block(flash, addr, &block_start, &block_size);
+				block_end = block_start + block_size;
+
+				if (flash->type == FLASH_TYPE_AMD) {
+					_amd_unlock_sector(flash, block_start);
+				} else {
+					_intel_unlock(block_start);
+				}
+			}
+
+			int ret = _program_chunk(flash, addr, src, chunk / 2);
+			if (ret)
+				return ret;
+
+			if (memcmp((const void *) addr, src, chunk) != 0)
+				return FLASH_ERR_PROGRAM;
+		}
+
+		addr += chunk;
+		src += chunk / 2;
+		size -= chunk;
+	}
+
+	return FLASH_OK;
+}
+
+int flash_program(struct flash_t *flash, uint32_t addr, const void *data, uint32_t size) {
+	uint32_t offset = addr - flash->base;
+	if (flash->erase_addr)
+		return FLASH_ERR_BUSY;
+	if (((addr | (uint32_t) data | size) & 1) || addr < flash->base || offset > flash->size || size > flash->size - offset)
+		return FLASH_ERR_INVALID;
+
+	bool irq_disabled = _is_code_bank(flash, addr, size) ? cpu_enable_irq(false) : true;
+	uint32_t cache = _cache_disable();
+	int ret = _program(flash, addr, data, size);
+	_cache_restore(cache);
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+	return ret;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <pmb887x.h>
+
+/*
+ * CFI NOR flash on 16 bit bus: Intel/ST (command set 0x0001, 0x0003, 0x0200) and AMD/Spansion (0x0002).
+ *
+ * Everything that runs while the flash is not in read array mode is placed to .ramtext. While a block is busy,
+ * reads from its bank return status instead of data: IRQ handlers and the yield callback must not run from that
+ * bank (BOOT=flash), and program data must not be taken from it.
+ *
+ * BOOT=flash: IRQs are masked while programming or erasing a bank with .text, and flash_erase_async() erases such
+ * block synchronously. The default yield toggles the watchdog pin from .ramtext, a custom one must be in .ramtext too.
+ *
+ * With CACHE=1 the D-cache is off while the flash is in command mode: during flash_program() and flash_erase(),
+ * and from flash_erase_async() until the erase is done.
+ * */
+
+#define FLASH_MAX_ERASE_REGIONS		4
+#define FLASH_MAX_BANK_REGIONS		8
+
+enum {
+	FLASH_OK				= 0,
+	FLASH_ERR_NOT_FOUND		= -1,	// no "QRY"
+	FLASH_ERR_UNSUPPORTED	= -2,	// unknown command set
+	FLASH_ERR_INVALID		= -3,	// unaligned address/size, out of flash
+	FLASH_ERR_TIMEOUT		= -4,
+	FLASH_ERR_PROGRAM		= -5,
+	FLASH_ERR_ERASE			= -6,
+	FLASH_ERR_LOCKED		= -7,
+	FLASH_ERR_VPP			= -8,
+	FLASH_ERR_BUSY			= -9,	// erase is in progress
+};
+
+enum flash_type_t {
+	FLASH_TYPE_INTEL,
+	FLASH_TYPE_AMD,
+};
+
+// count of equal blocks (or banks) of size bytes
+struct flash_region_t {
+	uint32_t count;
+	uint32_t size;
+};
+
+typedef void (*flash_yield_t)(void *ctx);
+
+struct flash_t {
+	uint32_t base;
+	uint32_t size;
+	uint16_t vid;
+	uint16_t pid;
+	enum flash_type_t type;
+	uint16_t cmdset;				// CFI primary vendor command set
+	uint16_t pri_version;			// major << 8 | minor
+
+	uint32_t write_buffer_size;		// bytes, 0 = word programming only
+	bool erase_suspend;
+	bool program_suspend;
+
+	// Max times from CFI
+	uint32_t word_program_us;
+	uint32_t buffer_program_us;
+	uint32_t block_erase_ms;
+
+	uint32_t erase_regions_cnt;
+	struct flash_region_t erase_regions[FLASH_MAX_ERASE_REGIONS];
+
+	// Banks (Intel partitions) from PRI, one bank of the whole flash when PRI has no bank info
+	uint32_t bank_regions_cnt;
+	struct flash_region_t bank_regions[FLASH_MAX_BANK_REGIONS];
+
+	// Called from the status polling loops, wdt_serve() by default (watchdog pin toggle with BOOT=flash)
+	flash_yield_t yield;
+	void *yield_ctx;
+
+	// Private
+	uint32_t amd_unlock1;
+	uint32_t amd_unlock2;
+	uint32_t word_timeout;			// in STM ticks
+	uint32_t buffer_timeout;
+	uint32_t erase_timeout;
+	uint32_t erase_addr;			// block erased by flash_erase_async(), 0 = none
+	uint32_t erase_start;
+	uint32_t erase_cache;			// CP15 control before the erase
+	int erase_result;				// of the last finished erase
+	uint32_t wdt_last;				// BOOT=flash default yield
+	uint32_t wdt_interval;
+};
+
+// Reads CFI/PRI and caches geometry, flash must be mapped at base by EBU
+int flash_init(struct flash_t *flash, uint32_t base);
+
+void flash_set_yield(struct flash_t *flash, flash_yield_t yield, void *ctx);
+
+// Block (erase unit) or bank containing the absolute address
+bool flash_get_block(const struct flash_t *flash, uint32_t addr, uint32_t *start, uint32_t *size);
+bool flash_get_bank(const struct flash_t *flash, uint32_t addr, uint32_t *start, uint32_t *size);
+
+// Erase one block, addr must be the block start; blocks are unlocked first
+int flash_erase(struct flash_t *flash, uint32_t addr);
+
+/*
+ * Start erase and return, flash_erase_poll() returns FLASH_ERR_BUSY until it is done.
+ * Use flash_read() for reading the same bank in the meantime: erase is suspended for the copy.
+ * */
+int flash_erase_async(struct flash_t *flash, uint32_t addr);
+int flash_erase_poll(struct flash_t *flash);
+int flash_erase_wait(struct flash_t *flash);
+
+int flash_read(struct flash_t *flash, void *dst, uint32_t addr, uint32_t size);
+
+/*
+ * Program with write buffer (Intel/ST 0xE8, AMD 0x25) in chunks aligned to write_buffer_size, or word by word.
+ * addr, data and size must be 2 byte aligned, chunks of 0xFFFF are skipped. Written data is verified.
+ * */
+int flash_program(struct flash_t *flash, uint32_t addr, const void *data, uint32_t size);
@@ -0,0 +1,348 @@
+#pragma once
+
+#include <pmb887x.h>
+#include <numconv.h>
+#include <string.h>
+#include <type_traits>
+#include <utility>
+
+/*
+ * Compile-time printf for C++ code.
+ *
+ * The format is parsed by the compiler: a call is expanded into literal writes and typed conversions, there is no
+ * format parser at runtime. Conversions are the same as in lib/printf.c: %d %i %u %x %X %o %c %s %p, zero padding,
+ * width, "l" and "ll". Arg count and types are checked with static_assert, e.g. 64-bit arg needs "ll".
+ *
+ *   fmt::print(FMT("%08X: %08X\n"), addr, value);
+ *   fmt::format(buffer, sizeof(buffer), FMT("%s=%llu"), name, stopwatch_get());
+ */
+
+// Format string as a type, C++17 has no string literal template args
+#define FMT(str) ([] { \
+	struct fmt_string_t { \
+		static constexpr const char *value() { return str; } \
+	}; \
+	return fmt_string_t(); \
+}())
+
+namespace fmt {
+
+namespace detail {
+
+enum class conv_t : uint8_t {
+	LITERAL,
+	DEC_SIGNED,
+	DEC,
+	HEX,
+	HEX_UPPER,
+	OCT,
+	CHR,
+	STR,
+	PTR,
+	INVALID
+};
+
+struct segment_t {
+	conv_t conv = conv_t::LITERAL;
+	uint32_t begin = 0;		// literal: offset in the format string
+	uint32_t len = 0;		// literal: length
+	uint32_t width = 0;
+	bool zero = false;
+	uint32_t length = 0;	// number of 'l'
+	uint32_t arg = 0;
+};
+
+// Splits the format into segments, returns their count; out == nullptr only counts
+constexpr uint32_t parse(const char *fmt, segment_t *out) {
+	uint32_t count = 0;
+	uint32_t args = 0;
+	uint32_t i = 0;
+
+	while (fmt[i]) {
+		segment_t seg;
+		if (fmt[i] != '%' || fmt[i + 1] == '%') {
+			seg.begin = fmt[i] == '%' ? ++i : i;
+			i++;
+			while (fmt[i] && fmt[i] != '%')
+				i++;
+			seg.len = i - seg.begin;
+		} else {
+			i++;
+			if (fmt[i] == '0') {
+				seg.zero = true;
+				i++;
+			}
+			while (fmt[i] >= '0' && fmt[i] <= '9')
+				seg.width = seg.width * 10 + (fmt[i++] - '0');
+			while (fmt[i] == 'l') {
+				seg.length++;
+				i++;
+			}
+
+			switch (fmt[i]) {
+				case 'd':	seg.conv = conv_t::DEC_SIGNED;	break;
+				case 'i':	seg.conv = conv_t::DEC_SIGNED;	break;
+				case 'u':	seg.conv = conv_t::DEC;			break;
+				case 'x':	seg.conv = conv_t::HEX;			break;
+				case 'X':	seg.conv = conv_t::HEX_UPPER;	break;
+				case 'o':	seg.conv = conv_t::OCT;			break;
+				case 'c':	seg.conv = conv_t::CHR;			break;
+				case 's':	seg.conv = conv_t::STR;			break;
+				case 'p':	seg.conv = conv_t::PTR;			break;
+				default:	seg.conv = conv_t::INVALID;		break;
+			}
+
+			if (fmt[i])
+				i++;
+			seg.arg = args++;
+		}
+
+		if (out)
+			out[count] = seg;
+		count++;
+	}
+	return count;
+}
+
+template <typename S>
+struct format_t {
+	static constexpr uint32_t count = parse(S::value(), nullptr);
+
+	struct table_t {
+		segment_t items[count ? count : 1];
+	};
+
+	static constexpr table_t make_table() {
+		table_t table = {};
+		parse(S::value(), table.items);
+		return table;
+	}
+
+	static constexpr table_t table = make_table();
+
+	static constexpr uint32_t args() {
+		uint32_t n = 0;
+		for (uint32_t i = 0; i < count; i++)
+			n += table.items[i].conv != conv_t::LITERAL;
+		return n;
+	}
+
+	static constexpr bool valid() {
+		for (uint32_t i = 0; i < count; i++) {
+			if (table.items[i].conv == conv_t::INVALID)
+				return false;
+		}
+		return true;
+	}
+};
+
+// Same conversions as in lib/printf.c, from lib/numconv.h
+static constexpr uint32_t NUM_BUFFER_SIZE = NUMCONV_BUFFER_SIZE;
+
+template <conv_t Conv, typename T>
+inline char *to_str(T num, char *end) {
+	if constexpr (Conv == conv_t::HEX || Conv == conv_t::PTR) {
+		return numconv_u64_to_pow2(num, 4, false, end);
+	} else if constexpr (Conv == conv_t::HEX_UPPER) {
+		return numconv_u64_to_pow2(num, 4, true, end);
+	} else if constexpr (Conv == conv_t::OCT) {
+		return numconv_u64_to_pow2(num, 3, false, end);
+	} else if constexpr (sizeof(T) > 4) {
+		return (num >> 32) ? numconv_u64_to_dec(num, end) : numconv_u32_to_dec(num, end);
+	} else {
+		return numconv_u32_to_dec(num, end);
+	}
+}
+
+// Zero padding goes between prefix ("-", "0x") and digits
+template <uint32_t Width, bool Zero, typename Out>
+inline void put_num(Out &out, const char *prefix, uint32_t prefix_len, const char *digits, const char *end) {
+	if constexpr (Width > 0) {
+		int32_t pad = (int32_t) Width - (int32_t) (end - digits) - (int32_t) prefix_len;
+		if (!Zero)
+			out.fill(' ', pad);
+		out.write(prefix, prefix_len);
+		if (Zero)
+			out.fill('0', pad);
+	} else {
+		out.write(prefix, prefix_len);
+	}
+	out.write(digits, end - digits);
+}
+
+template <uint32_t Width, typename Out>
+inline void put_str(Out &out, const char *str) {
+	uint32_t len = strlen(str);
+	if constexpr (Width > 0)
+		out.fill(' ', (int32_t) Width - (int32_t) len);
+	out.write(str, len);
+}
+
+template <conv_t Conv, uint32_t Width, bool Zero, uint32_t Length, typename Out, typename T>
+inline void put_arg(Out &out, const T &arg) {
+	using V = std::decay_t<T>;
+	char buffer[NUM_BUFFER_SIZE];
+	char *end = buffer + sizeof(buffer);
+
+	if constexpr (Conv == conv_t::STR) {
+		static_assert(std::is_same_v<V, char *> || std::is_same_v<V, const char *>, "fmt: %s needs a string");
+		put_str<Width>(out, arg);
+	} else if constexpr (Conv == conv_t::PTR) {
+		static_assert(std::is_pointer_v<V>, "fmt: %p needs a pointer");
+		put_num<10, true>(out, "0x", 2, to_str<Conv>((uint32_t) (uintptr_t) arg, end), end);
+	} else {
+		static_assert(std::is_integral_v<V> || std::is_enum_v<V>, "fmt: integer conversion needs an integer arg");
+		static_assert(Length >= 2 || sizeof(V) <= 4, "fmt: 64-bit arg needs \"ll\"");
+		static_assert(Length < 2 || sizeof(V) == 8, "fmt: \"ll\" needs a 64-bit arg");
+
+		using U = std::conditional_t<(Length >= 2), uint64_t, uint32_t>;
+		using I = std::conditional_t<(Length >= 2), int64_t, int32_t>;
+
+		if constexpr (Conv == conv_t::CHR) {
+			out.put((char) arg);
+		} else if constexpr (Conv == conv_t::DEC_SIGNED) {
+			I num = (I) arg;
+			// Negation in unsigned: INT64_MIN has no positive counterpart
+			U abs = num < 0 ? -(U) num : (U) num;
+			put_num<Width, Zero>(out, "-", num < 0, to_str<Conv>(abs, end), end);
+		} else {
+			put_num<Width, Zero>(out, "", 0, to_str<Conv>((U) arg, end), end);
+		}
+	}
+}
+
+template <uint32_t N, typename T, typename... Rest>
+constexpr const auto &get_arg(const T &first, const Rest &... rest) {
+	if constexpr (N == 0) {
+		return first;
+	} else {
+		return get_arg<N - 1>(rest...);
+	}
+}
+
+template <typename S, size_t I, typename Out, typename... Args>
+inline void put_segment(Out &out, const Args &... args) {
+	constexpr segment_t seg = format_t<S>::table.items[I];
+	if constexpr (seg.conv == conv_t::LITERAL) {
+		out.write(S::value() + seg.begin, seg.len);
+	} else if constexpr (seg.conv != conv_t::INVALID && seg.arg < sizeof...(Args)) {
+		put_arg<seg.conv, seg.width, seg.zero, seg.length>(out, get_arg<seg.arg>(args...));
+	}
+}
+
+template <typename S, typename Out, size_t... I, typename... Args>
+inline void put_all(Out &out, std::index_sequence<I...>, const Args &... args) {
+	(put_segment<S, I>(out, args...), ...);
+}
+
+template <typename S, typename Out, typename... Args>
+inline void format_to(Out &out, const Args &... args) {
+	static_assert(format_t<S>::valid(), "fmt: unsupported conversion");
+	static_assert(format_t<S>::args() == sizeof...(Args), "fmt: number of args does not match the format");
+	put_all<S>(out, std::make_index_sequence<format_t<S>::count>(), args...);
+}
+
+// Same as stdout in lib/printf.c: output is collected in small chunks, one usart_write() per chunk
+class usart_out_t {
+	public:
+		explicit usart_out_t(uint32_t usart) : usart_(usart), size_(0), data_() { }
+
+		~usart_out_t() {
+			if (size_)
+				usart_write(usart_, data_, size_);
+		}
+
+		usart_out_t(const usart_out_t &) = delete;
+		usart_out_t &operator=(const usart_out_t &) = delete;
+
+		inline void put(char c) {
+			if (size_ == sizeof(data_))
+				flush();
+			data_[size_++] = c;
+		}
+
+		inline void write(const char *s, uint32_t len) {
+			if (size_ + len > sizeof(data_)) {
+				flush();
+				if (len > sizeof(data_)) {
+					usart_write(usart_, s, len);
+					return;
+				}
+			}
+			memcpy(data_ + size_, s, len);
+			size_ += len;
+		}
+
+		inline void fill(char c, int32_t n) {
+			while (n-- > 0)
+				put(c);
+		}
+
+	private:
+		void flush() {
+			usart_write(usart_, data_, size_);
+			size_ = 0;
+		}
+
+		uint32_t usart_;
+		uint32_t size_;
+		char data_[64];
+};
+
+// Same as tfp_snprintf(): truncated to size - 1 chars, counts the full length
+class buffer_out_t {
+	public:
+		buffer_out_t(char *data, size_t size) : data_(data), size_(size), len_(0) { }
+
+		inline void put(char c) {
+			if (len_ + 1 < size_)
+				data_[len_] = c;
+			len_++;
+		}
+
+		inline void write(const char *s, uint32_t len) {
+			if (len_ + 1 < size_)
+				memcpy(data_ + len_, s, MIN(len, size_ - 1 - len_));
+			len_ += len;
+		}
+
+		inline void fill(char c, int32_t n) {
+			while (n-- > 0)
+				put(c);
+		}
+
+		size_t finish() {
+			if (size_)
+				data_[MIN(len_, size_ - 1)] = 0;
+			return len_;
+		}
+
+	private:
+		char *data_;
+		size_t size_;
+		size_t len_;
+};
+
+} // namespace detail
+
+template <typename S, typename... Args>
+inline void print(S, const Args &... args) {
+	detail::usart_out_t out(USART0);
+	detail::format_to<S>(out, args...);
+}
+
+template <typename S, typename... Args>
+inline void print_to(uint32_t usart, S, const Args &... args) {
+	detail::usart_out_t out(usart);
+	detail::format_to<S>(out, args...);
+}
+
+// Returns length of the full output, like snprintf()
+template <typename S, typename... Args>
+inline int format(char *s, size_t size, S, const Args &... args) {
+	detail::buffer_out_t out(s, size);
+	detail::format_to<S>(out, args...);
+	return out.finish();
+}
+
+} // namespace fmt
@@ -2,12 +2,81 @@
 
 // from: https://github.com/todbot/SoftI2CMaster
 
+/*
+ * Open-drain emulation: "low" = output driving 0, "high" = input with pull-up.
+ * Pin config words are precomputed, so every edge is a single store.
+ * Edges are aligned to STM ticks: i2c_delay() waits until the next half-period deadline,
+ * so the time spent in our own code between edges does not change SCL frequency.
+ */
+struct i2c_bus_t {
+	volatile uint32_t *scl;
+	volatile uint32_t *sda;
+	uint32_t lo;
+	uint32_t hi;
+	uint32_t half_period;
+	uint32_t deadline;
+};
+
+static struct i2c_bus_t i2c_bus;
+
+static inline void i2c_delay_reset(void) {
+	i2c_bus.deadline = STM_TIM0 + i2c_bus.half_period;
+}
+
+static inline void i2c_delay(void) {
+	uint32_t now;
+	while ((int32_t) ((now = STM_TIM0) - i2c_bus.deadline) < 0);
+	
+	// We are late (IRQ?), start new period from now to keep minimal pulse width
+	if (now - i2c_bus.deadline > i2c_bus.half_period)
+		i2c_bus.deadline = now;
+	i2c_bus.deadline += i2c_bus.half_period;
+}
+
+static inline void i2c_scl_lo(void) {
+	*i2c_bus.scl = i2c_bus.lo;
+}
+
+static inline void i2c_scl_hi(void) {
+	*i2c_bus.scl = i2c_bus.hi;
+}
+
+static inline void i2c_sda_lo(void) {
+	*i2c_bus.sda = i2c_bus.lo;
+}
+
+static inline void i2c_sda_hi(void) {
+	*i2c_bus.sda = i2c_bus.hi;
+}
+
+static inline void i2c_sda_set(uint32_t bit) {
+	*i2c_bus.sda = bit ? i2c_bus.hi : i2c_bus.lo;
+}
+
+static inline uint32_t i2c_sda_get(void) {
+	return (*i2c_bus.sda & GPIO_DATA_HIGH) ? 1 : 0;
+}
+
 /* I2C */
 void i2c_init() {
+	i2c_init_custom(GPIO_I2C_SCL, GPIO_I2C_SDA, I2C_DEFAULT_FREQ);
+}
+
+void i2c_init_custom(uint32_t scl, uint32_t sda, uint32_t freq) {
+	if (!stopwatch_ticks_per_s())
+		stopwatch_init();
+	
+	i2c_bus.scl = &GPIO_PIN(scl);
+	i2c_bus.sda = &GPIO_PIN(sda);
+	i2c_bus.lo = GPIO_OS_NONE | GPIO_DATA_LOW | GPIO_PS_MANUAL | GPIO_DIR_OUT | GPIO_PPEN_OPENDRAIN | GPIO_PDPU_NONE;
+	i2c_bus.hi = GPIO_IS_NONE | GPIO_PS_MANUAL | GPIO_DIR_IN | GPIO_PDPU_PULLUP;
+	i2c_bus.half_period = MAX(1, stopwatch_ticks_per_s() / (freq * 2));
+	
 	i2c_sda_hi();
 	i2c_scl_hi();
-    
-    i2c_delay();
+	
+	i2c_delay_reset();
+	i2c_delay();
 }
 
 void i2c_start_read(uint8_t addr) {
@@ -24,16 +93,19 @@ void i2c_start() {
 	i2c_sda_hi();
 	i2c_scl_hi();
 	
+	i2c_delay_reset();
 	i2c_delay();
 	
 	i2c_sda_lo();
 	i2c_delay();
 	
 	i2c_scl_lo();
-	i2c_delay();
 }
 
 void i2c_stop() {
+	i2c_sda_lo();
+	i2c_delay();
+	
 	i2c_scl_hi();
 	i2c_delay();
 	
@@ -42,32 +114,26 @@ void i2c_stop() {
 }
 
 void i2c_writebit(uint32_t c) {
-	if (c > 0) {
-		i2c_sda_hi();
-	} else {
-		i2c_sda_lo();
-	}
+	// SCL is low here
+	i2c_sda_set(c);
+	i2c_delay();
 	
 	i2c_scl_hi();
 	i2c_delay();
 	
 	i2c_scl_lo();
-	i2c_delay();
-	
-	if (c > 0)
-		i2c_sda_lo();
-	
-	i2c_delay();
 }
 
 uint32_t i2c_readbit() {
+	// SCL is low here
 	i2c_sda_hi();
+	i2c_delay();
+	
 	i2c_scl_hi();
 	i2c_delay();
 	
-	uint32_t bit = gpio_get(GPIO_I2C_SDA);
+	uint32_t bit = i2c_sda_get();
 	i2c_scl_lo();
-	i2c_delay();
 	
 	return bit;
 }
@@ -81,17 +147,30 @@ uint8_t i2c_write(uint8_t c) {
 }
 
 uint8_t i2c_read(bool ack) {
-    uint8_t res = 0;
+	uint8_t res = 0;
 	
 	for (uint8_t i = 0; i < 8; ++i) {
 		res <<= 1;
 		res |= i2c_readbit();
 	}
 	
-	i2c_writebit(ack ? 1 : 0);
-	i2c_delay();
+	// ACK = SDA low
+	i2c_writebit(ack ? 0 : 1);
 	
-    return res;
+	return res;
+}
+
+bool i2c_write_burst(const uint8_t *data, uint32_t size) {
+	for (uint32_t i = 0; i < size; i++) {
+		if (i2c_write(data[i]))
+			return false;
+	}
+	return true;
+}
+
+void i2c_read_burst(uint8_t *data, uint32_t size, bool nack_last) {
+	for (uint32_t i = 0; i < size; i++)
+		data[i] = i2c_read(!nack_last || i != size - 1);
 }
 
 /* I2C SMBUS */
@@ -101,15 +180,14 @@ void i2c_smbus_write_byte(uint32_t addr, uint8_t reg, uint8_t value) {
 
 uint8_t i2c_smbus_read_byte(uint32_t addr, uint8_t reg) {
 	uint8_t value = 0;
-	i2c_smbus_read(addr, reg, 2, &value);
+	i2c_smbus_read(addr, reg, 1, &value);
 	return value;
 }
 
 void i2c_smbus_write(uint32_t addr, uint8_t reg, uint32_t size, uint8_t *value) {
 	i2c_start_write(addr);
 	i2c_write(reg);
-	for (uint32_t i = 0; i < size; i++)
-		i2c_write(value[i]);
+	i2c_write_burst(value, size);
 	i2c_stop();
 }
 
@@ -119,7 +197,6 @@ void i2c_smbus_read(uint32_t addr, uint8_t reg, uint32_t size, uint8_t *value) {
 	i2c_stop();
 	
 	i2c_start_read(addr);
-	for (uint32_t i = 0; i < size; i++)
-		value[i] = i2c_read(i != size - 1);
+	i2c_read_burst(value, size, true);
 	i2c_stop();
 }
@@ -2,8 +2,11 @@
 
 #include <pmb887x.h>
 
+#define I2C_DEFAULT_FREQ	400000
+
 /* I2C */
 void i2c_init(void);
+void i2c_init_custom(uint32_t scl, uint32_t sda, uint32_t freq);
 
 void i2c_start(void);
 void i2c_stop(void);
@@ -14,28 +17,15 @@ void i2c_start_write(uint8_t addr);
 uint32_t i2c_readbit(void);
 void i2c_writebit(uint32_t c);
 
+// ack=true - ACK (more bytes expected), ack=false - NACK (last byte)
 uint8_t i2c_read(bool ack);
-uint8_t i2c_write(uint8_t c);
-
-static inline void i2c_delay(void) {
-	__asm__ volatile("NOP");
-}
 
-static inline void i2c_scl_lo(void) {
-	gpio_init_output(GPIO_I2C_SCL, GPIO_OS_NONE, GPIO_PS_MANUAL, false, GPIO_PPEN_OPENDRAIN, GPIO_PDPU_NONE, false);
-}
-
-static inline void i2c_scl_hi(void) {
-	gpio_init_input(GPIO_I2C_SCL, GPIO_IS_NONE, GPIO_PS_MANUAL, GPIO_PDPU_PULLUP, false);
-}
-
-static inline void i2c_sda_lo(void) {
-	gpio_init_output(GPIO_I2C_SDA, GPIO_OS_NONE, GPIO_PS_MANUAL, false, GPIO_PPEN_OPENDRAIN, GPIO_PDPU_NONE, false);
-}
+// Returns 0 on ACK, 1 on NACK
+uint8_t i2c_write(uint8_t c);
 
-static inline void i2c_sda_hi(void) {
-	gpio_init_input(GPIO_I2C_SDA, GPIO_IS_NONE, GPIO_PS_MANUAL, GPIO_PDPU_PULLUP, false);
-}
+// Multi-byte transfers without gaps between bytes, write returns false on NACK
+bool i2c_write_burst(const uint8_t *data, uint32_t size);
+void i2c_read_burst(uint8_t *data, uint32_t size, bool nack_last);
 
 /* SMBUS */
 void i2c_smbus_write_byte(uint32_t addr, uint8_t reg, uint8_t value);
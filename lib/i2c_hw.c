@@ -0,0 +1,242 @@
+#include "i2c_hw.h"
+
+/*
+ * Stock firmware uses INC=4, DEC=0x3D for 400 kHz.
+ * Bus clock is proportional to INC/DEC, so DEC = I2C_HW_FDIV_BASE / speed with INC=4.
+ * */
+#define I2C_HW_FDIV_INC		4
+#define I2C_HW_FDIV_BASE	(0x3D * 400000)
+
+#define I2C_HW_FIFO_WORDS	4
+
+struct i2c_hw_state_t {
+	struct i2c_hw_xfer_t *head;
+	struct i2c_hw_xfer_t *tail;
+	bool read_phase;
+	bool addr_sent;
+	uint32_t tx_pos;
+	uint32_t rx_pos;
+};
+
+static struct i2c_hw_state_t i2c_hw;
+
+static void _start_phase(struct i2c_hw_xfer_t *xfer) {
+	I2C_ICR = I2C_ICR_LSREQ_INT | I2C_ICR_SREQ_INT | I2C_ICR_LBREQ_INT | I2C_ICR_BREQ_INT;
+	I2C_PIRQSC = I2C_PIRQSC_AM | I2C_PIRQSC_GC | I2C_PIRQSC_MC | I2C_PIRQSC_AL | I2C_PIRQSC_NACK | I2C_PIRQSC_TX_END | I2C_PIRQSC_RX;
+	I2C_ERRIRQSC = I2C_ERRIRQSC_RXF_UFL | I2C_ERRIRQSC_RXF_OFL | I2C_ERRIRQSC_TXF_UFL | I2C_ERRIRQSC_TXF_OFL;
+	
+	i2c_hw.tx_pos = 0;
+	i2c_hw.rx_pos = 0;
+	i2c_hw.addr_sent = false;
+	
+	if (i2c_hw.read_phase) {
+		I2C_MRPSCTRL = xfer->rx_len;
+		I2C_TPSCTRL = 1;
+	} else {
+		// addr + reg + data
+		I2C_TPSCTRL = 2 + xfer->tx_len;
+	}
+}
+
+static void _start_next(void) {
+	if (!i2c_hw.head)
+		return;
+	i2c_hw.read_phase = false;
+	_start_phase(i2c_hw.head);
+}
+
+static void _finish(int status) {
+	struct i2c_hw_xfer_t *xfer = i2c_hw.head;
+	
+	I2C_ENDDCTRL = I2C_ENDDCTRL_SETEND;
+	
+	i2c_hw.head = xfer->next;
+	if (!i2c_hw.head)
+		i2c_hw.tail = NULL;
+	
+	xfer->status = status;
+	if (xfer->callback)
+		xfer->callback(xfer, xfer->ctx);
+	
+	_start_next();
+}
+
+static uint8_t _get_tx_byte(struct i2c_hw_xfer_t *xfer, uint32_t pos) {
+	if (pos == 0)
+		return xfer->addr << 1;
+	if (pos == 1)
+		return xfer->reg;
+	return xfer->tx[pos - 2];
+}
+
+// Fill TX FIFO with up to "words" words, bytes are packed LSB first
+static void _write_fifo(struct i2c_hw_xfer_t *xfer, uint32_t words) {
+	uint32_t packet_size = 2 + xfer->tx_len;
+	
+	while (words-- && i2c_hw.tx_pos < packet_size) {
+		uint32_t value = 0;
+		for (uint32_t i = 0; i < 4 && i2c_hw.tx_pos < packet_size; i++)
+			value |= _get_tx_byte(xfer, i2c_hw.tx_pos++) << (8 * i);
+		I2C_TXD = value;
+	}
+}
+
+static void _read_fifo(struct i2c_hw_xfer_t *xfer) {
+	while ((I2C_FFSSTAT & I2C_FFSSTAT_FFS)) {
+		uint32_t value = I2C_RXD;
+		for (uint32_t i = 0; i < 4 && i2c_hw.rx_pos < xfer->rx_len; i++)
+			xfer->rx[i2c_hw.rx_pos++] = value >> (8 * i);
+	}
+}
+
+static void _handle_request(struct i2c_hw_xfer_t *xfer, uint32_t words) {
+	if (!i2c_hw.read_phase) {
+		_write_fifo(xfer, words);
+	} else if (!i2c_hw.addr_sent) {
+		I2C_TXD = (xfer->addr << 1) | 1;
+		i2c_hw.addr_sent = true;
+	} else {
+		_read_fifo(xfer);
+	}
+}
+
+void i2c_hw_init(uint32_t speed) {
+	speed = MAX(1, MIN(speed, 400000));
+	
+	GPIO_PIN(GPIO_I2C_SCL) = GPIO_IS_ALT0 | GPIO_OS_ALT0 | GPIO_PPEN_OPENDRAIN | GPIO_PS_ALT | GPIO_DIR_IN;
+	GPIO_PIN(GPIO_I2C_SDA) = GPIO_IS_ALT0 | GPIO_OS_ALT0 | GPIO_PPEN_OPENDRAIN | GPIO_PS_ALT | GPIO_DIR_IN;
+	
+	uint32_t dec = MIN(I2C_HW_FDIV_BASE / speed, I2C_FDIVCFG_DEC);
+	
+	I2C_CLC = 0xFF << MOD_CLC_RMC_SHIFT;
+	I2C_RUNCTRL = 0;
+	I2C_ADDRCFG = I2C_ADDRCFG_MnS;
+	I2C_FIFOCFG = I2C_FIFOCFG_RXBS_4_WORD | I2C_FIFOCFG_TXBS_4_WORD | I2C_FIFOCFG_RXFA_BYTE | I2C_FIFOCFG_TXFA_BYTE | I2C_FIFOCFG_RXFC | I2C_FIFOCFG_TXFC;
+	I2C_FDIVCFG = (dec << I2C_FDIVCFG_DEC_SHIFT) | (I2C_HW_FDIV_INC << I2C_FDIVCFG_INC_SHIFT);
+	I2C_RUNCTRL = I2C_RUNCTRL_RUN;
+	
+	i2c_hw.head = NULL;
+	i2c_hw.tail = NULL;
+	
+	I2C_ICR = I2C_ICR_LSREQ_INT | I2C_ICR_SREQ_INT | I2C_ICR_LBREQ_INT | I2C_ICR_BREQ_INT | I2C_ICR_I2C_ERR_INT | I2C_ICR_I2C_P_INT;
+	I2C_PIRQSM = I2C_PIRQSM_AL | I2C_PIRQSM_NACK | I2C_PIRQSM_TX_END | I2C_PIRQSM_RX;
+	I2C_ERRIRQSM = I2C_ERRIRQSM_RXF_UFL | I2C_ERRIRQSM_RXF_OFL | I2C_ERRIRQSM_TXF_UFL | I2C_ERRIRQSM_TXF_OFL;
+	I2C_IMSC = I2C_IMSC_LSREQ_INT | I2C_IMSC_SREQ_INT | I2C_IMSC_LBREQ_INT | I2C_IMSC_BREQ_INT | I2C_IMSC_I2C_ERR_INT | I2C_IMSC_I2C_P_INT;
+	
+	NVIC_CON(NVIC_I2C_SINGLE_REQ_IRQ) = 1;
+	NVIC_CON(NVIC_I2C_BURST_REQ_IRQ) = 1;
+	NVIC_CON(NVIC_I2C_ERROR_IRQ) = 1;
+	NVIC_CON(NVIC_I2C_PROTOCOL_IRQ) = 1;
+}
+
+void i2c_hw_submit(struct i2c_hw_xfer_t *xfer) {
+	xfer->status = I2C_HW_BUSY;
+	xfer->next = NULL;
+	
+	bool irq_disabled = cpu_enable_irq(false);
+	if (i2c_hw.tail) {
+		i2c_hw.tail->next = xfer;
+		i2c_hw.tail = xfer;
+	} else {
+		i2c_hw.head = xfer;
+		i2c_hw.tail = xfer;
+		_start_next();
+	}
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+int i2c_hw_wait(struct i2c_hw_xfer_t *xfer) {
+	while (xfer->status == I2C_HW_BUSY) {
+		// Allow synchronous usage with disabled IRQ
+		if (I2C_MIS)
+			i2c_hw_irq();
+		wdt_serve();
+	}
+	return xfer->status;
+}
+
+void i2c_hw_irq(void) {
+	bool irq_disabled = cpu_enable_irq(false);
+	struct i2c_hw_xfer_t *xfer = i2c_hw.head;
+	uint32_t status = I2C_MIS;
+	
+	if (!xfer) {
+		I2C_ICR = status;
+		if (!irq_disabled)
+			cpu_enable_irq(true);
+		return;
+	}
+	
+	if ((status & (I2C_MIS_LSREQ_INT | I2C_MIS_SREQ_INT))) {
+		_handle_request(xfer, 1);
+		I2C_ICR = status & (I2C_ICR_LSREQ_INT | I2C_ICR_SREQ_INT);
+	}
+	
+	if ((status & (I2C_MIS_LBREQ_INT | I2C_MIS_BREQ_INT))) {
+		_handle_request(xfer, I2C_HW_FIFO_WORDS);
+		I2C_ICR = status & (I2C_ICR_LBREQ_INT | I2C_ICR_BREQ_INT);
+	}
+	
+	if ((status & I2C_MIS_I2C_ERR_INT)) {
+		I2C_ERRIRQSC = I2C_ERRIRQSS;
+		I2C_ICR = I2C_ICR_I2C_ERR_INT;
+		_finish(I2C_HW_ERR_FIFO);
+	} else if ((status & I2C_MIS_I2C_P_INT)) {
+		uint32_t protocol = I2C_PIRQSS;
+		I2C_PIRQSC = protocol;
+		I2C_ICR = I2C_ICR_I2C_P_INT;
+		
+		if ((protocol & I2C_PIRQSS_NACK)) {
+			_finish(I2C_HW_ERR_NACK);
+		} else if ((protocol & I2C_PIRQSS_AL)) {
+			_finish(I2C_HW_ERR_ARB);
+		} else if ((protocol & I2C_PIRQSS_TX_END)) {
+			if (!i2c_hw.read_phase && xfer->rx_len > 0) {
+				// Repeated start for reading
+				i2c_hw.read_phase = true;
+				_start_phase(xfer);
+			} else {
+				if (i2c_hw.read_phase)
+					_read_fifo(xfer);
+				_finish(I2C_HW_OK);
+			}
+		}
+	}
+	
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+/* SMBUS */
+void i2c_smbus_write_byte(uint32_t addr, uint8_t reg, uint8_t value) {
+	i2c_smbus_write(addr, reg, 1, &value);
+}
+
+uint8_t i2c_smbus_read_byte(uint32_t addr, uint8_t reg) {
+	uint8_t value = 0;
+	i2c_smbus_read(addr, reg, 1, &value);
+	return value;
+}
+
+void i2c_smbus_write(uint32_t addr, uint8_t reg, uint32_t size, uint8_t *value) {
+	struct i2c_hw_xfer_t xfer = {
+		.addr = addr,
+		.reg = reg,
+		.tx = value,
+		.tx_len = size,
+	};
+	i2c_hw_submit(&xfer);
+	i2c_hw_wait(&xfer);
+}
+
+void i2c_smbus_read(uint32_t addr, uint8_t reg, uint32_t size, uint8_t *value) {
+	struct i2c_hw_xfer_t xfer = {
+		.addr = addr,
+		.reg = reg,
+		.rx = value,
+		.rx_len = size,
+	};
+	i2c_hw_submit(&xfer);
+	i2c_hw_wait(&xfer);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <pmb887x.h>
+
+enum {
+	I2C_HW_OK			= 0,
+	I2C_HW_BUSY			= -1,
+	I2C_HW_ERR_NACK		= -2,
+	I2C_HW_ERR_ARB		= -3,
+	I2C_HW_ERR_FIFO		= -4,
+};
+
+struct i2c_hw_xfer_t;
+
+typedef void (*i2c_hw_callback_t)(struct i2c_hw_xfer_t *xfer, void *ctx);
+
+/*
+ * One transaction: START, addr+W, reg, tx[], then (if rx_len > 0) RESTART, addr+R, rx[], STOP.
+ * Must stay valid until callback is called.
+ * */
+struct i2c_hw_xfer_t {
+	uint8_t addr;
+	uint8_t reg;
+	const uint8_t *tx;
+	uint32_t tx_len;
+	uint8_t *rx;
+	uint32_t rx_len;
+	
+	i2c_hw_callback_t callback;
+	void *ctx;
+	
+	volatile int status;
+	struct i2c_hw_xfer_t *next;
+};
+
+// speed - bus clock in Hz (up to 400000)
+void i2c_hw_init(uint32_t speed);
+
+// Queue transaction, callback is called from IRQ
+void i2c_hw_submit(struct i2c_hw_xfer_t *xfer);
+
+// Wait for transaction with watchdog serving, returns status
+int i2c_hw_wait(struct i2c_hw_xfer_t *xfer);
+
+// Must be called from NVIC_I2C_SINGLE_REQ_IRQ, NVIC_I2C_BURST_REQ_IRQ, NVIC_I2C_ERROR_IRQ, NVIC_I2C_PROTOCOL_IRQ
+void i2c_hw_irq(void);
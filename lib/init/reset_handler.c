@@ -9,35 +9,25 @@ extern funcp_t __init_array_start, __init_array_end;
 extern funcp_t __fini_array_start, __fini_array_end;
 
 void __attribute__ ((weak)) reset_handler(void) {
-	volatile uint32_t *src, *dest;
 	volatile funcp_t *fp;
 	
 	// Unmount BootROM from 0x00000000
 	REG(0xf440007C) &= ~1;
 	
-	for (src = &_data_loadaddr, dest = &_data; dest < &_edata; src++, dest++)
-		*dest = *src;
+	boot_copy_words(&_data, &_data_loadaddr, &_edata);
+	boot_zero_words(&_edata, &_ebss);
 	
-	while (dest < &_ebss)
-		*dest++ = 0;
+	// Copy vectors with handler addresses to 0x00000000
+	uint32_t *vectors = (uint32_t *) 0;
+	boot_copy_words(vectors, &_vectors_table_start, vectors + (&_vectors_table_end - &_vectors_table_start));
 	
-	// Copy vectors to 0x00000000
-	for (src = &_vectors_table_start, dest = 0; src < &_vectors_table_end; src++, dest++)
-		*dest = *src;
+	boot_timeline_mark(BOOT_PHASE_DATA_INIT);
 	
-	// Setup handlers
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Warray-bounds"
-	funcp_t *cpu_vector = (funcp_t *) 0x20;
-	*cpu_vector++ = reset_handler;
-	*cpu_vector++ = undef_handler;
-	*cpu_vector++ = swi_handler;
-	*cpu_vector++ = prefetch_abort_handler;
-	*cpu_vector++ = data_abort_handler;
-	*cpu_vector++ = reserved_handler;
-	*cpu_vector++ = irq_handler;
-	*cpu_vector++ = fiq_handler;
-#pragma GCC diagnostic pop 
+#ifdef ENABLE_CACHE
+	mmu_init();
+#endif
+	
+	boot_timeline_mark(BOOT_PHASE_MMU_INIT);
 	
 	// Constructors
 	for (fp = &__preinit_array_start; fp < &__preinit_array_end; fp++)
@@ -45,7 +35,10 @@ void __attribute__ ((weak)) reset_handler(void) {
 	for (fp = &__init_array_start; fp < &__init_array_end; fp++)
 		(*fp)();
 	
+	boot_timeline_mark(BOOT_PHASE_CONSTRUCTORS);
+	
 	// Call main
+	boot_timeline_mark(BOOT_PHASE_MAIN);
 	main();
 
 	// Destructors
@@ -5,4 +5,6 @@
 typedef void (*funcp_t) (void);
 
 void blocking_handler(void);
+void boot_copy_words(uint32_t *dst, const uint32_t *src, uint32_t *dst_end);
+void boot_zero_words(uint32_t *dst, uint32_t *dst_end);
 int main(void);
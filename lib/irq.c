@@ -0,0 +1,88 @@
+#include "irq.h"
+#include "printf.h"
+
+struct irq_entry_t {
+	irq_handler_t handler;
+	void *ctx;
+};
+
+// Used by irq_dispatcher (irq_dispatch.S), entry layout must match
+struct irq_entry_t irq_table[IRQ_COUNT];
+volatile uint32_t irq_counters[IRQ_COUNT];
+
+void irq_dispatcher(void);
+void irq_dispatcher_nested(void);
+
+static void _irq_unhandled(uint32_t irq, void *ctx) {
+	(void) ctx;
+	// Prevent IRQ storm
+	NVIC_CON(irq) = 0;
+}
+
+static void _set_vector(void (*handler)(void)) {
+	bool irq_disabled = cpu_enable_irq(false);
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Warray-bounds"
+	// IRQ entry of the vectors table copied by reset_handler()
+	void (**irq_vector)(void) = (void (**)(void)) 0x38;
+	*irq_vector = handler;
+#pragma GCC diagnostic pop
+
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+void irq_init(void) {
+	for (uint32_t i = 0; i < IRQ_COUNT; i++) {
+		irq_table[i].handler = _irq_unhandled;
+		irq_table[i].ctx = NULL;
+		irq_counters[i] = 0;
+	}
+
+	_set_vector(irq_dispatcher);
+}
+
+void irq_set_nesting(bool enable) {
+	_set_vector(enable ? irq_dispatcher_nested : irq_dispatcher);
+}
+
+void irq_register(uint32_t irq, irq_handler_t handler, void *ctx, uint32_t priority) {
+	bool irq_disabled = cpu_enable_irq(false);
+	irq_table[irq].handler = handler;
+	irq_table[irq].ctx = ctx;
+	irq_set_priority(irq, priority);
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+void irq_unregister(uint32_t irq) {
+	bool irq_disabled = cpu_enable_irq(false);
+	NVIC_CON(irq) = 0;
+	irq_table[irq].handler = _irq_unhandled;
+	irq_table[irq].ctx = NULL;
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+void irq_set_priority(uint32_t irq, uint32_t priority) {
+	NVIC_CON(irq) = (priority << NVIC_CON_PRIORITY_SHIFT) & NVIC_CON_PRIORITY;
+}
+
+uint32_t irq_get_count(uint32_t irq) {
+	return irq_counters[irq];
+}
+
+void irq_reset_counters(void) {
+	for (uint32_t i = 0; i < IRQ_COUNT; i++)
+		irq_counters[i] = 0;
+}
+
+void irq_print_stats(void) {
+	printf("IRQ stats:\n");
+	for (uint32_t i = 0; i < IRQ_COUNT; i++) {
+		if (!irq_counters[i])
+			continue;
+		printf("  %3d: %10d%s\n", i, irq_counters[i], irq_table[i].handler == _irq_unhandled ? " (unhandled)" : "");
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <pmb887x.h>
+
+#define IRQ_COUNT		160
+
+// Higher value preempts lower in nested mode, 0 disables IRQ line
+#define IRQ_PRIO_MIN	1
+#define IRQ_PRIO_MAX	255
+
+typedef void (*irq_handler_t)(uint32_t irq, void *ctx);
+
+// Installs table-based dispatcher instead of irq_handler(), NVIC lines are not touched
+void irq_init(void);
+
+/*
+ * Nested mode: handlers run in SYS mode (on the SYS stack) with IRQ enabled and can be preempted by IRQs with higher
+ * NVIC priority. Shared data must be protected with cpu_enable_irq(false) in handlers too.
+ */
+void irq_set_nesting(bool enable);
+
+// Sets handler and enables IRQ line with given priority
+void irq_register(uint32_t irq, irq_handler_t handler, void *ctx, uint32_t priority);
+void irq_unregister(uint32_t irq);
+void irq_set_priority(uint32_t irq, uint32_t priority);
+
+// Number of dispatches per NVIC line, unhandled IRQ is disabled after the first hit
+uint32_t irq_get_count(uint32_t irq);
+void irq_reset_counters(void);
+void irq_print_stats(void);
@@ -1,20 +1,249 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <string.h>
+
+/*
+ * ARM926EJ-S memory functions.
+ *
+ * Bulk of the data moved with LDM/STM bursts of 8 registers (32 bytes = one cache line),
+ * 8-byte tails with LDRD/STRD and misaligned heads/tails with byte access.
+ * GCC must not turn our own loops back into memcpy/memset calls.
+ */
+#pragma GCC optimize("no-tree-loop-distribute-patterns")
+
+typedef uint32_t __attribute__((may_alias)) u32_alias_t;
+typedef uint64_t __attribute__((may_alias, aligned(8))) u64_alias_t;
+
+#define IS_ALIGNED(x, n)	(((uint32_t) (x) & ((n) - 1)) == 0)
+
+// Copy 32-byte blocks, forward. Both pointers must be word-aligned.
+static inline void _copy_blocks_fwd(uint8_t **d, const uint8_t **s, size_t blocks) {
+	__asm__ volatile (
+		"1: \n"
+		"PLD [%1, #64] \n"
+		"LDMIA %1!, {r3-r10} \n"
+		"STMIA %0!, {r3-r10} \n"
+		"SUBS %2, %2, #1 \n"
+		"BNE 1b \n"
+		: "+r" (*d), "+r" (*s), "+r" (blocks)
+		:
+		: "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "cc", "memory"
+	);
+}
+
+// Copy 32-byte blocks, backward (pointers point to the end of buffers). Both pointers must be word-aligned.
+static inline void _copy_blocks_bwd(uint8_t **d, const uint8_t **s, size_t blocks) {
+	__asm__ volatile (
+		"1: \n"
+		"PLD [%1, #-64] \n"
+		"LDMDB %1!, {r3-r10} \n"
+		"STMDB %0!, {r3-r10} \n"
+		"SUBS %2, %2, #1 \n"
+		"BNE 1b \n"
+		: "+r" (*d), "+r" (*s), "+r" (blocks)
+		:
+		: "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "cc", "memory"
+	);
+}
+
+// Fill 32-byte blocks. Pointer must be word-aligned.
+static inline void _fill_blocks(uint8_t **d, uint32_t v, size_t blocks) {
+	__asm__ volatile (
+		"MOV r3, %1 \n"
+		"MOV r4, %1 \n"
+		"MOV r5, %1 \n"
+		"MOV r6, %1 \n"
+		"MOV r7, %1 \n"
+		"MOV r8, %1 \n"
+		"MOV r9, %1 \n"
+		"MOV r10, %1 \n"
+		"1: \n"
+		"STMIA %0!, {r3-r10} \n"
+		"SUBS %2, %2, #1 \n"
+		"BNE 1b \n"
+		: "+r" (*d), "+r" (v), "+r" (blocks)
+		:
+		: "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "cc", "memory"
+	);
+}
+
+// Copy when src and dst have the same alignment: bytes until aligned, bursts, LDRD/STRD, words, bytes.
+static void _memcpy_aligned(uint8_t *d, const uint8_t *s, size_t len) {
+	while (!IS_ALIGNED(d, 4) && len) {
+		*d++ = *s++;
+		len--;
+	}
+
+	if (len >= 32) {
+		_copy_blocks_fwd(&d, &s, len >> 5);
+		len &= 31;
+	}
+
+	if (IS_ALIGNED(d, 8) && IS_ALIGNED(s, 8)) {
+		while (len >= 8) {
+			*(u64_alias_t *) d = *(const u64_alias_t *) s;
+			d += 8;
+			s += 8;
+			len -= 8;
+		}
+	}
+
+	while (len >= 4) {
+		*(u32_alias_t *) d = *(const u32_alias_t *) s;
+		d += 4;
+		s += 4;
+		len -= 4;
+	}
 
-void *memcpy(void *dest, const void *src, size_t len) {
-	char *d = dest;
-	const char *s = src;
 	while (len--)
 		*d++ = *s++;
+}
+
+// Copy when src and dst have different alignment: aligned word reads from src, merged with shifts (little-endian).
+static void _memcpy_shifted(uint8_t *d, const uint8_t *s, size_t len) {
+	while (!IS_ALIGNED(d, 4) && len) {
+		*d++ = *s++;
+		len--;
+	}
+
+	if (len >= 4) {
+		uint32_t offset = (uint32_t) s & 3;
+		uint32_t rshift = offset * 8;
+		uint32_t lshift = 32 - rshift;
+		const u32_alias_t *ws = (const u32_alias_t *) (s - offset);
+		uint32_t cur = *ws++;
+
+		while (len >= 4) {
+			uint32_t next = *ws++;
+			*(u32_alias_t *) d = (cur >> rshift) | (next << lshift);
+			cur = next;
+			d += 4;
+			len -= 4;
+		}
+
+		s = (const uint8_t *) ws - 4 + offset;
+	}
+
+	while (len--)
+		*d++ = *s++;
+}
+
+void *memcpy(void *dest, const void *src, size_t len) {
+	uint8_t *d = dest;
+	const uint8_t *s = src;
+
+	if (len < 8) {
+		while (len--)
+			*d++ = *s++;
+	} else if ((((uint32_t) d ^ (uint32_t) s) & 3) == 0) {
+		_memcpy_aligned(d, s, len);
+	} else {
+		_memcpy_shifted(d, s, len);
+	}
+	return dest;
+}
+
+void *memmove(void *dest, const void *src, size_t len) {
+	uint8_t *d = dest;
+	const uint8_t *s = src;
+
+	// No overlap or dst is before src: forward copy is safe
+	if (d <= s || d >= s + len)
+		return memcpy(dest, src, len);
+
+	// Overlapping, copy backward
+	d += len;
+	s += len;
+
+	if ((((uint32_t) d ^ (uint32_t) s) & 3) == 0) {
+		while (!IS_ALIGNED(d, 4) && len) {
+			*--d = *--s;
+			len--;
+		}
+
+		if (len >= 32) {
+			_copy_blocks_bwd(&d, &s, len >> 5);
+			len &= 31;
+		}
+
+		while (len >= 4) {
+			d -= 4;
+			s -= 4;
+			*(u32_alias_t *) d = *(const u32_alias_t *) s;
+			len -= 4;
+		}
+	}
+
+	while (len--)
+		*--d = *--s;
+
 	return dest;
 }
 
 void *memset(void *dest, int val, size_t len) {
-	uint8_t *ptr = dest;
-	while (len > 0) {
-		*ptr++ = val;
+	uint8_t *d = dest;
+	uint32_t v = (uint8_t) val;
+
+	while (!IS_ALIGNED(d, 4) && len) {
+		*d++ = v;
 		len--;
 	}
+
+	v |= v << 8;
+	v |= v << 16;
+
+	if (len >= 32) {
+		_fill_blocks(&d, v, len >> 5);
+		len &= 31;
+	}
+
+	while (len >= 4) {
+		*(u32_alias_t *) d = v;
+		d += 4;
+		len -= 4;
+	}
+
+	while (len--)
+		*d++ = v;
+
 	return dest;
 }
+
+int memcmp(const void *a, const void *b, size_t len) {
+	const uint8_t *p1 = a;
+	const uint8_t *p2 = b;
+
+	if ((((uint32_t) p1 ^ (uint32_t) p2) & 3) == 0) {
+		while (!IS_ALIGNED(p1, 4) && len) {
+			if (*p1 != *p2)
+				return *p1 - *p2;
+			p1++;
+			p2++;
+			len--;
+		}
+
+		// Skip equal words, the first mismatch is resolved bytewise below
+		while (len >= 4 && *(const u32_alias_t *) p1 == *(const u32_alias_t *) p2) {
+			p1 += 4;
+			p2 += 4;
+			len -= 4;
+		}
+	}
+
+	while (len--) {
+		if (*p1 != *p2)
+			return *p1 - *p2;
+		p1++;
+		p2++;
+	}
+
+	return 0;
+}
+
+size_t strlen(const char *str) {
+	const char *p = str;
+	while (*p)
+		p++;
+	return p - str;
+}
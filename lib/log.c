@@ -0,0 +1,121 @@
+#include "log.h"
+
+#include <string.h>
+
+#define LOG_FORMAT_VERSION	1
+#define LOG_HEADER_FMT		"log: STM %u Hz, format v%u\n"
+#define LOG_HEADER_TYPES	(LOG_ARG_U32 | (LOG_ARG_U32 << LOG_ARG_BITS))
+
+// ID 0, always first in .log_fmt (see ld scripts), the decoder takes STM frequency from it
+// Not loaded: only the address can be used at runtime
+static const struct { uint32_t types; char fmt[sizeof(LOG_HEADER_FMT)]; } log_header
+	__attribute__((section(".log_fmt.header"), aligned(4), used)) = {
+	LOG_HEADER_TYPES, LOG_HEADER_FMT
+};
+
+static uint32_t log_usart = USART0;
+static uint32_t last_timestamp;
+static bool with_timestamps;
+
+static inline uint8_t *_put_varint(uint8_t *p, uint32_t value) {
+	while (value >= 0x80) {
+		*p++ = value | 0x80;
+		value >>= 7;
+	}
+	*p++ = value;
+	return p;
+}
+
+static inline uint8_t *_put_varint64(uint8_t *p, uint64_t value) {
+	while (value > 0xFFFFFFFF) {
+		*p++ = value | 0x80;
+		value >>= 7;
+	}
+	return _put_varint(p, value);
+}
+
+static uint8_t *_put_str(uint8_t *p, const uint8_t *end, const char *str) {
+	if (!str)
+		str = "(null)";
+
+	// Worst case of the remaining args is checked by the caller, strings use only what is left
+	uint32_t room = p + 1 < end ? end - p - 1 : 0;
+	uint32_t len = MIN(strlen(str), MIN(LOG_MAX_STR, room));
+	*p++ = len;
+	memcpy(p, str, len);
+	return p + len;
+}
+
+void log_init(uint32_t usart) {
+	log_usart = usart;
+	with_timestamps = true;
+
+	if (!stopwatch_ticks_per_s())
+		stopwatch_init();
+
+	log_write((uint32_t) &log_header, LOG_HEADER_TYPES, stopwatch_ticks_per_s(), LOG_FORMAT_VERSION);
+}
+
+void log_enable_timestamps(bool enable) {
+	with_timestamps = enable;
+}
+
+void log_write(uint32_t entry, uint32_t types, ...) {
+	uint8_t record[LOG_MAX_RECORD];
+	uint8_t *p = record;
+	// Room for the largest varint after each string
+	const uint8_t *end = record + sizeof(record) - LOG_MAX_ARGS * 10;
+
+	va_list va;
+	va_start(va, types);
+
+	// Whole record is sent with IRQ disabled: records from IRQ handlers must not split it or reorder timestamps
+	bool irq_disabled = cpu_enable_irq(false);
+
+	*p++ = LOG_RECORD_MARKER;
+	p = _put_varint(p, (entry >> 2) << 1 | (with_timestamps ? 1 : 0));
+
+	if (with_timestamps) {
+		uint32_t now = STM_TIM0;
+		// Header record has the absolute value, it is the base for the decoder
+		p = _put_varint(p, entry ? now - last_timestamp : now);
+		last_timestamp = now;
+	}
+
+	for (; types; types >>= LOG_ARG_BITS) {
+		switch (types & ((1 << LOG_ARG_BITS) - 1)) {
+			case LOG_ARG_U32:
+				p = _put_varint(p, va_arg(va, uint32_t));
+			break;
+
+			case LOG_ARG_I32:
+			{
+				int32_t value = va_arg(va, int32_t);
+				p = _put_varint(p, ((uint32_t) value << 1) ^ (uint32_t) (value >> 31));
+			}
+			break;
+
+			case LOG_ARG_U64:
+				p = _put_varint64(p, va_arg(va, uint64_t));
+			break;
+
+			case LOG_ARG_I64:
+			{
+				int64_t value = va_arg(va, int64_t);
+				p = _put_varint64(p, ((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+			}
+			break;
+
+			case LOG_ARG_STR:
+				p = _put_str(p, end, va_arg(va, const char *));
+			break;
+		}
+	}
+
+	usart_write(log_usart, record, p - record);
+
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+
+	va_end(va);
+}
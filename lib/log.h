@@ -0,0 +1,89 @@
+#pragma once
+
+#include <pmb887x.h>
+
+/*
+ * Tokenized logging: LOG(fmt, ...) sends a binary record instead of the text, tools/log_decode.pl renders it back.
+ *
+ * Format strings are placed in the .log_fmt section, which is linked at address 0 and is not loaded (INFO), so they
+ * stay only in the .elf. The string ID is its offset in the section / 4.
+ *
+ * Record: LOG_RECORD_MARKER, varint(id << 1 | has_timestamp), [varint(STM ticks since previous record)], args.
+ * Args: U32 - varint, I32/I64 - zigzag varint, U64 - varint, STR - varint(length) + bytes (up to LOG_MAX_STR).
+ * Varint is LEB128, 7 bits per byte, low bits first.
+ *
+ * Records can be mixed with printf() output on the same USART. 0xFE is never a part of ASCII or UTF-8 text.
+ * Up to LOG_MAX_ARGS integer, pointer or string args. No floating point, same as printf.
+ */
+
+#define LOG_RECORD_MARKER	0xFE
+#define LOG_MAX_ARGS		8
+#define LOG_MAX_STR			64
+#define LOG_MAX_RECORD		192
+
+enum log_arg_t {
+	LOG_ARG_END = 0,
+	LOG_ARG_U32,
+	LOG_ARG_I32,
+	LOG_ARG_U64,
+	LOG_ARG_I64,
+	LOG_ARG_STR,
+	LOG_ARG_INVALID = 7
+};
+
+// 3 bits per arg, first arg in the low bits
+#define LOG_ARG_BITS		3
+
+#define _LOG_ARG_TYPE(x) _Generic((x), \
+	char *: LOG_ARG_STR, \
+	const char *: LOG_ARG_STR, \
+	signed char: LOG_ARG_I32, \
+	short: LOG_ARG_I32, \
+	int: LOG_ARG_I32, \
+	long: LOG_ARG_I32, \
+	long long: LOG_ARG_I64, \
+	unsigned long long: LOG_ARG_U64, \
+	float: LOG_ARG_INVALID, \
+	double: LOG_ARG_INVALID, \
+	long double: LOG_ARG_INVALID, \
+	default: LOG_ARG_U32)
+
+// Args after the format; "##" drops the comma before empty args only after a named parameter in -std=c11
+#define _LOG_NARGS(format, ...)	_LOG_NARGS_N(format, ##__VA_ARGS__, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define _LOG_NARGS_N(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, n, ...)		n
+
+#define _LOG_CONCAT(a, b)		_LOG_CONCAT2(a, b)
+#define _LOG_CONCAT2(a, b)		a##b
+
+#define _LOG_T(x)				((uint32_t) _LOG_ARG_TYPE(x))
+
+#define _LOG_TYPES_0()			0
+#define _LOG_TYPES_1(a)			_LOG_T(a)
+#define _LOG_TYPES_2(a, ...)	(_LOG_T(a) | (_LOG_TYPES_1(__VA_ARGS__) << LOG_ARG_BITS))
+#define _LOG_TYPES_3(a, ...)	(_LOG_T(a) | (_LOG_TYPES_2(__VA_ARGS__) << LOG_ARG_BITS))
+#define _LOG_TYPES_4(a, ...)	(_LOG_T(a) | (_LOG_TYPES_3(__VA_ARGS__) << LOG_ARG_BITS))
+#define _LOG_TYPES_5(a, ...)	(_LOG_T(a) | (_LOG_TYPES_4(__VA_ARGS__) << LOG_ARG_BITS))
+#define _LOG_TYPES_6(a, ...)	(_LOG_T(a) | (_LOG_TYPES_5(__VA_ARGS__) << LOG_ARG_BITS))
+#define _LOG_TYPES_7(a, ...)	(_LOG_T(a) | (_LOG_TYPES_6(__VA_ARGS__) << LOG_ARG_BITS))
+#define _LOG_TYPES_8(a, ...)	(_LOG_T(a) | (_LOG_TYPES_7(__VA_ARGS__) << LOG_ARG_BITS))
+
+// Arg types of the call site, checked at compile time
+#define LOG_TYPES(format, ...)	(_LOG_CONCAT(_LOG_TYPES_, _LOG_NARGS(format, ##__VA_ARGS__))(__VA_ARGS__))
+
+#define _LOG_HAS_INVALID(t) \
+	((((t) >> 0) & 7) == 7 || (((t) >> 3) & 7) == 7 || (((t) >> 6) & 7) == 7 || (((t) >> 9) & 7) == 7 || \
+	(((t) >> 12) & 7) == 7 || (((t) >> 15) & 7) == 7 || (((t) >> 18) & 7) == 7 || (((t) >> 21) & 7) == 7)
+
+#define LOG(format, ...) do { \
+	_Static_assert(_LOG_NARGS(format, ##__VA_ARGS__) <= LOG_MAX_ARGS, "LOG: too many args"); \
+	_Static_assert(!_LOG_HAS_INVALID(LOG_TYPES(format, ##__VA_ARGS__)), "LOG: unsupported arg type"); \
+	static const struct { uint32_t types; char fmt[sizeof(format)]; } _log_fmt \
+		__attribute__((section(".log_fmt"), aligned(4), used)) = { LOG_TYPES(format, ##__VA_ARGS__), format }; \
+	log_write((uint32_t) &_log_fmt, LOG_TYPES(format, ##__VA_ARGS__), ##__VA_ARGS__); \
+} while (0)
+
+// Sends the header record (ID 0) with the STM frequency, the decoder needs it for timestamps
+void log_init(uint32_t usart);
+void log_enable_timestamps(bool enable);
+
+void log_write(uint32_t entry, uint32_t types, ...);
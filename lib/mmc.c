@@ -0,0 +1,725 @@
+#include "mmc.h"
+
+#include <string.h>
+
+// PMB8875 has no MCI
+#ifdef MCI_BASE
+
+#if MMC_BUS_WIDTH == 4 && !(defined(GPIO_MMCI_DAT2) && defined(GPIO_MMCI_DAT3))
+#error "MMC_BUS_WIDTH=4 needs GPIO_MMCI_DAT2 and GPIO_MMCI_DAT3 in the board header"
+#endif
+
+/*
+ * MCLK = fSYS / 4, measured with oscilloscope.
+ * MCICLK = MCLK / (2 * (CLKDIV + 1)) or MCLK with BYPASS.
+ * */
+#define MMC_MCLK_DIV			4
+#define MMC_BLOCK_SIZE_LOG2		9
+#define MMC_IDENT_CLOCK			400000
+
+#define MMC_POWER_OFF_MS		10
+#define MMC_POWER_UP_MS			2
+#define MMC_CMD_TIMEOUT_MS		10
+#define MMC_INIT_TIMEOUT_MS		1000
+// Max write busy time of SDHC, also used as read access timeout
+#define MMC_DATA_TIMEOUT_MS		250
+
+#define MMC_DMA_LLI_CNT			32
+#define MMC_DMA_IOV_CNT			8
+
+#define MMC_DMA_CONTROL ( \
+	DMAC_CH_CONTROL_SB_SIZE_SZ_8 | \
+	DMAC_CH_CONTROL_DB_SIZE_SZ_8 | \
+	DMAC_CH_CONTROL_S_WIDTH_WORD | \
+	DMAC_CH_CONTROL_D_WIDTH_WORD | \
+	DMAC_CH_CONTROL_S_AHB2 | \
+	DMAC_CH_CONTROL_D_AHB2 \
+)
+
+// Commands
+#define MMC_CMD_GO_IDLE_STATE		0
+#define MMC_CMD_SEND_OP_COND		1
+#define MMC_CMD_ALL_SEND_CID		2
+#define MMC_CMD_SET_RELATIVE_ADDR	3
+#define MMC_CMD_SWITCH				6
+#define MMC_CMD_SELECT_CARD			7
+#define MMC_CMD_SEND_EXT_CSD		8
+#define MMC_CMD_SEND_CSD			9
+#define MMC_CMD_STOP_TRANSMISSION	12
+#define MMC_CMD_SEND_STATUS			13
+#define MMC_CMD_SET_BLOCKLEN		16
+#define MMC_CMD_READ_SINGLE_BLOCK	17
+#define MMC_CMD_READ_MULTIPLE_BLOCK	18
+#define MMC_CMD_WRITE_BLOCK			24
+#define MMC_CMD_WRITE_MULTIPLE_BLOCK	25
+#define MMC_CMD_APP_CMD				55
+
+#define SD_CMD_SEND_IF_COND			8
+#define SD_ACMD_SET_BUS_WIDTH		6
+#define SD_ACMD_SD_SEND_OP_COND		41
+
+// CMD8: 2.7-3.6V + check pattern
+#define SD_IF_COND_CHECK			0x1AA
+#define SD_BUS_WIDTH_4				2
+
+// CMD6: write byte 183 (BUS_WIDTH) = 1 (4 bit)
+#define MMC_SWITCH_BUS_WIDTH_4		((3 << 24) | (183 << 16) | (1 << 8))
+#define MMC_EXT_CSD_SEC_COUNT		212
+
+#define MMC_OCR_VOLTAGE				0x00FF8000	// 2.7-3.6V
+#define MMC_OCR_CCS					BIT(30)		// block addressing
+#define MMC_OCR_READY				BIT(31)
+
+// R1 card status
+#define MMC_R1_ERRORS				0xFDF98008
+#define MMC_R1_READY_FOR_DATA		BIT(8)
+#define MMC_R1_STATE(status)		(((status) >> 9) & 0xF)
+#define MMC_R1_STATE_TRAN			4
+
+#define MCI_CLEAR_CMD ( \
+	MCI_CLEAR_CMDCRCFAILCLR | MCI_CLEAR_CMDTIMEOUTCLR | MCI_CLEAR_CMDRESPENDCLR | MCI_CLEAR_CMDSENTCLR \
+)
+
+#define MCI_CLEAR_DATA ( \
+	MCI_CLEAR_DATACRCFAILCLR | MCI_CLEAR_DATATIMEOUTCLR | MCI_CLEAR_TXUNDERRUNCLR | MCI_CLEAR_RXOVERRUNCLR | \
+	MCI_CLEAR_DATAENDCLR | MCI_CLEAR_STARTBITERRCLR | MCI_CLEAR_DATABLOCKENDCLR \
+)
+
+#define MCI_STATUS_DATA_ERRORS ( \
+	MCI_STATUS_DATACRCFAIL | MCI_STATUS_DATATIMEOUT | MCI_STATUS_TXUNDERRUN | MCI_STATUS_RXOVERRUN | \
+	MCI_STATUS_STARTBITERR \
+)
+
+// Half of the 16 words FIFO, same as DMA burst
+#define MCI_FIFO_BURST				8
+
+enum {
+	MMC_RSP_NONE,
+	MMC_RSP_SHORT,		// R6, R7 or R1 without card status check
+	MMC_RSP_R1,
+	MMC_RSP_R2,
+	MMC_RSP_R3,			// OCR, no CRC
+};
+
+struct mmc_state_t {
+	struct mmc_card_t card;
+	int dma_periph;
+	int dma_ch;
+	volatile bool dma_done;
+	volatile bool dma_error;
+
+	// Current position in bufs[]
+	const struct mmc_buf_t *buf;
+	uint32_t buf_offset;
+
+	struct dmac_iovec_t iov[MMC_DMA_IOV_CNT];
+	struct dmac_lli_t lli[MMC_DMA_LLI_CNT];
+};
+
+static struct mmc_state_t mmc = { .dma_periph = -1, .dma_ch = -1 };
+
+static int _cmd(uint32_t index, uint32_t arg, uint32_t rsp, uint32_t *resp) {
+	MCI_COMMAND = 0;
+	MCI_CLEAR = MCI_CLEAR_CMD;
+	MCI_ARGUMENT = arg;
+
+	uint32_t command = index | MCI_COMMAND_ENABLE;
+	if (rsp != MMC_RSP_NONE)
+		command |= MCI_COMMAND_RESPONSE;
+	if (rsp == MMC_RSP_R2)
+		command |= MCI_COMMAND_LONGRSP;
+	MCI_COMMAND = command;
+
+	// MCI has own 64 clocks response timeout, this one is only for the stuck controller
+	uint32_t done = rsp == MMC_RSP_NONE ? MCI_STATUS_CMDSENT : MCI_STATUS_CMDRESPEND | MCI_STATUS_CMDCRCFAIL | MCI_STATUS_CMDTIMEOUT;
+	stopwatch_t start = stopwatch_get();
+	uint32_t status;
+	while (!((status = MCI_STATUS) & done)) {
+		if (stopwatch_elapsed_ms(start) >= MMC_CMD_TIMEOUT_MS) {
+			status = MCI_STATUS_CMDTIMEOUT;
+			break;
+		}
+	}
+
+	MCI_COMMAND = 0;
+	MCI_CLEAR = MCI_CLEAR_CMD;
+
+	if ((status & MCI_STATUS_CMDTIMEOUT))
+		return MMC_ERR_TIMEOUT;
+	if ((status & MCI_STATUS_CMDCRCFAIL) && rsp != MMC_RSP_R3)
+		return MMC_ERR_CRC;
+
+	if (rsp == MMC_RSP_NONE)
+		return MMC_OK;
+
+	uint32_t r0 = MCI_RESPONSE0;
+	if (resp) {
+		resp[0] = r0;
+		if (rsp == MMC_RSP_R2) {
+			resp[1] = MCI_RESPONSE1;
+			resp[2] = MCI_RESPONSE2;
+			resp[3] = MCI_RESPONSE3;
+		}
+	}
+
+	if (rsp == MMC_RSP_R1 && (r0 & MMC_R1_ERRORS))
+		return MMC_ERR_CARD;
+
+	return MMC_OK;
+}
+
+static int _app_cmd(uint32_t index, uint32_t arg, uint32_t rsp, uint32_t *resp) {
+	// Card status may have ILLEGAL_COMMAND from CMD8 of SD v1 card, not checked
+	int ret = _cmd(MMC_CMD_APP_CMD, mmc.card.rca << 16, MMC_RSP_SHORT, NULL);
+	if (ret)
+		return ret;
+	return _cmd(index, arg, rsp, resp);
+}
+
+// Card is in "tran" state and can accept next data command (also covers R1b busy)
+static int _wait_ready(void) {
+	stopwatch_t start = stopwatch_get();
+	while (true) {
+		uint32_t status;
+		int ret = _cmd(MMC_CMD_SEND_STATUS, mmc.card.rca << 16, MMC_RSP_R1, &status);
+		if (ret)
+			return ret;
+
+		if ((status & MMC_R1_READY_FOR_DATA) && MMC_R1_STATE(status) == MMC_R1_STATE_TRAN)
+			return MMC_OK;
+
+		if (stopwatch_elapsed_ms(start) >= MMC_DATA_TIMEOUT_MS)
+			return MMC_ERR_TIMEOUT;
+
+		wdt_serve();
+	}
+}
+
+static uint32_t _set_clock(uint32_t freq) {
+	uint32_t mclk = cpu_get_sys_freq() / MMC_MCLK_DIV;
+	uint32_t wide = mmc.card.bus_width == 4 ? MCI_CLOCK_WIDEBUS : 0;
+
+	if (freq >= mclk) {
+		MCI_CLOCK = MCI_CLOCK_BYPASS | MCI_CLOCK_ENABLE | wide;
+		return mclk;
+	}
+
+	// Round up: card must not be clocked faster than allowed
+	uint32_t div = MIN((mclk + 2 * freq - 1) / (2 * freq) - 1, 0xFF);
+	MCI_CLOCK = (div << MCI_CLOCK_CLKDIV_SHIFT) | MCI_CLOCK_ENABLE | wide;
+	return mclk / (2 * (div + 1));
+}
+
+// Bits [start + size - 1:start] of CID/CSD, resp[0] has bits [127:96]
+static uint32_t _resp_bits(const uint32_t *resp, uint32_t start, uint32_t size) {
+	uint32_t word = 3 - start / 32;
+	uint32_t shift = start % 32;
+	uint32_t value = resp[word] >> shift;
+	if (shift + size > 32)
+		value |= resp[word - 1] << (32 - shift);
+	return size < 32 ? value & ((1 << size) - 1) : value;
+}
+
+// TRAN_SPEED from CSD
+static uint32_t _csd_max_clock(void) {
+	// 100 kbit/s ... 100 Mbit/s, divided by 10 for the multiplier
+	static const uint32_t units[] = { 10000, 100000, 1000000, 10000000 };
+	static const uint8_t mult_x10[] = { 0, 10, 12, 13, 15, 20, 25, 30, 35, 40, 45, 50, 55, 60, 70, 80 };
+
+	uint32_t tran_speed = _resp_bits(mmc.card.csd, 96, 8);
+	uint32_t freq = units[MIN(tran_speed & 7, 3)] * mult_x10[(tran_speed >> 3) & 0xF];
+	return freq ? freq : MMC_IDENT_CLOCK;
+}
+
+static uint32_t _csd_blocks(void) {
+	const uint32_t *csd = mmc.card.csd;
+
+	// CSD v2.0: SDHC/SDXC
+	if (mmc.card.type != MMC_CARD_MMC && _resp_bits(csd, 126, 2) == 1)
+		return (_resp_bits(csd, 48, 22) + 1) * 1024;
+
+	uint32_t c_size = _resp_bits(csd, 62, 12);
+	uint32_t c_size_mult = _resp_bits(csd, 47, 3);
+	uint32_t read_bl_len = MAX(_resp_bits(csd, 80, 4), 9);
+	return (c_size + 1) << (c_size_mult + 2 + read_bl_len - 9);
+}
+
+static void _power_up(void) {
+#ifdef GPIO_MMC_VCC_EN
+	// Power cycle: card can be left in any state by the previous firmware
+	GPIO_PIN(GPIO_MMC_VCC_EN) = GPIO_PS_MANUAL | GPIO_DIR_OUT | GPIO_DATA_LOW;
+	stopwatch_msleep_wd(MMC_POWER_OFF_MS);
+	GPIO_PIN(GPIO_MMC_VCC_EN) = GPIO_PS_MANUAL | GPIO_DIR_OUT | GPIO_DATA_HIGH;
+#endif
+
+	GPIO_PIN(GPIO_MMCI_CLK) = GPIO_PS_ALT | GPIO_IS_ALT0 | GPIO_OS_ALT0;
+	GPIO_PIN(GPIO_MMCI_CMD) = GPIO_PS_ALT | GPIO_IS_ALT0 | GPIO_OS_ALT0;
+	GPIO_PIN(GPIO_MMCI_DAT0) = GPIO_PS_ALT | GPIO_IS_ALT0 | GPIO_OS_ALT0;
+#if MMC_BUS_WIDTH == 4
+	GPIO_PIN(GPIO_MMCI_DAT1) = GPIO_PS_ALT | GPIO_IS_ALT0 | GPIO_OS_ALT0;
+	GPIO_PIN(GPIO_MMCI_DAT2) = GPIO_PS_ALT | GPIO_IS_ALT0 | GPIO_OS_ALT0;
+	GPIO_PIN(GPIO_MMCI_DAT3) = GPIO_PS_ALT | GPIO_IS_ALT0 | GPIO_OS_ALT0;
+#endif
+
+	MMCI_CLC = 7 << MOD_CLC_RMC_SHIFT;
+
+	// Polling only
+	MCI_MASK0 = 0;
+	MCI_MASK1 = 0;
+	MCI_COMMAND = 0;
+	MCI_DATACTRL = 0;
+	MCI_CLEAR = MCI_CLEAR_CMD | MCI_CLEAR_DATA;
+
+	MCI_POWER = MCI_POWER_CTRL_POWER_UP;
+	stopwatch_msleep_wd(MMC_POWER_UP_MS);
+	mmc.card.clock = _set_clock(MMC_IDENT_CLOCK);
+	MCI_POWER = MCI_POWER_CTRL_POWER_ON;
+
+	// At least 74 clocks before the first command
+	stopwatch_msleep_wd(MMC_POWER_UP_MS);
+}
+
+static int _op_cond(bool is_sd, uint32_t arg) {
+	stopwatch_t start = stopwatch_get();
+	while (true) {
+		int ret;
+		if (is_sd) {
+			ret = _app_cmd(SD_ACMD_SD_SEND_OP_COND, arg, MMC_RSP_R3, &mmc.card.ocr);
+		} else {
+			ret = _cmd(MMC_CMD_SEND_OP_COND, arg, MMC_RSP_R3, &mmc.card.ocr);
+		}
+
+		if (ret)
+			return ret;
+
+		if ((mmc.card.ocr & MMC_OCR_READY))
+			return MMC_OK;
+
+		if (stopwatch_elapsed_ms(start) >= MMC_INIT_TIMEOUT_MS)
+			return MMC_ERR_TIMEOUT;
+
+		stopwatch_msleep_wd(1);
+	}
+}
+
+static uint8_t *_buf_take(uint32_t *size) {
+	// Skip empty and finished buffers, total size is checked by caller
+	while (mmc.buf_offset >= mmc.buf->size) {
+		mmc.buf++;
+		mmc.buf_offset = 0;
+	}
+
+	uint8_t *p = (uint8_t *) mmc.buf->data + mmc.buf_offset;
+	*size = MIN(*size, mmc.buf->size - mmc.buf_offset);
+	mmc.buf_offset += *size;
+	return p;
+}
+
+static void _dma_callback(int ch, bool error, void *ctx) {
+	(void) ch;
+	(void) ctx;
+	mmc.dma_error = error;
+	mmc.dma_done = true;
+}
+
+static bool _dma_start(uint32_t size, bool is_write) {
+	const struct mmc_buf_t *saved_buf = mmc.buf;
+	uint32_t saved_offset = mmc.buf_offset;
+	uint32_t fifo = (uint32_t) &MCI_FIFO(0);
+	uint32_t iov_cnt = 0;
+
+	while (size > 0 && iov_cnt < MMC_DMA_IOV_CNT) {
+		uint32_t chunk = size;
+		uint32_t addr = (uint32_t) _buf_take(&chunk);
+		mmc.iov[iov_cnt].src = is_write ? addr : fifo;
+		mmc.iov[iov_cnt].dst = is_write ? fifo : addr;
+		mmc.iov[iov_cnt].size = chunk;
+		iov_cnt++;
+		size -= chunk;
+	}
+
+	uint32_t control = MMC_DMA_CONTROL | (is_write ? DMAC_CH_CONTROL_SI : DMAC_CH_CONTROL_DI);
+	int lli_cnt = size ? -1 : dmac_build_lli(mmc.lli, MMC_DMA_LLI_CNT, mmc.iov, iov_cnt, control);
+	if (lli_cnt < 0) {
+		// Too fragmented, this command is done by CPU
+		mmc.buf = saved_buf;
+		mmc.buf_offset = saved_offset;
+		return false;
+	}
+
+	uint32_t config;
+	if (is_write) {
+		config = DMAC_CH_CONFIG_FLOW_CTRL_MEM2PER | (mmc.dma_periph << DMAC_CH_CONFIG_DST_PERIPH_SHIFT);
+	} else {
+		config = DMAC_CH_CONFIG_FLOW_CTRL_PER2MEM | (mmc.dma_periph << DMAC_CH_CONFIG_SRC_PERIPH_SHIFT);
+	}
+
+	mmc.dma_done = false;
+	mmc.dma_error = false;
+	dmac_start(mmc.dma_ch, mmc.lli, lli_cnt, config);
+	return true;
+}
+
+static int _data_error(uint32_t status) {
+	if ((status & MCI_STATUS_DATATIMEOUT))
+		return MMC_ERR_TIMEOUT;
+	if ((status & (MCI_STATUS_TXUNDERRUN | MCI_STATUS_RXOVERRUN)))
+		return MMC_ERR_FIFO;
+	return MMC_ERR_CRC;
+}
+
+// Timeout restarts on every transferred word, MCI_DATATIMER only covers the wait for the first one
+static bool _data_stalled(stopwatch_t *start, uint32_t *last_count) {
+	uint32_t count = MCI_DATACNT;
+	if (count != *last_count) {
+		*last_count = count;
+		*start = stopwatch_get();
+		return false;
+	}
+	return stopwatch_elapsed_ms(*start) >= MMC_DATA_TIMEOUT_MS;
+}
+
+static int _wait_data_end(bool with_dma) {
+	stopwatch_t start = stopwatch_get();
+	uint32_t last_count = MCI_DATACNT;
+
+	while (true) {
+		uint32_t status = MCI_STATUS;
+		if ((status & MCI_STATUS_DATA_ERRORS))
+			return _data_error(status);
+
+		if (with_dma && mmc.dma_error)
+			return MMC_ERR_DMA;
+
+		// DMAC still drains FIFO after the last block was received
+		if ((status & MCI_STATUS_DATAEND) && (!with_dma || mmc.dma_done))
+			return MMC_OK;
+
+		if (_data_stalled(&start, &last_count))
+			return MMC_ERR_TIMEOUT;
+
+		wdt_serve();
+	}
+}
+
+static int _fifo_read(uint32_t size) {
+	stopwatch_t start = stopwatch_get();
+	uint32_t last_count = MCI_DATACNT;
+
+	while (size > 0) {
+		uint32_t chunk = size;
+		uint32_t *p = (uint32_t *) _buf_take(&chunk);
+		uint32_t words = chunk / 4;
+		size -= chunk;
+
+		while (words > 0) {
+			uint32_t status = MCI_STATUS;
+			if ((status & MCI_STATUS_DATA_ERRORS))
+				return _data_error(status);
+
+			if (words >= MCI_FIFO_BURST && (status & MCI_STATUS_RXFIFOHALFFULL)) {
+				for (uint32_t i = 0; i < MCI_FIFO_BURST; i++)
+					*p++ = MCI_FIFO(i);
+				words -= MCI_FIFO_BURST;
+			} else if ((status & MCI_STATUS_RXDATAAVLBL)) {
+				*p++ = MCI_FIFO(0);
+				words--;
+			} else if (_data_stalled(&start, &last_count)) {
+				return MMC_ERR_TIMEOUT;
+			}
+		}
+	}
+
+	return _wait_data_end(false);
+}
+
+static int _fifo_write(uint32_t size) {
+	stopwatch_t start = stopwatch_get();
+	uint32_t last_count = MCI_DATACNT;
+
+	while (size > 0) {
+		uint32_t chunk = size;
+		const uint32_t *p = (const uint32_t *) _buf_take(&chunk);
+		uint32_t words = chunk / 4;
+		size -= chunk;
+
+		while (words > 0) {
+			uint32_t status = MCI_STATUS;
+			if ((status & MCI_STATUS_DATA_ERRORS))
+				return _data_error(status);
+
+			if (words >= MCI_FIFO_BURST && (status & MCI_STATUS_TXFIFOHALFEMPTY)) {
+				for (uint32_t i = 0; i < MCI_FIFO_BURST; i++)
+					MCI_FIFO(i) = *p++;
+				words -= MCI_FIFO_BURST;
+			} else if (!(status & MCI_STATUS_TXFIFOFULL)) {
+				MCI_FIFO(0) = *p++;
+				words--;
+			} else if (_data_stalled(&start, &last_count)) {
+				return MMC_ERR_TIMEOUT;
+			}
+		}
+	}
+
+	return _wait_data_end(false);
+}
+
+// One data command: up to MMC_MAX_BLOCKS from the current position in bufs[]
+static int _data_cmd(uint32_t cmd, uint32_t arg, uint32_t blocks, bool is_write, bool is_multi) {
+	uint32_t size = blocks * MMC_BLOCK_SIZE;
+	bool with_dma = mmc.dma_ch >= 0 && _dma_start(size, is_write);
+
+	uint32_t datactrl = MCI_DATACTRL_EMABLE | MCI_DATACTRL_MODE_BLCOK | (MMC_BLOCK_SIZE_LOG2 << MCI_DATACTRL_BLOCKSIZE_SHIFT);
+	if (with_dma)
+		datactrl |= MCI_DATACTRL_DMAENABLE;
+
+	MCI_CLEAR = MCI_CLEAR_DATA;
+	MCI_DATATIMER = mmc.card.clock / 1000 * MMC_DATA_TIMEOUT_MS;
+	MCI_DATALENGTH = size;
+
+	// Data path must be ready before the card starts sending
+	if (!is_write)
+		MCI_DATACTRL = datactrl | MCI_DATACTRL_DIRECTION_READ;
+
+	int ret = _cmd(cmd, arg, MMC_RSP_R1, NULL);
+	if (!ret) {
+		if (is_write) {
+			MCI_DATACTRL = datactrl | MCI_DATACTRL_DIRECTION_WRITE;
+			ret = with_dma ? _wait_data_end(true) : _fifo_write(size);
+		} else {
+			ret = with_dma ? _wait_data_end(true) : _fifo_read(size);
+		}
+	}
+
+	if (with_dma)
+		dmac_stop(mmc.dma_ch);
+	MCI_DATACTRL = 0;
+	MCI_CLEAR = MCI_CLEAR_DATA;
+
+	// OUT_OF_RANGE after reading the last blocks is expected, errors are checked by _wait_ready()
+	if (is_multi) {
+		int stop_ret = _cmd(MMC_CMD_STOP_TRANSMISSION, 0, MMC_RSP_SHORT, NULL);
+		if (!ret)
+			ret = stop_ret;
+	}
+
+	// Write busy or error recovery
+	if (is_write || ret) {
+		int ready_ret = _wait_ready();
+		if (!ret)
+			ret = ready_ret;
+	}
+
+	return ret;
+}
+
+static int _transfer(uint32_t lba, const struct mmc_buf_t *bufs, uint32_t cnt, bool is_write) {
+	if (mmc.card.type == MMC_CARD_NONE)
+		return MMC_ERR_NO_CARD;
+
+	uint32_t total = 0;
+	for (uint32_t i = 0; i < cnt; i++) {
+		if ((((uint32_t) bufs[i].data | bufs[i].size) & 3))
+			return MMC_ERR_INVALID;
+		total += bufs[i].size;
+	}
+
+	uint32_t blocks = total / MMC_BLOCK_SIZE;
+	if (!blocks || (total % MMC_BLOCK_SIZE) || lba >= mmc.card.blocks || blocks > mmc.card.blocks - lba)
+		return MMC_ERR_INVALID;
+
+	mmc.buf = bufs;
+	mmc.buf_offset = 0;
+
+	if (mmc.dma_periph >= 0) {
+		mmc.dma_ch = dmac_alloc(true);
+		if (mmc.dma_ch >= 0) {
+			dmac_set_callback(mmc.dma_ch, _dma_callback, NULL);
+
+			// DMAC reads memory directly: write back data for writes, drop stale lines for reads
+			for (uint32_t i = 0; i < cnt; i++) {
+				if (is_write) {
+					mmu_dcache_clean_range(bufs[i].data, bufs[i].size);
+				} else {
+					mmu_dcache_flush_range(bufs[i].data, bufs[i].size);
+				}
+			}
+		}
+	}
+
+	int ret = MMC_OK;
+	while (blocks > 0 && !ret) {
+		uint32_t n = MIN(blocks, MMC_MAX_BLOCKS);
+		uint32_t arg = mmc.card.block_addressing ? lba : lba * MMC_BLOCK_SIZE;
+		uint32_t cmd;
+		if (is_write) {
+			cmd = n > 1 ? MMC_CMD_WRITE_MULTIPLE_BLOCK : MMC_CMD_WRITE_BLOCK;
+		} else {
+			cmd = n > 1 ? MMC_CMD_READ_MULTIPLE_BLOCK : MMC_CMD_READ_SINGLE_BLOCK;
+		}
+
+		ret = _data_cmd(cmd, arg, n, is_write, n > 1);
+		lba += n;
+		blocks -= n;
+	}
+
+	if (mmc.dma_ch >= 0) {
+		dmac_free(mmc.dma_ch);
+		mmc.dma_ch = -1;
+	}
+
+	return ret;
+}
+
+static int _mmc_read_ext_csd(uint8_t *ext_csd) {
+	struct mmc_buf_t buf = { ext_csd, MMC_BLOCK_SIZE };
+	mmc.buf = &buf;
+	mmc.buf_offset = 0;
+	return _data_cmd(MMC_CMD_SEND_EXT_CSD, 0, 1, false, false);
+}
+
+static int _identify(void) {
+	int ret;
+	uint32_t resp[4];
+
+	_cmd(MMC_CMD_GO_IDLE_STATE, 0, MMC_RSP_NONE, NULL);
+
+	// SD v2 echoes the check pattern, SD v1 and MMC don't answer
+	bool sd_v2 = false;
+	ret = _cmd(SD_CMD_SEND_IF_COND, SD_IF_COND_CHECK, MMC_RSP_SHORT, resp);
+	if (!ret) {
+		if ((resp[0] & 0xFFF) != SD_IF_COND_CHECK)
+			return MMC_ERR_UNSUPPORTED;
+		sd_v2 = true;
+	} else if (ret != MMC_ERR_TIMEOUT) {
+		return ret;
+	}
+
+	ret = _op_cond(true, MMC_OCR_VOLTAGE | (sd_v2 ? MMC_OCR_CCS : 0));
+	if (!ret) {
+		if (!sd_v2) {
+			mmc.card.type = MMC_CARD_SD_V1;
+		} else if ((mmc.card.ocr & MMC_OCR_CCS)) {
+			mmc.card.type = MMC_CARD_SDHC;
+		} else {
+			mmc.card.type = MMC_CARD_SD_V2;
+		}
+	} else if (ret == MMC_ERR_TIMEOUT && !sd_v2) {
+		// MMC has no CMD55
+		ret = _op_cond(false, MMC_OCR_VOLTAGE | MMC_OCR_CCS);
+		if (ret)
+			return ret == MMC_ERR_TIMEOUT ? MMC_ERR_NO_CARD : ret;
+		mmc.card.type = MMC_CARD_MMC;
+	} else {
+		return ret;
+	}
+
+	mmc.card.block_addressing = (mmc.card.ocr & MMC_OCR_CCS) != 0;
+
+	ret = _cmd(MMC_CMD_ALL_SEND_CID, 0, MMC_RSP_R2, mmc.card.cid);
+	if (ret)
+		return ret;
+
+	// SD card selects RCA itself, MMC gets it from host
+	if (mmc.card.type == MMC_CARD_MMC) {
+		mmc.card.rca = 1;
+		ret = _cmd(MMC_CMD_SET_RELATIVE_ADDR, mmc.card.rca << 16, MMC_RSP_R1, NULL);
+	} else {
+		ret = _cmd(MMC_CMD_SET_RELATIVE_ADDR, 0, MMC_RSP_SHORT, resp);
+		mmc.card.rca = resp[0] >> 16;
+	}
+	if (ret)
+		return ret;
+
+	ret = _cmd(MMC_CMD_SEND_CSD, mmc.card.rca << 16, MMC_RSP_R2, mmc.card.csd);
+	if (ret)
+		return ret;
+
+	mmc.card.blocks = _csd_blocks();
+
+	ret = _cmd(MMC_CMD_SELECT_CARD, mmc.card.rca << 16, MMC_RSP_R1, NULL);
+	if (!ret)
+		ret = _wait_ready();
+	if (ret)
+		return ret;
+
+	if (!mmc.card.block_addressing) {
+		ret = _cmd(MMC_CMD_SET_BLOCKLEN, MMC_BLOCK_SIZE, MMC_RSP_R1, NULL);
+		if (ret)
+			return ret;
+	}
+
+	mmc.card.clock = _set_clock(_csd_max_clock());
+
+	// MMC v4+: capacity > 2 GB is only in EXT_CSD
+	bool mmc_v4 = mmc.card.type == MMC_CARD_MMC && _resp_bits(mmc.card.csd, 122, 4) >= 4;
+	if (mmc_v4 && mmc.card.block_addressing) {
+		static uint32_t ext_csd[MMC_BLOCK_SIZE / 4];
+		ret = _mmc_read_ext_csd((uint8_t *) ext_csd);
+		if (ret)
+			return ret;
+		mmc.card.blocks = ext_csd[MMC_EXT_CSD_SEC_COUNT / 4];
+	}
+
+#if MMC_BUS_WIDTH == 4
+	if (mmc.card.type == MMC_CARD_MMC) {
+		if (mmc_v4) {
+			ret = _cmd(MMC_CMD_SWITCH, MMC_SWITCH_BUS_WIDTH_4, MMC_RSP_R1, NULL);
+			if (!ret)
+				ret = _wait_ready();
+		}
+	} else {
+		ret = _app_cmd(SD_ACMD_SET_BUS_WIDTH, SD_BUS_WIDTH_4, MMC_RSP_R1, NULL);
+	}
+	if (ret)
+		return ret;
+
+	if (mmc.card.type != MMC_CARD_MMC || mmc_v4) {
+		mmc.card.bus_width = 4;
+		MCI_CLOCK |= MCI_CLOCK_WIDEBUS;
+	}
+#endif
+
+	return MMC_OK;
+}
+
+int mmc_init(void) {
+	memset(&mmc.card, 0, sizeof(mmc.card));
+	mmc.card.bus_width = 1;
+
+	_power_up();
+
+	int ret = _identify();
+	if (ret)
+		mmc.card.type = MMC_CARD_NONE;
+
+	return ret;
+}
+
+const struct mmc_card_t *mmc_get_card(void) {
+	return &mmc.card;
+}
+
+void mmc_set_dma(int periph) {
+	mmc.dma_periph = periph;
+}
+
+int mmc_read(uint32_t lba, const struct mmc_buf_t *bufs, uint32_t cnt) {
+	return _transfer(lba, bufs, cnt, false);
+}
+
+int mmc_write(uint32_t lba, const struct mmc_buf_t *bufs, uint32_t cnt) {
+	return _transfer(lba, bufs, cnt, true);
+}
+
+int mmc_read_blocks(uint32_t lba, void *data, uint32_t blocks) {
+	struct mmc_buf_t buf = { data, blocks * MMC_BLOCK_SIZE };
+	return _transfer(lba, &buf, 1, false);
+}
+
+int mmc_write_blocks(uint32_t lba, const void *data, uint32_t blocks) {
+	struct mmc_buf_t buf = { (void *) data, blocks * MMC_BLOCK_SIZE };
+	return _transfer(lba, &buf, 1, true);
+}
+
+#endif
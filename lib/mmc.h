@@ -0,0 +1,74 @@
+#pragma once
+
+#include <pmb887x.h>
+
+#define MMC_BLOCK_SIZE		512
+
+// Blocks per CMD18/CMD25, MCI_DATALENGTH is only 16 bit
+#define MMC_MAX_BLOCKS		64
+
+// 4-bit bus needs DAT1..DAT3 routed to MCI, board must define GPIO_MMCI_DAT2 and GPIO_MMCI_DAT3 (make MMC_BUS_WIDTH=4)
+#ifndef MMC_BUS_WIDTH
+#define MMC_BUS_WIDTH		1
+#endif
+
+enum {
+	MMC_OK					= 0,
+	MMC_ERR_NO_CARD			= -1,
+	MMC_ERR_TIMEOUT			= -2,
+	MMC_ERR_CRC				= -3,
+	MMC_ERR_CARD			= -4,	// error bits in card status
+	MMC_ERR_UNSUPPORTED		= -5,
+	MMC_ERR_FIFO			= -6,	// MCI FIFO overrun/underrun
+	MMC_ERR_DMA				= -7,
+	MMC_ERR_INVALID			= -8,	// unaligned buffer, size is not multiple of MMC_BLOCK_SIZE, out of card
+};
+
+enum mmc_card_type_t {
+	MMC_CARD_NONE = 0,
+	MMC_CARD_MMC,
+	MMC_CARD_SD_V1,
+	MMC_CARD_SD_V2,
+	MMC_CARD_SDHC,				// SDHC/SDXC, block addressing
+};
+
+struct mmc_card_t {
+	enum mmc_card_type_t type;
+	bool block_addressing;		// SDHC or MMC > 2 GB
+	uint32_t rca;
+	uint32_t ocr;
+	uint32_t cid[4];			// cid[0] = bits [127:96]
+	uint32_t csd[4];
+	uint32_t blocks;			// capacity in MMC_BLOCK_SIZE
+	uint32_t bus_width;
+	uint32_t clock;				// MCICLK in Hz
+};
+
+// One chunk of scatter-gather transfer, data must be word aligned, size multiple of 4
+struct mmc_buf_t {
+	void *data;
+	uint32_t size;
+};
+
+/*
+ * Power up and identify card, then switch to MMC_BUS_WIDTH and the fastest MCICLK allowed by CSD.
+ * Transfers are done by CPU until mmc_set_dma() is called.
+ * */
+int mmc_init(void);
+const struct mmc_card_t *mmc_get_card(void);
+
+/*
+ * DMAC request line of MCI (0..15), -1 = CPU FIFO copy.
+ * Needs dmac_init() and dmac_irq() from the DMAC irq handlers. Falls back to CPU when no DMA channel is free.
+ * */
+void mmc_set_dma(int periph);
+
+/*
+ * Blocking transfers with watchdog serving, total size of bufs[] must be multiple of MMC_BLOCK_SIZE.
+ * More than one block is done with CMD18/CMD25, split into MMC_MAX_BLOCKS per command.
+ * */
+int mmc_read(uint32_t lba, const struct mmc_buf_t *bufs, uint32_t cnt);
+int mmc_write(uint32_t lba, const struct mmc_buf_t *bufs, uint32_t cnt);
+
+int mmc_read_blocks(uint32_t lba, void *data, uint32_t blocks);
+int mmc_write_blocks(uint32_t lba, const void *data, uint32_t blocks);
@@ -0,0 +1,161 @@
+#include "mmu.h"
+
+/*
+ * Flat (VA == PA) section mapping for ARM926EJ-S.
+ * Every 1M section is strongly-ordered by default, RAM and NOR flash are cacheable.
+ */
+
+#define SECTION_SIZE		0x100000
+#define SECTION_TYPE		0x12					// section descriptor + bit 4 (should be one on ARM926)
+#define SECTION_AP_RW		(3 << 10)				// read/write in all modes
+#define SECTION_DOMAIN(n)	((n) << 5)
+
+#define SECTION_ATTR_MASK	(BIT(3) | BIT(2))
+
+#define CP15_CTRL_M			BIT(0)					// MMU
+#define CP15_CTRL_A			BIT(1)					// Alignment fault checking
+#define CP15_CTRL_C			BIT(2)					// D-cache
+#define CP15_CTRL_W			BIT(3)					// Write buffer (should be one on ARM926)
+#define CP15_CTRL_I			BIT(12)					// I-cache
+#define CP15_CTRL_RR		BIT(14)					// Round-robin replacement
+
+#define SRAM_BASE			0x00000000
+#define SRAM_SIZE			SECTION_SIZE
+#define FLASH_BASE			0xA0000000
+#define FLASH_SIZE			0x08000000
+#define SDRAM_BASE			0xA8000000
+#define SDRAM_SIZE			0x01000000
+
+static uint32_t mmu_table[4096] __attribute__((section(".mmu_table"), aligned(16384)));
+
+static uint32_t _cp15_get_ctrl(void) {
+	uint32_t value;
+	__asm__ volatile("MRC p15, 0, %0, c1, c0, 0" : "=r" (value));
+	return value;
+}
+
+static void _cp15_set_ctrl(uint32_t value) {
+	__asm__ volatile("MCR p15, 0, %0, c1, c0, 0" : : "r" (value) : "memory");
+}
+
+static void _tlb_invalidate(void) {
+	__asm__ volatile("MCR p15, 0, %0, c8, c7, 0" : : "r" (0) : "memory");
+}
+
+void mmu_init(void) {
+	for (uint32_t i = 0; i < ARRAY_SIZE(mmu_table); i++)
+		mmu_table[i] = (i << 20) | SECTION_AP_RW | SECTION_DOMAIN(0) | SECTION_TYPE;
+
+	// Vectors + internal SRAM
+	mmu_set_region(SRAM_BASE, SRAM_SIZE, MMU_MEM_WRITE_BACK);
+
+	// NOR flash: write-through, so CFI command sequences are never stuck in the cache (see also lib/flash.c)
+	mmu_set_region(FLASH_BASE, FLASH_SIZE, MMU_MEM_WRITE_THROUGH);
+
+	// SDRAM
+	mmu_set_region(SDRAM_BASE, SDRAM_SIZE, MMU_MEM_WRITE_BACK);
+
+	// Caches may contain garbage after the bootloader
+	mmu_dcache_flush_all();
+	mmu_icache_invalidate();
+	mmu_drain_write_buffer();
+	_tlb_invalidate();
+
+	// Translation table base
+	__asm__ volatile("MCR p15, 0, %0, c2, c0, 0" : : "r" (mmu_table) : "memory");
+
+	// Domain 0 = client (permissions are checked), others = no access
+	__asm__ volatile("MCR p15, 0, %0, c3, c0, 0" : : "r" (1) : "memory");
+
+	uint32_t ctrl = _cp15_get_ctrl();
+	ctrl &= ~(CP15_CTRL_A | CP15_CTRL_RR);
+	ctrl |= CP15_CTRL_M | CP15_CTRL_C | CP15_CTRL_W | CP15_CTRL_I;
+	_cp15_set_ctrl(ctrl);
+}
+
+void mmu_set_region(uint32_t addr, uint32_t size, enum mmu_mem_type_t type) {
+	uint32_t first = addr >> 20;
+	uint32_t last = (addr + size - 1) >> 20;
+
+	for (uint32_t i = first; i <= last; i++)
+		mmu_table[i] = (mmu_table[i] & ~SECTION_ATTR_MASK) | type;
+
+	if (mmu_is_enabled()) {
+		mmu_dcache_flush_all();
+		mmu_drain_write_buffer();
+		_tlb_invalidate();
+	}
+}
+
+bool mmu_is_enabled(void) {
+	return (_cp15_get_ctrl() & CP15_CTRL_M) != 0;
+}
+
+void mmu_icache_invalidate(void) {
+	__asm__ volatile("MCR p15, 0, %0, c7, c5, 0" : : "r" (0) : "memory");
+}
+
+void mmu_dcache_clean_all(void) {
+	// Test and clean, loops until the whole D-cache is clean
+	__asm__ volatile(
+		"1: \n"
+		"MRC p15, 0, r15, c7, c10, 3 \n"
+		"BNE 1b \n"
+		: : : "cc", "memory"
+	);
+	mmu_drain_write_buffer();
+}
+
+void mmu_dcache_flush_all(void) {
+	// Test, clean and invalidate
+	__asm__ volatile(
+		"1: \n"
+		"MRC p15, 0, r15, c7, c14, 3 \n"
+		"BNE 1b \n"
+		: : : "cc", "memory"
+	);
+	mmu_drain_write_buffer();
+}
+
+void mmu_dcache_clean_range(const void *addr, size_t size) {
+	uint32_t start = (uint32_t) addr & ~(MMU_CACHE_LINE_SIZE - 1);
+	uint32_t end = (uint32_t) addr + size;
+
+	for (uint32_t mva = start; mva < end; mva += MMU_CACHE_LINE_SIZE)
+		__asm__ volatile("MCR p15, 0, %0, c7, c10, 1" : : "r" (mva) : "memory");
+	mmu_drain_write_buffer();
+}
+
+void mmu_dcache_invalidate_range(void *addr, size_t size) {
+	uint32_t start = (uint32_t) addr;
+	uint32_t end = start + size;
+
+	// Partial lines at the edges are shared with other data, write them back first
+	if ((start & (MMU_CACHE_LINE_SIZE - 1))) {
+		start &= ~(MMU_CACHE_LINE_SIZE - 1);
+		__asm__ volatile("MCR p15, 0, %0, c7, c14, 1" : : "r" (start) : "memory");
+		start += MMU_CACHE_LINE_SIZE;
+	}
+
+	if ((end & (MMU_CACHE_LINE_SIZE - 1)) && end > start) {
+		end &= ~(MMU_CACHE_LINE_SIZE - 1);
+		__asm__ volatile("MCR p15, 0, %0, c7, c14, 1" : : "r" (end) : "memory");
+	}
+
+	for (uint32_t mva = start; mva < end; mva += MMU_CACHE_LINE_SIZE)
+		__asm__ volatile("MCR p15, 0, %0, c7, c6, 1" : : "r" (mva) : "memory");
+	mmu_drain_write_buffer();
+}
+
+void mmu_dcache_flush_range(const void *addr, size_t size) {
+	uint32_t start = (uint32_t) addr & ~(MMU_CACHE_LINE_SIZE - 1);
+	uint32_t end = (uint32_t) addr + size;
+
+	for (uint32_t mva = start; mva < end; mva += MMU_CACHE_LINE_SIZE)
+		__asm__ volatile("MCR p15, 0, %0, c7, c14, 1" : : "r" (mva) : "memory");
+	mmu_drain_write_buffer();
+}
+
+void mmu_drain_write_buffer(void) {
+	__asm__ volatile("MCR p15, 0, %0, c7, c10, 4" : : "r" (0) : "memory");
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <pmb887x.h>
+
+#define MMU_CACHE_LINE_SIZE		32
+
+// Section attributes
+enum mmu_mem_type_t {
+	MMU_MEM_STRONGLY_ORDERED	= 0,						// C=0, B=0: MMIO
+	MMU_MEM_BUFFERED			= BIT(2),					// C=0, B=1: uncached, write buffer allowed
+	MMU_MEM_WRITE_THROUGH		= BIT(3),					// C=1, B=0
+	MMU_MEM_WRITE_BACK			= BIT(3) | BIT(2),			// C=1, B=1
+};
+
+void mmu_init(void);
+void mmu_set_region(uint32_t addr, uint32_t size, enum mmu_mem_type_t type);
+bool mmu_is_enabled(void);
+
+// Cache maintenance, safe to call when caches are disabled
+void mmu_icache_invalidate(void);
+void mmu_dcache_clean_all(void);
+void mmu_dcache_flush_all(void);
+void mmu_dcache_clean_range(const void *addr, size_t size);
+void mmu_dcache_invalidate_range(void *addr, size_t size);
+void mmu_dcache_flush_range(const void *addr, size_t size);
+void mmu_drain_write_buffer(void);
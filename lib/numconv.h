@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Number to string conversions without division, used by lib/printf.c and lib/format.hpp.
+ * ARM926 has no divider, every "/" or "%" is a libgcc call. Hex and octal use shifts, decimal uses reciprocal
+ * multiplication with two digits per step. Digits are written backwards from the end of the buffer, functions
+ * return pointer to the first one.
+ */
+
+// Enough for 64-bit octal (22 digits) + sign + NUL
+#define NUMCONV_BUFFER_SIZE		24
+
+static const char numconv_dec_pairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+// n / 100, exact for all 32-bit values
+static inline uint32_t numconv_div100(uint32_t n) {
+	return ((uint64_t) n * 0x51EB851F) >> 37;
+}
+
+static inline char *numconv_u32_to_dec(uint32_t num, char *end) {
+	char *p = end;
+	while (num >= 100) {
+		uint32_t q = numconv_div100(num);
+		uint32_t r = num - q * 100;
+		*--p = numconv_dec_pairs[r * 2 + 1];
+		*--p = numconv_dec_pairs[r * 2];
+		num = q;
+	}
+	if (num >= 10) {
+		*--p = numconv_dec_pairs[num * 2 + 1];
+		*--p = numconv_dec_pairs[num * 2];
+	} else {
+		*--p = '0' + num;
+	}
+	return p;
+}
+
+// High 64 bits of 64x64 product, four UMULLs
+static inline uint64_t numconv_mulhi64(uint64_t a, uint64_t b) {
+	uint64_t p00 = (uint64_t) (uint32_t) a * (uint32_t) b;
+	uint64_t p01 = (uint64_t) (uint32_t) a * (uint32_t) (b >> 32);
+	uint64_t p10 = (uint64_t) (uint32_t) (a >> 32) * (uint32_t) b;
+	uint64_t p11 = (uint64_t) (uint32_t) (a >> 32) * (uint32_t) (b >> 32);
+	uint64_t mid = (p00 >> 32) + (uint32_t) p01 + (uint32_t) p10;
+	return p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+}
+
+// n / 10^9: estimate with floor(2^64 / 10^9) is at most 2 less than exact quotient
+static inline uint64_t numconv_div1e9(uint64_t n, uint32_t *rem) {
+	uint64_t q = numconv_mulhi64(n, 18446744073ULL);
+	uint64_t r = n - q * 1000000000;
+	while (r >= 1000000000) {
+		r -= 1000000000;
+		q++;
+	}
+	*rem = r;
+	return q;
+}
+
+static inline char *numconv_u64_to_dec(uint64_t num, char *end) {
+	char *p = end;
+	while ((num >> 32)) {
+		uint32_t chunk;
+		num = numconv_div1e9(num, &chunk);
+		char *chunk_end = p;
+		p = numconv_u32_to_dec(chunk, p);
+		while (p > chunk_end - 9)
+			*--p = '0';
+	}
+	return numconv_u32_to_dec(num, p);
+}
+
+// shift: 4 - hex, 3 - octal
+static inline char *numconv_u64_to_pow2(uint64_t num, uint32_t shift, int uc, char *end) {
+	const char *digits = uc ? "0123456789ABCDEF" : "0123456789abcdef";
+	uint32_t mask = (1 << shift) - 1;
+	char *p = end;
+
+	// 32-bit loop for the low part is much cheaper than 64-bit shifts
+	while ((num >> 32)) {
+		*--p = digits[(uint32_t) num & mask];
+		num >>= shift;
+	}
+
+	uint32_t n = num;
+	do {
+		*--p = digits[n & mask];
+		n >>= shift;
+	} while (n);
+
+	return p;
+}
@@ -46,6 +46,10 @@
 
 #define __IRQ __attribute__((interrupt))
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #include "gen/board.h"
 #include "gen/cpu.h"
 
@@ -54,8 +58,23 @@
 #include "wdt.h"
 #include "gpio.h"
 #include "i2c.h"
+#include "i2c_hw.h"
 #include "cpu.h"
 #include "stopwatch.h"
+#include "mmu.h"
+#include "dmac.h"
+#include "dma_mem.h"
+#include "timer.h"
+#include "task.h"
+#include "irq.h"
+#include "fiq.h"
+#include "alloc.h"
+#include "boot.h"
+#include "profiler.h"
+#include "bench.h"
+#include "log.h"
+#include "mmc.h"
+#include "flash.h"
 
 // CPU Vectors
 __IRQ void reset_handler(void);
@@ -66,3 +85,7 @@ __IRQ void data_abort_handler(void);
 __IRQ void reserved_handler(void);
 __IRQ void irq_handler(void);
 __IRQ void fiq_handler(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -19,62 +19,21 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 */
 #include "printf.h"
+#include "numconv.h"
 
 #include <pmb887x.h>
+#include <string.h>
 
 typedef void(*putcf)(void *, char);
 
-#ifdef PRINTF_LONG_SUPPORT
-static void uli2a(unsigned long int num, unsigned int base, int uc, char *bf) {
-	int n = 0;
-	unsigned int d = 1;
-	while (num / d >= base)
-		d *= base;
-	while (d != 0) {
-		int dgt = num / d;
-		num %= d;
-		d /= base;
-		if (n || dgt > 0 || d == 0) {
-			*bf++ = dgt + (dgt < 10 ? '0' : (uc ? 'A' : 'a') - 10);
-			++n;
-		}
-	}
-	*bf = 0;
-}
-
-static void li2a(long num, char *bf) {
-	if (num < 0) {
-		num = -num;
-		*bf++ = '-';
-	}
-	uli2a(num, 10, 0, bf);
-}
-
-#endif
-
-static void ui2a(unsigned int num, unsigned int base, int uc, char *bf) {
-	int n = 0;
-	unsigned int d = 1;
-	while (num / d >= base)
-		d *= base;
-	while (d != 0) {
-		int dgt = num / d;
-		num %= d;
-		d /= base;
-		if (n || dgt > 0 || d == 0) {
-			*bf++ = dgt + (dgt < 10 ? '0' : (uc ? 'A' : 'a') - 10);
-			++n;
-		}
+static char *_num_to_str(uint64_t num, char base, int uc, char *end) {
+	switch (base) {
+		case 16:	return numconv_u64_to_pow2(num, 4, uc, end);
+		case 8:		return numconv_u64_to_pow2(num, 3, uc, end);
 	}
-	*bf = 0;
-}
-
-static void i2a(int num, char *bf) {
-	if (num < 0) {
-		num = -num;
-		*bf++ = '-';
-	}
-	ui2a(num, 10, 0, bf);
+	if ((num >> 32))
+		return numconv_u64_to_dec(num, end);
+	return numconv_u32_to_dec(num, end);
 }
 
 static int a2d(char ch) {
@@ -87,8 +46,8 @@ static int a2d(char ch) {
 	else return -1;
 }
 
-static char a2i(char ch, char **src, int base, int *nump) {
-	char *p = *src;
+static char a2i(char ch, const char **src, int base, int *nump) {
+	const char *p = *src;
 	int num = 0;
 	int digit;
 	while ((digit = a2d(ch)) >= 0) {
@@ -114,8 +73,26 @@ static void putchw(void *putp, putcf putf, int n, char z, char *bf) {
 		putf(putp, ch);
 }
 
-void tfp_format(void *putp, putcf putf, char *fmt, va_list va) {
-	char bf[12];
+// Zero padding goes between prefix ("-", "0x") and digits
+static void putnum(void *putp, putcf putf, int n, char z, const char *prefix, const char *bf, const char *end) {
+	n -= (end - bf) + strlen(prefix);
+	if (!z) {
+		while (n-- > 0)
+			putf(putp, ' ');
+	}
+	while (*prefix)
+		putf(putp, *prefix++);
+	if (z) {
+		while (n-- > 0)
+			putf(putp, '0');
+	}
+	while (bf < end)
+		putf(putp, *bf++);
+}
+
+void tfp_format(void *putp, putcf putf, const char *fmt, va_list va) {
+	char bf[NUMCONV_BUFFER_SIZE];
+	char *end = bf + sizeof(bf);
 
 	char ch;
 
@@ -124,9 +101,7 @@ void tfp_format(void *putp, putcf putf, char *fmt, va_list va) {
 			putf(putp, ch);
 		else {
 			char lz = 0;
-			#ifdef PRINTF_LONG_SUPPORT
 			char lng = 0;
-			#endif
 			
 			int w = 0;
 			ch = *(fmt++);
@@ -138,46 +113,39 @@ void tfp_format(void *putp, putcf putf, char *fmt, va_list va) {
 				ch = a2i(ch, &fmt, 10, &w);
 			}
 			
-			#ifdef PRINTF_LONG_SUPPORT
-			if (ch == 'l') {
+			// long is 32 bit on ARM, "ll" - 64 bit
+			while (ch == 'l') {
 				ch = *(fmt++);
-				lng = 1;
+				lng++;
 			}
-			#endif
 			
 			switch (ch) {
 				case 0:
 					return;
 				
 				case 'u':
-					#ifdef PRINTF_LONG_SUPPORT
-					if (lng)
-						uli2a(va_arg(va, unsigned long int), 10, 0, bf);
-					else
-					#endif
-						ui2a(va_arg(va, unsigned int), 10, 0, bf);
-						putchw(putp, putf, w, lz, bf);
+				case 'x':
+				case 'X':
+				case 'o':
+				{
+					uint64_t num = lng > 1 ? va_arg(va, unsigned long long) : (lng ? va_arg(va, unsigned long) : va_arg(va, unsigned int));
+					char base = ch == 'u' ? 10 : (ch == 'o' ? 8 : 16);
+					putnum(putp, putf, w, lz, "", _num_to_str(num, base, (ch == 'X'), end), end);
+				}
 				break;
 				
 				case 'd':
-					#ifdef PRINTF_LONG_SUPPORT
-						if (lng)
-							li2a(va_arg(va, unsigned long int), bf);
-						else
-					#endif
-						i2a(va_arg(va, int), bf);
-						putchw(putp, putf, w, lz, bf);
+				case 'i':
+				{
+					int64_t num = lng > 1 ? va_arg(va, long long) : (lng ? va_arg(va, long) : va_arg(va, int));
+					// Negation in unsigned: INT64_MIN has no positive counterpart
+					uint64_t abs = num < 0 ? -(uint64_t) num : (uint64_t) num;
+					putnum(putp, putf, w, lz, num < 0 ? "-" : "", _num_to_str(abs, 10, 0, end), end);
+				}
 				break;
 				
-				case 'x':
-				case 'X':
-					#ifdef PRINTF_LONG_SUPPORT
-						if (lng)
-							uli2a(va_arg(va, unsigned long int), 16, (ch == 'X'), bf);
-						else
-					#endif
-						ui2a(va_arg(va, unsigned int), 16, (ch == 'X'), bf);
-						putchw(putp, putf, w, lz, bf);
+				case 'p':
+					putnum(putp, putf, 10, 1, "0x", _num_to_str((uint32_t) va_arg(va, void *), 16, 0, end), end);
 				break;
 				
 				case 'c':
@@ -196,26 +164,71 @@ void tfp_format(void *putp, putcf putf, char *fmt, va_list va) {
 	}
 }
 
+struct stdout_buffer_t {
+	uint32_t size;
+	char data[64];
+};
+
+// Output is collected in small chunks, so buffered USART TX costs one memcpy per chunk
 static void stdout_putf(void *p, char c) {
-	(void) p;
-	usart_putc(USART0, c);
+	struct stdout_buffer_t *buffer = p;
+	buffer->data[buffer->size++] = c;
+	if (buffer->size == sizeof(buffer->data)) {
+		usart_write(USART0, buffer->data, buffer->size);
+		buffer->size = 0;
+	}
 }
 
-void tfp_printf(char *fmt, ...) {
+void tfp_printf(const char *fmt, ...) {
+	struct stdout_buffer_t buffer;
+	buffer.size = 0;
+	
 	va_list va;
 	va_start(va, fmt);
-	tfp_format(NULL, stdout_putf, fmt, va);
+	tfp_format(&buffer, stdout_putf, fmt, va);
 	va_end(va);
+	
+	if (buffer.size)
+		usart_write(USART0, buffer.data, buffer.size);
 }
 
 static void putcp(void *p, char c) {
 	*(*((char **) p))++ = c;
 }
 
-void tfp_sprintf(char *s, char *fmt, ...) {
+void tfp_sprintf(char *s, const char *fmt, ...) {
 	va_list va;
 	va_start(va, fmt);
 	tfp_format(&s, putcp, fmt, va);
 	putcp(&s, 0);
 	va_end(va);
 }
+
+struct snprintf_buffer_t {
+	char *data;
+	size_t size;
+	size_t len;
+};
+
+static void putcp_bounded(void *p, char c) {
+	struct snprintf_buffer_t *buffer = p;
+	if (buffer->len + 1 < buffer->size)
+		buffer->data[buffer->len] = c;
+	buffer->len++;
+}
+
+int tfp_vsnprintf(char *s, size_t size, const char *fmt, va_list va) {
+	struct snprintf_buffer_t buffer = { s, size, 0 };
+	tfp_format(&buffer, putcp_bounded, fmt, va);
+	if (size)
+		s[MIN(buffer.len, size - 1)] = 0;
+	return buffer.len;
+}
+
+int tfp_snprintf(char *s, size_t size, const char *fmt, ...) {
+	va_list va;
+	va_start(va, fmt);
+	int len = tfp_vsnprintf(s, size, fmt, va);
+	va_end(va);
+	return len;
+}
@@ -30,14 +30,13 @@ into your project.
 
 Two printf variants are provided: printf and sprintf. 
 
-The formats supported by this implementation are: 'd' 'u' 'c' 's' 'x' 'X'.
+The formats supported by this implementation are: 'd' 'i' 'u' 'c' 's' 'x' 'X' 'o' 'p'.
 
 Zero padding and field width are also supported.
 
-If the library is compiled with 'PRINTF_SUPPORT_LONG' defined then the 
-long specifier is also
-supported. Note that this will pull in some long math routines (pun intended!)
-and thus make your executable noticably longer.
+The 'l' and 'll' (64 bit, e.g. stopwatch_t) specifiers are supported. Number 
+conversions don't use division: shifts for hex/octal, reciprocal 
+multiplication for decimal.
 
 The memory foot print of course depends on the target cpu, compiler and 
 compiler options, but a rough guestimate (based on a H8S target) is about 
@@ -91,13 +90,20 @@ regs Kusti, 23.10.2004
 #define __TFP_PRINTF__
 
 #include <stdarg.h>
+#include <stddef.h>
 
-void tfp_printf(char *fmt, ...);
-void tfp_sprintf(char* s, char *fmt, ...);
+void tfp_printf(const char *fmt, ...);
+void tfp_sprintf(char* s, const char *fmt, ...);
 
-void tfp_format(void* putp, void (*putf) (void*, char), char *fmt, va_list va);
+// Output is truncated to size - 1 chars, returns length of the full output
+int tfp_snprintf(char *s, size_t size, const char *fmt, ...);
+int tfp_vsnprintf(char *s, size_t size, const char *fmt, va_list va);
+
+void tfp_format(void* putp, void (*putf) (void*, char), const char *fmt, va_list va);
 
 #define printf tfp_printf 
 #define sprintf tfp_sprintf 
+#define snprintf tfp_snprintf
+#define vsnprintf tfp_vsnprintf
 
 #endif
@@ -0,0 +1,162 @@
+#include "profiler.h"
+#include "printf.h"
+
+#define T1_RUN_ALL		(GPTU_T012RUN_T1ARUN | GPTU_T012RUN_T1BRUN | GPTU_T012RUN_T1CRUN | GPTU_T012RUN_T1DRUN)
+
+#define T1_IRS_MASK		(GPTU_T01IRS_T1AINS | GPTU_T01IRS_T1BINS | GPTU_T01IRS_T1CINS | GPTU_T01IRS_T1DINS | \
+	GPTU_T01IRS_T1AREL | GPTU_T01IRS_T1BREL | GPTU_T01IRS_T1CREL | GPTU_T01IRS_T1DREL | GPTU_T01IRS_T1INC)
+
+#define DUMP_CHUNK_SIZE	256
+
+// Used by profiler_irq_entry (profiler_entry.S), layout must match
+struct profiler_state_t {
+	uint32_t *ptr;
+	uint32_t *end;
+	uint32_t lost;
+	uint32_t with_lr;
+	uint32_t next_vector;
+};
+
+struct profiler_state_t profiler_state;
+
+void profiler_irq_entry(void);
+
+static uint32_t *buffer_start;
+static uint32_t sample_rate;
+static uint32_t duration_us;
+static stopwatch_t start_time;
+static bool running;
+
+void profiler_init(void *buffer, uint32_t buffer_size, uint32_t rate, bool with_lr) {
+	profiler_stop();
+
+	uint32_t sample_size = with_lr ? 8 : 4;
+	buffer_start = buffer;
+	profiler_state.with_lr = with_lr;
+	profiler_state.end = (uint32_t *) ((uint8_t *) buffer + buffer_size / sample_size * sample_size);
+	sample_rate = MAX(1, rate);
+	profiler_reset();
+
+	GPTU_CLC(GPTU0) = (1 << MOD_CLC_RMC_SHIFT);
+
+	// D -> C -> B -> A, all stages are reloaded on T1D overflow (same as T0 in timer.c)
+	GPTU_T01IRS(GPTU0) = (GPTU_T01IRS(GPTU0) & ~T1_IRS_MASK) |
+		GPTU_T01IRS_T1BINS_CONCAT |
+		GPTU_T01IRS_T1CINS_CONCAT |
+		GPTU_T01IRS_T1DINS_CONCAT |
+		GPTU_T01IRS_T1AREL |
+		GPTU_T01IRS_T1BREL |
+		GPTU_T01IRS_T1CREL;
+
+	// T1D overflow -> SR10 -> SRC1
+	GPTU_T01OTS(GPTU0) = (GPTU_T01OTS(GPTU0) & ~GPTU_T01OTS_SSR10) | GPTU_T01OTS_SSR10_D;
+	GPTU_SRSEL(GPTU0) = (GPTU_SRSEL(GPTU0) & ~GPTU_SRSEL_SSR1) | GPTU_SRSEL_SSR1_SR10;
+
+	// GPTU is clocked from fSYS / RMC
+	uint32_t value = -MAX(cpu_get_sys_freq() / sample_rate, 1);
+	GPTU_T012RUN(GPTU0) &= ~T1_RUN_ALL;
+	GPTU_T1DCBA(GPTU0) = value;
+	GPTU_T1RDCBA(GPTU0) = value;
+}
+
+void profiler_start(void) {
+	if (running)
+		return;
+
+	bool irq_disabled = cpu_enable_irq(false);
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Warray-bounds"
+	// IRQ entry of the vectors table copied by reset_handler()
+	void (**irq_vector)(void) = (void (**)(void)) 0x38;
+	profiler_state.next_vector = (uint32_t) *irq_vector;
+	*irq_vector = profiler_irq_entry;
+#pragma GCC diagnostic pop
+
+	// Highest priority: in nested mode samples are taken inside of other IRQ handlers too
+	GPTU_SRC(GPTU0, 1) = MOD_SRC_SRE | MOD_SRC_CLRR;
+	NVIC_CON(PROFILER_IRQ) = (IRQ_PRIO_MAX << NVIC_CON_PRIORITY_SHIFT) & NVIC_CON_PRIORITY;
+	GPTU_T012RUN(GPTU0) |= T1_RUN_ALL;
+
+	start_time = stopwatch_get();
+	running = true;
+
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+void profiler_stop(void) {
+	if (!running)
+		return;
+
+	bool irq_disabled = cpu_enable_irq(false);
+
+	GPTU_T012RUN(GPTU0) &= ~T1_RUN_ALL;
+	NVIC_CON(PROFILER_IRQ) = 0;
+	GPTU_SRC(GPTU0, 1) = MOD_SRC_CLRR;
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Warray-bounds"
+	// Vector could be replaced by irq_init() after profiler_start()
+	void (**irq_vector)(void) = (void (**)(void)) 0x38;
+	if (*irq_vector == profiler_irq_entry)
+		*irq_vector = (void (*)(void)) profiler_state.next_vector;
+#pragma GCC diagnostic pop
+
+	duration_us += stopwatch_elapsed_us(start_time);
+	running = false;
+
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+void profiler_reset(void) {
+	bool irq_disabled = cpu_enable_irq(false);
+	profiler_state.ptr = buffer_start;
+	profiler_state.lost = 0;
+	duration_us = 0;
+	start_time = stopwatch_get();
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+uint32_t profiler_get_count(void) {
+	uint32_t words = profiler_state.ptr - buffer_start;
+	return profiler_state.with_lr ? words / 2 : words;
+}
+
+uint32_t profiler_get_lost(void) {
+	return profiler_state.lost;
+}
+
+void profiler_dump(uint32_t usart) {
+	profiler_stop();
+
+	uint32_t words = profiler_state.ptr - buffer_start;
+
+	struct profiler_header_t header = {
+		.magic = PROFILER_MAGIC,
+		.version = PROFILER_VERSION,
+		.flags = profiler_state.with_lr ? PROFILER_FLAG_LR : 0,
+		.rate = sample_rate,
+		.duration_us = duration_us,
+		.count = profiler_get_count(),
+		.lost = profiler_state.lost,
+		.checksum = 0,
+	};
+
+	for (uint32_t i = 0; i < words; i++)
+		header.checksum += buffer_start[i];
+
+	char marker[32];
+	sprintf(marker, "\nPROFILE %d\n", sizeof(header) + words * 4);
+	usart_print(usart, marker);
+	usart_write(usart, &header, sizeof(header));
+
+	const uint8_t *data = (const uint8_t *) buffer_start;
+	for (uint32_t offset = 0; offset < words * 4; offset += DUMP_CHUNK_SIZE) {
+		usart_write(usart, data + offset, MIN(DUMP_CHUNK_SIZE, words * 4 - offset));
+		wdt_serve();
+	}
+	usart_flush(usart);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <pmb887x.h>
+
+/*
+ * Statistical PC-sampling profiler.
+ * GPTU0 T1 (A+B+C+D concatenated) raises PROFILER_IRQ at the sampling rate. profiler_irq_entry (profiler_entry.S)
+ * is installed in front of the current IRQ vector, records the interrupted PC (and LR of SYS/USR mode) and passes
+ * other IRQs to the previous vector.
+ *
+ * Code running with IRQ disabled, including handlers in non-nested mode, is accounted to the place where IRQ gets
+ * enabled again. Dumps are decoded with tools/profiler.pl.
+ */
+
+#define PROFILER_IRQ		NVIC_GPTU0_SRC1_IRQ
+
+#define PROFILER_MAGIC		0x464F5250	// "PROF"
+#define PROFILER_VERSION	1
+
+// Dump flags
+#define PROFILER_FLAG_LR	(1 << 0)
+
+// Dump: "\nPROFILE <size>\n" marker, header, count * (PC[, LR]) little-endian words
+struct profiler_header_t {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t flags;
+	uint32_t rate;				// Hz
+	uint32_t duration_us;		// total time between profiler_start() and profiler_stop()
+	uint32_t count;				// samples in the dump
+	uint32_t lost;				// samples dropped when buffer was full
+	uint32_t checksum;			// sum of all sample words
+};
+
+// buffer_size in bytes, one sample takes 4 bytes (PC) or 8 bytes (PC, LR)
+void profiler_init(void *buffer, uint32_t buffer_size, uint32_t rate, bool with_lr);
+
+// Must be called after irq_init()/irq_set_nesting(): they replace the IRQ vector
+void profiler_start(void);
+void profiler_stop(void);
+
+// Drops collected samples
+void profiler_reset(void);
+
+uint32_t profiler_get_count(void);
+uint32_t profiler_get_lost(void);
+
+// Stops profiler and writes the dump, watchdog is served while writing
+void profiler_dump(uint32_t usart);
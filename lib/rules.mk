@@ -4,20 +4,38 @@ CSTD ?= -std=c11
 CXXSTD ?= -std=c++17
 BOOT ?= intram
 BOARD ?= SIEMENS_EL71
+CACHE ?= 0
+I2C ?= soft
 
 ############################################################################
 
 INCLUDES += $(patsubst %,-I%, . $(LIB_DIR))
 
 LIB_AFILES += $(LIB_DIR)/init/start.S
+LIB_AFILES += $(LIB_DIR)/irq_dispatch.S
+LIB_AFILES += $(LIB_DIR)/fiq_entry.S
+LIB_AFILES += $(LIB_DIR)/profiler_entry.S
 LIB_CFILES += $(LIB_DIR)/libc.c
 LIB_CFILES += $(LIB_DIR)/init/reset_handler.c
 LIB_CFILES += $(LIB_DIR)/usart.c
-LIB_CFILES += $(LIB_DIR)/i2c.c
 LIB_CFILES += $(LIB_DIR)/printf.c
 LIB_CFILES += $(LIB_DIR)/wdt.c
 LIB_CFILES += $(LIB_DIR)/stopwatch.c
 LIB_CFILES += $(LIB_DIR)/cpu.c
+LIB_CFILES += $(LIB_DIR)/mmu.c
+LIB_CFILES += $(LIB_DIR)/dmac.c
+LIB_CFILES += $(LIB_DIR)/dma_mem.c
+LIB_CFILES += $(LIB_DIR)/timer.c
+LIB_CFILES += $(LIB_DIR)/task.c
+LIB_CFILES += $(LIB_DIR)/irq.c
+LIB_CFILES += $(LIB_DIR)/fiq.c
+LIB_CFILES += $(LIB_DIR)/alloc.c
+LIB_CFILES += $(LIB_DIR)/boot.c
+LIB_CFILES += $(LIB_DIR)/profiler.c
+LIB_CFILES += $(LIB_DIR)/bench.c
+LIB_CFILES += $(LIB_DIR)/log.c
+LIB_CFILES += $(LIB_DIR)/mmc.c
+LIB_CFILES += $(LIB_DIR)/flash.c
 
 ifeq ($(BOOT),intram)
 	ARCH_FLAGS += -DBOOT_INTRAM
@@ -34,6 +52,31 @@ ifeq ($(BOOT),flash)
 	LDSCRIPT = $(LIB_DIR)/ld/flash.ld
 endif
 
+# I2C smbus API: bit-bang (soft) or hardware I2C module (hw)
+ifeq ($(I2C),hw)
+	LIB_CFILES += $(LIB_DIR)/i2c_hw.c
+else
+	LIB_CFILES += $(LIB_DIR)/i2c.c
+endif
+
+# i2c_hw.c is written for the PMB8876 I2C module, PMB8875 has an older one without the same registers
+PMB8875_BOARDS = SIEMENS_CX75 SIEMENS_SL75
+ifeq ($(I2C),hw)
+ifneq ($(filter $(BOARD),$(PMB8875_BOARDS)),)
+$(error I2C=hw is not supported on $(BOARD) (PMB8875), use I2C=soft)
+endif
+endif
+
+# SD/MMC data bus width: 1 or 4 (board must have DAT1..DAT3 wired to MCI)
+ifeq ($(MMC_BUS_WIDTH),4)
+	ARCH_FLAGS += -DMMC_BUS_WIDTH=4
+endif
+
+# Enable MMU + I/D caches + write buffer at startup
+ifeq ($(CACHE),1)
+	ARCH_FLAGS += -DENABLE_CACHE
+endif
+
 ARCH_FLAGS += -march=armv5te -mtune=arm926ej-s -msoft-float -mfloat-abi=soft -ffreestanding -DBOARD_$(BOARD)
 
 ############################################################################
@@ -1,30 +1,80 @@
 #include <stopwatch.h>
 
+/*
+ * Conversions from ticks use precomputed fixed-point factors: value = (ticks * mul) >> shift.
+ * For elapsed time < 2^32 ticks this is one UMULL instead of __aeabi_uldivmod.
+ * Results can be one unit less than exact division.
+ */
+struct stopwatch_conv_t {
+	uint32_t mul;
+	uint32_t shift;
+};
+
 static uint32_t ticks_per_s;
 static uint32_t ticks_per_ms;
 static uint32_t ticks_per_us;
 
+static struct stopwatch_conv_t conv_s;
+static struct stopwatch_conv_t conv_ms;
+static struct stopwatch_conv_t conv_us;
+static uint32_t us_to_ticks_mul;		// ticks = (us * mul) >> 16
+
+// Find max shift where (units_per_s << shift) / ticks_per_s fits into 32 bit
+static void _conv_init(struct stopwatch_conv_t *conv, uint32_t units_per_s) {
+	uint32_t shift = 0;
+	while (shift < 63 && (((uint64_t) units_per_s << (shift + 1)) / ticks_per_s) <= 0xFFFFFFFF)
+		shift++;
+	conv->mul = ((uint64_t) units_per_s << shift) / ticks_per_s;
+	conv->shift = shift;
+}
+
+static inline uint32_t _conv(const struct stopwatch_conv_t *conv, uint32_t ticks_per_unit, stopwatch_t ticks) {
+	// Very long intervals: slow path
+	if ((ticks >> 32))
+		return ticks / ticks_per_unit;
+	return ((uint64_t) (uint32_t) ticks * conv->mul) >> conv->shift;
+}
+
 void stopwatch_init() {
 	uint32_t clock = (STM_CLC & MOD_CLC_RMC) >> MOD_CLC_RMC_SHIFT;
 	
-	ticks_per_s = PMB8876_SYSTEM_FREQ / clock;
+	ticks_per_s = cpu_get_stm_freq() / MAX(1, clock);
 	ticks_per_ms = ticks_per_s / 1000;
 	ticks_per_us = ticks_per_s / 1000000;
+	
+	_conv_init(&conv_s, 1);
+	_conv_init(&conv_ms, 1000);
+	_conv_init(&conv_us, 1000000);
+	us_to_ticks_mul = ((uint64_t) ticks_per_s << 16) / 1000000;
+}
+
+static inline stopwatch_t _us_to_ticks(uint32_t us) {
+	return ((uint64_t) us * us_to_ticks_mul) >> 16;
+}
+
+stopwatch_t stopwatch_us_to_ticks(uint32_t us) {
+	return _us_to_ticks(us);
 }
 
 void stopwatch_usleep(uint32_t us) {
-	stopwatch_t end = stopwatch_get() + us * ticks_per_us;
+	stopwatch_t end = stopwatch_get() + _us_to_ticks(us);
 	while (stopwatch_get() <= end);
 }
 
 void stopwatch_usleep_wd(uint32_t us) {
-	stopwatch_t end = stopwatch_get() + us * ticks_per_us;
+	stopwatch_t end = stopwatch_get() + _us_to_ticks(us);
 	while (stopwatch_get() <= end)
 		wdt_serve();
 }
 
+// TIM6 (bits 55:32) is re-read to detect carry from TIM0. STM_CAP is not used: IRQ handler can overwrite it between reads.
 stopwatch_t stopwatch_get() {
-	return ((stopwatch_t) STM_TIM6 << 32) | (stopwatch_t) STM_TIM0;
+	uint32_t hi, lo;
+	do {
+		hi = STM_TIM6;
+		lo = STM_TIM0;
+	} while (hi != STM_TIM6);
+	return ((stopwatch_t) hi << 32) | lo;
 }
 
 stopwatch_t stopwatch_elapsed(stopwatch_t start) {
@@ -32,15 +82,15 @@ stopwatch_t stopwatch_elapsed(stopwatch_t start) {
 }
 
 uint32_t stopwatch_elapsed_us(stopwatch_t start) {
-	return stopwatch_elapsed(start) / ticks_per_us;
+	return _conv(&conv_us, ticks_per_us, stopwatch_elapsed(start));
 }
 
 uint32_t stopwatch_elapsed_ms(stopwatch_t start) {
-	return stopwatch_elapsed(start) / ticks_per_ms;
+	return _conv(&conv_ms, ticks_per_ms, stopwatch_elapsed(start));
 }
 
 uint32_t stopwatch_elapsed_s(stopwatch_t start) {
-	return stopwatch_elapsed(start) / ticks_per_s;
+	return _conv(&conv_s, ticks_per_s, stopwatch_elapsed(start));
 }
 
 uint32_t stopwatch_ticks_per_us() {
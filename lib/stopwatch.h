@@ -20,6 +20,8 @@ uint32_t stopwatch_ticks_per_us(void);
 uint32_t stopwatch_ticks_per_ms(void);
 uint32_t stopwatch_ticks_per_s(void);
 
+stopwatch_t stopwatch_us_to_ticks(uint32_t us);
+
 inline void stopwatch_msleep(uint32_t ms) {
 	stopwatch_usleep(ms * 1000);
 }
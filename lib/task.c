@@ -0,0 +1,162 @@
+#include "task.h"
+
+/*
+ * Tasks are kept in two singly-linked lists: FIFO run queue and unsorted blocked list.
+ * Lists are touched only from thread context, IRQ handlers only increment event counters.
+ */
+
+struct task_list_t {
+	struct task_t *head;
+	struct task_t *tail;
+};
+
+static struct task_list_t ready;
+static struct task_list_t blocked;
+static task_idle_hook_t idle_hook;
+
+static void _list_push(struct task_list_t *list, struct task_t *task) {
+	task->next = NULL;
+	if (list->tail) {
+		list->tail->next = task;
+	} else {
+		list->head = task;
+	}
+	list->tail = task;
+}
+
+static struct task_t *_list_pop(struct task_list_t *list) {
+	struct task_t *task = list->head;
+	if (task) {
+		list->head = task->next;
+		if (!list->head)
+			list->tail = NULL;
+	}
+	return task;
+}
+
+static bool _event_try_consume(struct task_event_t *event) {
+	bool irq_disabled = cpu_enable_irq(false);
+	bool success = event->count > 0;
+	if (success)
+		event->count--;
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+	return success;
+}
+
+// Move tasks with signaled events or expired deadlines to the run queue, returns nearest deadline
+static uint64_t _wake_blocked(void) {
+	uint64_t now = stopwatch_get();
+	uint64_t next_wakeup = 0;
+	struct task_t *prev = NULL;
+	struct task_t *task = blocked.head;
+
+	while (task) {
+		struct task_t *next = task->next;
+		bool wake = false;
+
+		if (task->event && _event_try_consume(task->event)) {
+			wake = true;
+		} else if (task->wake_at && task->wake_at <= now) {
+			task->timed_out = task->event != NULL;
+			wake = true;
+		}
+
+		if (wake) {
+			if (prev) {
+				prev->next = next;
+			} else {
+				blocked.head = next;
+			}
+			if (blocked.tail == task)
+				blocked.tail = prev;
+
+			task->state = TASK_STATE_READY;
+			_list_push(&ready, task);
+		} else {
+			if (task->wake_at && (!next_wakeup || task->wake_at < next_wakeup))
+				next_wakeup = task->wake_at;
+			prev = task;
+		}
+
+		task = next;
+	}
+
+	return next_wakeup;
+}
+
+void task_init(void) {
+	ready.head = ready.tail = NULL;
+	blocked.head = blocked.tail = NULL;
+	idle_hook = NULL;
+}
+
+void task_set_idle_hook(task_idle_hook_t hook) {
+	idle_hook = hook;
+}
+
+void task_create(struct task_t *task, task_func_t func, void *ctx) {
+	task->func = func;
+	task->ctx = ctx;
+	task->lc = 0;
+	task->event = NULL;
+	task->wake_at = 0;
+	task->timed_out = false;
+	task->state = TASK_STATE_READY;
+	_list_push(&ready, task);
+}
+
+void task_block(struct task_t *task, struct task_event_t *event, uint64_t wake_at) {
+	task->event = event;
+	task->wake_at = wake_at;
+	task->timed_out = false;
+}
+
+void task_event_signal(struct task_event_t *event) {
+	bool irq_disabled = cpu_enable_irq(false);
+	event->count++;
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+bool task_run_once(void) {
+	uint64_t next_wakeup = _wake_blocked();
+
+	if (!ready.head) {
+		if (!blocked.head)
+			return false;
+		if (idle_hook)
+			idle_hook(next_wakeup);
+		return true;
+	}
+
+	// Tasks which yield in this round run again only in the next one
+	struct task_t *last = ready.tail;
+	while (true) {
+		struct task_t *task = _list_pop(&ready);
+
+		switch (task->func(task)) {
+			case TASK_YIELDED:
+				_list_push(&ready, task);
+			break;
+
+			case TASK_BLOCKED:
+				task->state = TASK_STATE_BLOCKED;
+				_list_push(&blocked, task);
+			break;
+
+			case TASK_EXITED:
+				task->state = TASK_STATE_DONE;
+			break;
+		}
+
+		if (task == last)
+			break;
+	}
+
+	return true;
+}
+
+void task_run(void) {
+	while (task_run_once());
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <pmb887x.h>
+
+/*
+ * Cooperative scheduler with stackless (protothread-style) tasks.
+ *
+ * Task function is re-entered from the beginning every time it is scheduled, TASK_BEGIN() jumps to the last
+ * blocking point. Local variables are not preserved across TASK_YIELD/TASK_SLEEP/TASK_WAIT, keep state in ctx
+ * or in static variables. switch() statements can't be used around blocking macros.
+ *
+ * static int blink_task(struct task_t *task) {
+ *     TASK_BEGIN(task);
+ *     while (true) {
+ *         led_toggle();
+ *         TASK_SLEEP_US(task, 500 * 1000);
+ *     }
+ *     TASK_END(task);
+ * }
+ */
+
+enum {
+	TASK_YIELDED = 0,		// still ready, run again in the next round
+	TASK_BLOCKED,			// waiting for event and/or deadline
+	TASK_EXITED,
+};
+
+enum task_state_t {
+	TASK_STATE_READY = 0,
+	TASK_STATE_BLOCKED,
+	TASK_STATE_DONE,
+};
+
+struct task_t;
+
+typedef int (*task_func_t)(struct task_t *task);
+
+// Counting event, can be signaled from IRQ handlers
+struct task_event_t {
+	volatile uint32_t count;
+};
+
+struct task_t {
+	task_func_t func;
+	void *ctx;
+	uint32_t lc;					// local continuation (line of the last blocking point)
+	enum task_state_t state;
+	struct task_event_t *event;		// event to wait for, NULL for sleep
+	uint64_t wake_at;				// STM time, 0 - no timeout
+	bool timed_out;					// result of the last TASK_WAIT_EVENT_TIMEOUT
+	struct task_t *next;
+};
+
+// Called when all tasks are blocked; next_wakeup is the nearest deadline or 0 if no task is sleeping
+typedef void (*task_idle_hook_t)(uint64_t next_wakeup);
+
+#define TASK_BEGIN(t) \
+	switch ((t)->lc) { case 0:
+
+#define TASK_END(t) \
+	} (t)->lc = 0; return TASK_EXITED
+
+#define _TASK_BLOCK_POINT(t, ret) \
+	(t)->lc = __LINE__; return (ret); case __LINE__:;
+
+#define TASK_YIELD(t) \
+	do { _TASK_BLOCK_POINT(t, TASK_YIELDED); } while (0)
+
+// Yields until condition is true
+#define TASK_WAIT_UNTIL(t, cond) \
+	do { (t)->lc = __LINE__; case __LINE__: if (!(cond)) return TASK_YIELDED; } while (0)
+
+#define TASK_SLEEP_UNTIL(t, stm_time) \
+	do { task_block((t), NULL, (stm_time)); _TASK_BLOCK_POINT(t, TASK_BLOCKED); } while (0)
+
+#define TASK_SLEEP_US(t, us) \
+	TASK_SLEEP_UNTIL(t, stopwatch_get() + stopwatch_us_to_ticks(us))
+
+#define TASK_SLEEP_MS(t, ms) \
+	TASK_SLEEP_US(t, (ms) * 1000)
+
+#define TASK_WAIT_EVENT(t, ev) \
+	do { task_block((t), (ev), 0); _TASK_BLOCK_POINT(t, TASK_BLOCKED); } while (0)
+
+// task->timed_out is set when event was not signaled in time
+#define TASK_WAIT_EVENT_TIMEOUT(t, ev, us) \
+	do { task_block((t), (ev), stopwatch_get() + stopwatch_us_to_ticks(us)); _TASK_BLOCK_POINT(t, TASK_BLOCKED); } while (0)
+
+#define TASK_EXIT(t) \
+	do { (t)->lc = 0; return TASK_EXITED; } while (0)
+
+void task_init(void);
+void task_set_idle_hook(task_idle_hook_t hook);
+
+// Adds task to the end of run queue, must not be called from IRQ
+void task_create(struct task_t *task, task_func_t func, void *ctx);
+
+// Run every ready task once, returns false when no tasks left
+bool task_run_once(void);
+
+// Run until all tasks exited
+void task_run(void);
+
+// Used by TASK_SLEEP_* and TASK_WAIT_* macros
+void task_block(struct task_t *task, struct task_event_t *event, uint64_t wake_at);
+
+static inline void task_event_init(struct task_event_t *event) {
+	event->count = 0;
+}
+
+// Safe to call from IRQ
+void task_event_signal(struct task_event_t *event);
@@ -0,0 +1,237 @@
+#include "timer.h"
+
+/*
+ * Software timers on top of one hardware timer.
+ * Deadlines are absolute STM times kept in a binary min-heap, GPTU0 T0 (A+B+C+D concatenated into 32 bit)
+ * counts up from -delta and raises SRC0 on T0D overflow, when the earliest timer expires.
+ */
+
+#define T0_RUN_ALL		(GPTU_T012RUN_T0ARUN | GPTU_T012RUN_T0BRUN | GPTU_T012RUN_T0CRUN | GPTU_T012RUN_T0DRUN)
+
+// T1 is used by lib/profiler.c
+#define T0_IRS_MASK		(GPTU_T01IRS_T0AINS | GPTU_T01IRS_T0BINS | GPTU_T01IRS_T0CINS | GPTU_T01IRS_T0DINS | \
+	GPTU_T01IRS_T0AREL | GPTU_T01IRS_T0BREL | GPTU_T01IRS_T0CREL | GPTU_T01IRS_T0DREL | GPTU_T01IRS_T0INC)
+
+// Don't program shorter intervals: IRQ entry is longer anyway
+#define TIMER_MIN_GPTU_TICKS	16
+
+#define TIMER_CALIBRATE_US		1000
+
+static struct timer_t *heap[TIMER_MAX_COUNT];
+static uint32_t heap_size;
+static uint32_t gptu_per_stm_mul;		// gptu_ticks = (stm_ticks * mul) >> 16
+
+static inline bool _is_before(const struct timer_t *a, const struct timer_t *b) {
+	return a->deadline < b->deadline;
+}
+
+static inline void _heap_set(uint32_t i, struct timer_t *timer) {
+	heap[i] = timer;
+	timer->index = i;
+}
+
+static void _heap_sift_up(uint32_t i) {
+	struct timer_t *timer = heap[i];
+	while (i > 0) {
+		uint32_t parent = (i - 1) / 2;
+		if (!_is_before(timer, heap[parent]))
+			break;
+		_heap_set(i, heap[parent]);
+		i = parent;
+	}
+	_heap_set(i, timer);
+}
+
+static void _heap_sift_down(uint32_t i) {
+	struct timer_t *timer = heap[i];
+	while (true) {
+		uint32_t child = i * 2 + 1;
+		if (child >= heap_size)
+			break;
+		if (child + 1 < heap_size && _is_before(heap[child + 1], heap[child]))
+			child++;
+		if (!_is_before(heap[child], timer))
+			break;
+		_heap_set(i, heap[child]);
+		i = child;
+	}
+	_heap_set(i, timer);
+}
+
+static bool _heap_insert(struct timer_t *timer) {
+	if (heap_size >= TIMER_MAX_COUNT)
+		return false;
+	heap[heap_size] = timer;
+	_heap_sift_up(heap_size++);
+	return true;
+}
+
+static void _heap_remove(struct timer_t *timer) {
+	uint32_t i = timer->index;
+	timer->index = -1;
+
+	if (--heap_size == i)
+		return;
+
+	heap[i] = heap[heap_size];
+	if (i > 0 && _is_before(heap[i], heap[(i - 1) / 2])) {
+		_heap_sift_up(i);
+	} else {
+		_heap_sift_down(i);
+	}
+}
+
+static void _hw_stop(void) {
+	GPTU_T012RUN(GPTU0) &= ~T0_RUN_ALL;
+	GPTU_SRC(GPTU0, 0) = MOD_SRC_SRE | MOD_SRC_CLRR;
+}
+
+static void _hw_start(uint32_t gptu_ticks) {
+	uint32_t value = -MAX(gptu_ticks, TIMER_MIN_GPTU_TICKS);
+	GPTU_T012RUN(GPTU0) &= ~T0_RUN_ALL;
+	GPTU_T0DCBA(GPTU0) = value;
+	GPTU_T0RDCBA(GPTU0) = value;
+	GPTU_SRC(GPTU0, 0) = MOD_SRC_SRE | MOD_SRC_CLRR;
+	GPTU_T012RUN(GPTU0) |= T0_RUN_ALL;
+}
+
+// Program hardware for the earliest deadline, called with IRQ disabled
+static void _hw_update(void) {
+	if (!heap_size) {
+		_hw_stop();
+		return;
+	}
+
+	stopwatch_t now = stopwatch_get();
+	stopwatch_t deadline = heap[0]->deadline;
+
+	// Longer intervals are handled by several GPTU overflows
+	uint32_t stm_ticks = deadline > now ? MIN(deadline - now, 0xFFFFFFFF) : 0;
+	uint64_t gptu_ticks = ((uint64_t) stm_ticks * gptu_per_stm_mul) >> 16;
+	_hw_start(MIN(gptu_ticks, 0xFFFFFFFF));
+}
+
+static void _calibrate(void) {
+	GPTU_T012RUN(GPTU0) &= ~T0_RUN_ALL;
+	GPTU_T0DCBA(GPTU0) = 0;
+	GPTU_T0RDCBA(GPTU0) = 0;
+
+	stopwatch_t start = stopwatch_get();
+	GPTU_T012RUN(GPTU0) |= T0_RUN_ALL;
+	stopwatch_usleep(TIMER_CALIBRATE_US);
+	uint32_t gptu_ticks = GPTU_T0DCBA(GPTU0);
+	uint32_t stm_ticks = stopwatch_elapsed(start);
+	GPTU_T012RUN(GPTU0) &= ~T0_RUN_ALL;
+
+	gptu_per_stm_mul = ((uint64_t) gptu_ticks << 16) / MAX(1, stm_ticks);
+}
+
+void timer_init(void) {
+	heap_size = 0;
+
+	GPTU_CLC(GPTU0) = (1 << MOD_CLC_RMC_SHIFT);
+
+	// D -> C -> B -> A, all stages are reloaded on T0D overflow
+	GPTU_T01IRS(GPTU0) = (GPTU_T01IRS(GPTU0) & ~T0_IRS_MASK) |
+		GPTU_T01IRS_T0BINS_CONCAT |
+		GPTU_T01IRS_T0CINS_CONCAT |
+		GPTU_T01IRS_T0DINS_CONCAT |
+		GPTU_T01IRS_T0AREL |
+		GPTU_T01IRS_T0BREL |
+		GPTU_T01IRS_T0CREL;
+
+	// T0D overflow -> SR00 -> SRC0
+	GPTU_T01OTS(GPTU0) = (GPTU_T01OTS(GPTU0) & ~GPTU_T01OTS_SSR00) | GPTU_T01OTS_SSR00_D;
+	GPTU_SRSEL(GPTU0) = (GPTU_SRSEL(GPTU0) & ~GPTU_SRSEL_SSR0) | GPTU_SRSEL_SSR0_SR00;
+
+	_calibrate();
+	_hw_stop();
+
+	NVIC_CON(NVIC_GPTU0_SRC0_IRQ) = 1;
+}
+
+void timer_update_clock(uint32_t old_freq, uint32_t new_freq) {
+	if (!gptu_per_stm_mul || !old_freq || old_freq == new_freq)
+		return;
+
+	bool irq_disabled = cpu_enable_irq(false);
+	gptu_per_stm_mul = ((uint64_t) gptu_per_stm_mul * new_freq) / old_freq;
+	if (heap_size > 0)
+		_hw_update();
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+void timer_setup(struct timer_t *timer, timer_callback_t callback, void *ctx) {
+	timer->callback = callback;
+	timer->ctx = ctx;
+	timer->period = 0;
+	timer->index = -1;
+}
+
+bool timer_start(struct timer_t *timer, uint32_t timeout_us, uint32_t period_us) {
+	bool irq_disabled = cpu_enable_irq(false);
+
+	if (timer_is_active(timer))
+		_heap_remove(timer);
+
+	timer->deadline = stopwatch_get() + stopwatch_us_to_ticks(timeout_us);
+	timer->period = period_us ? stopwatch_us_to_ticks(period_us) : 0;
+
+	bool success = _heap_insert(timer);
+	if (success && heap[0] == timer)
+		_hw_update();
+
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+
+	return success;
+}
+
+void timer_stop(struct timer_t *timer) {
+	bool irq_disabled = cpu_enable_irq(false);
+
+	if (timer_is_active(timer)) {
+		bool was_first = heap[0] == timer;
+		_heap_remove(timer);
+		if (was_first)
+			_hw_update();
+	}
+
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+void timer_irq(void) {
+	GPTU_SRC(GPTU0, 0) = MOD_SRC_SRE | MOD_SRC_CLRR;
+
+	// Heap can be modified by preempting IRQ handlers in nested mode
+	bool irq_disabled = cpu_enable_irq(false);
+
+	stopwatch_t now = stopwatch_get();
+	while (heap_size > 0 && heap[0]->deadline <= now) {
+		struct timer_t *timer = heap[0];
+		_heap_remove(timer);
+
+		// Re-arm before callback, so it can stop or restart the timer
+		if (timer->period) {
+			timer->deadline += timer->period;
+			// Missed periods are skipped, not replayed
+			if (timer->deadline <= now)
+				timer->deadline = now + timer->period;
+			_heap_insert(timer);
+		}
+
+		if (!irq_disabled)
+			cpu_enable_irq(true);
+		timer->callback(timer, timer->ctx);
+		cpu_enable_irq(false);
+
+		now = stopwatch_get();
+	}
+
+	_hw_update();
+
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <pmb887x.h>
+
+// Max number of simultaneously running software timers
+#define TIMER_MAX_COUNT		32
+
+struct timer_t;
+
+typedef void (*timer_callback_t)(struct timer_t *timer, void *ctx);
+
+struct timer_t {
+	uint64_t deadline;			// absolute STM time
+	uint64_t period;			// STM ticks, 0 for one-shot
+	timer_callback_t callback;
+	void *ctx;
+	int32_t index;				// position in the heap, -1 when stopped
+};
+
+// Takes GPTU0 T0 (A-D concatenated) and GPTU0 SRC0, must be called after stopwatch_init()
+void timer_init(void);
+
+// GPTU is clocked from fSYS, called by cpu_set_clock_profile()
+void timer_update_clock(uint32_t old_freq, uint32_t new_freq);
+
+// Timer must be initialized once with timer_setup() before the first start
+void timer_setup(struct timer_t *timer, timer_callback_t callback, void *ctx);
+
+// period_us = 0 - one-shot, otherwise timer is restarted every period_us after the first expiration
+bool timer_start(struct timer_t *timer, uint32_t timeout_us, uint32_t period_us);
+void timer_stop(struct timer_t *timer);
+
+static inline bool timer_is_active(const struct timer_t *timer) {
+	return timer->index >= 0;
+}
+
+// Must be called from NVIC_GPTU0_SRC0_IRQ; callbacks are executed from here
+void timer_irq(void);
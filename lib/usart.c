@@ -1,27 +1,285 @@
 #include "usart.h"
 
+#include <string.h>
+
+struct usart_tx_ring_t {
+	uint8_t *buffer;
+	uint32_t size;
+	volatile uint32_t head;		// free running write position
+	volatile uint32_t tail;		// free running read position
+};
+
+struct usart_rx_ring_t {
+	uint8_t *buffer;
+	uint32_t size;
+	volatile uint32_t head;		// free running write position (irq)
+	volatile uint32_t tail;		// free running read position
+	struct usart_rx_stat_t stat;
+};
+
+static struct usart_tx_ring_t usart_tx[2];
+static struct usart_rx_ring_t usart_rx[2];
+
+static struct usart_tx_ring_t *_get_tx_ring(uint32_t usart) {
+	return &usart_tx[usart == USART0 ? 0 : 1];
+}
+
+static struct usart_rx_ring_t *_get_rx_ring(uint32_t usart) {
+	return &usart_rx[usart == USART0 ? 0 : 1];
+}
+
+// Move bytes from ring to TX FIFO, must be called with IRQ disabled
+static void _tx_fill_fifo(uint32_t usart, struct usart_tx_ring_t *tx) {
+	uint32_t level = (USART_FSTAT(usart) & USART_FSTAT_TXFFL) >> USART_FSTAT_TXFFL_SHIFT;
+	uint32_t count = MIN(USART_FIFO_SIZE - MIN(level, USART_FIFO_SIZE), tx->head - tx->tail);
+	uint32_t tail = tx->tail;
+	
+	while (count--)
+		USART_TXB(usart) = tx->buffer[tail++ & (tx->size - 1)];
+	
+	tx->tail = tail;
+}
+
+static void _tx_kick(uint32_t usart, struct usart_tx_ring_t *tx) {
+	bool irq_disabled = cpu_enable_irq(false);
+	_tx_fill_fifo(usart, tx);
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+static void _putc_sync(uint32_t usart, char c) {
+	USART_TXB(usart) = c;
+	while (!(USART_RIS(usart) & USART_RIS_TX));
+	USART_ICR(usart) |= USART_ICR_TX;
+}
+
 void usart_set_speed(uint32_t usart, enum usart_speed_t speed) {
 	USART_BG(usart) = (speed >> 16) & 0xFFFF;
 	USART_FDV(usart) = speed & 0xFFFF;
 }
 
+void usart_update_clock(uint32_t usart, uint32_t old_freq, uint32_t new_freq) {
+	uint32_t bg = USART_BG(usart) & USART_BG_MAX;
+	
+	if (!old_freq || !new_freq || old_freq == new_freq)
+		return;
+	
+	if (!(USART_CON(usart) & USART_CON_FDE)) {
+		// baud = f / (prescaler * 16 * (BG + 1))
+		uint32_t div = ((uint64_t) (bg + 1) * new_freq + old_freq / 2) / old_freq;
+		USART_BG(usart) = MAX(1, MIN(div, USART_BG_MAX + 1)) - 1;
+		return;
+	}
+	
+	// baud = f * (FDV / 512) / (16 * (BG + 1)), FDV=0 is 512
+	// ratio = FDV / (BG + 1) must be scaled by old_freq / new_freq
+	uint32_t fdv = USART_FDV(usart) & 0x1FF;
+	uint64_t num = (uint64_t) (fdv ? fdv : 512) * old_freq;
+	uint64_t den = (uint64_t) (bg + 1) * new_freq;
+	
+	// Max BG + 1 which still gives FDV < 512 - best resolution of the fractional divider
+	uint32_t bg1 = MAX(1, MIN(511 * den / num, USART_BG_MAX + 1));
+	uint32_t new_fdv = (num * bg1 + den / 2) / den;
+	
+	USART_BG(usart) = bg1 - 1;
+	USART_FDV(usart) = new_fdv >= 512 ? 0 : new_fdv;
+}
+
 void usart_print(uint32_t usart, const char *data) {
-	while (*data)
-		usart_putc(usart, *data++);
+	usart_write(usart, data, strlen(data));
 }
 
 bool usart_has_byte(uint32_t usart) {
+	if (_get_rx_ring(usart)->buffer)
+		return usart_rx_available(usart) > 0;
 	return (USART_RIS(usart) & USART_RIS_RX) != 0;
 }
 
 void usart_putc(uint32_t usart, char c) {
-	USART_TXB(usart) = c;
-	while (!(USART_RIS(usart) & USART_RIS_TX));
-	USART_ICR(usart) |= USART_ICR_TX;
+	if (_get_tx_ring(usart)->buffer) {
+		usart_write(usart, &c, 1);
+	} else {
+		_putc_sync(usart, c);
+	}
 }
 
 char usart_getc(uint32_t usart) {
+	if (_get_rx_ring(usart)->buffer) {
+		char c;
+		while (!usart_read(usart, &c, 1, 0));
+		return c;
+	}
+	
 	while (!(USART_RIS(usart) & USART_RIS_RX));
 	USART_ICR(usart) |= USART_ICR_RX;
 	return USART_RXB(usart);
 }
+
+void usart_tx_init(uint32_t usart, uint8_t *buffer, uint32_t size) {
+	struct usart_tx_ring_t *tx = _get_tx_ring(usart);
+	
+	tx->buffer = NULL;
+	tx->size = size;
+	tx->head = 0;
+	tx->tail = 0;
+	
+	USART_TXFCON(usart) = USART_TXFCON_TXFEN | (USART_TX_FIFO_TRIGGER << USART_TXFCON_TXFITL_SHIFT);
+	USART_ICR(usart) = USART_ICR_TX;
+	USART_IMSC(usart) |= USART_IMSC_TX;
+	
+	NVIC_CON(usart == USART0 ? NVIC_USART0_TX_IRQ : NVIC_USART1_TX_IRQ) = 1;
+	
+	tx->buffer = buffer;
+}
+
+void usart_tx_irq(uint32_t usart) {
+	USART_ICR(usart) = USART_ICR_TX;
+	_tx_fill_fifo(usart, _get_tx_ring(usart));
+}
+
+void usart_write(uint32_t usart, const void *data, size_t len) {
+	struct usart_tx_ring_t *tx = _get_tx_ring(usart);
+	const uint8_t *src = data;
+	
+	if (!tx->buffer) {
+		while (len--)
+			_putc_sync(usart, *src++);
+		return;
+	}
+	
+	while (len > 0) {
+		bool irq_disabled = cpu_enable_irq(false);
+		
+		uint32_t free = tx->size - (tx->head - tx->tail);
+		if (free) {
+			uint32_t offset = tx->head & (tx->size - 1);
+			uint32_t chunk = MIN(MIN(len, free), tx->size - offset);
+			memcpy(tx->buffer + offset, src, chunk);
+			tx->head += chunk;
+			src += chunk;
+			len -= chunk;
+		} else {
+			// Ring is full: drain it by polling, works also with disabled IRQ
+			_tx_fill_fifo(usart, tx);
+		}
+		
+		if (!irq_disabled)
+			cpu_enable_irq(true);
+	}
+	
+	_tx_kick(usart, tx);
+}
+
+void usart_flush(uint32_t usart) {
+	struct usart_tx_ring_t *tx = _get_tx_ring(usart);
+	
+	if (tx->buffer) {
+		while (tx->head != tx->tail)
+			_tx_kick(usart, tx);
+		
+		while ((USART_FSTAT(usart) & USART_FSTAT_TXFFL));
+	}
+}
+
+void usart_rx_init(uint32_t usart, uint8_t *buffer, uint32_t size, uint32_t trigger_level, uint32_t timeout) {
+	struct usart_rx_ring_t *rx = _get_rx_ring(usart);
+	
+	rx->buffer = NULL;
+	rx->size = size;
+	rx->head = 0;
+	rx->tail = 0;
+	memset(&rx->stat, 0, sizeof(rx->stat));
+	
+	trigger_level = MAX(1, MIN(trigger_level, USART_FIFO_SIZE));
+	USART_RXFCON(usart) = USART_RXFCON_RXFEN | USART_RXFCON_RXFFLU | (trigger_level << USART_RXFCON_RXFITL_SHIFT);
+	USART_TMO(usart) = timeout;
+	
+	USART_WHBCON(usart) = USART_WHBCON_CLRPE | USART_WHBCON_CLRFE | USART_WHBCON_CLROE;
+	USART_CON(usart) |= USART_CON_FEN | USART_CON_OEN;
+	
+	USART_ICR(usart) = USART_ICR_RX | USART_ICR_TMO | USART_ICR_ERR;
+	USART_IMSC(usart) |= USART_IMSC_RX | USART_IMSC_TMO | USART_IMSC_ERR;
+	
+	rx->buffer = buffer;
+	
+	if (usart == USART0) {
+		NVIC_CON(NVIC_USART0_RX_IRQ) = 1;
+		NVIC_CON(NVIC_USART0_TMO_IRQ) = 1;
+		NVIC_CON(NVIC_USART0_ERR_IRQ) = 1;
+	} else {
+		NVIC_CON(NVIC_USART1_RX_IRQ) = 1;
+		NVIC_CON(NVIC_USART1_TMO_IRQ) = 1;
+		NVIC_CON(NVIC_USART1_ERR_IRQ) = 1;
+	}
+}
+
+void usart_rx_irq(uint32_t usart) {
+	struct usart_rx_ring_t *rx = _get_rx_ring(usart);
+	uint32_t status = USART_MIS(usart);
+	
+	if ((status & USART_MIS_ERR)) {
+		uint32_t con = USART_CON(usart);
+		if ((con & USART_CON_OE))
+			rx->stat.overrun++;
+		if ((con & USART_CON_FE))
+			rx->stat.framing++;
+		if ((con & USART_CON_PE))
+			rx->stat.parity++;
+		USART_WHBCON(usart) = USART_WHBCON_CLRPE | USART_WHBCON_CLRFE | USART_WHBCON_CLROE;
+	}
+	
+	// Drain FIFO
+	uint32_t head = rx->head;
+	uint32_t level;
+	while ((level = (USART_FSTAT(usart) & USART_FSTAT_RXFFL) >> USART_FSTAT_RXFFL_SHIFT)) {
+		while (level--) {
+			uint8_t c = USART_RXB(usart);
+			if (head - rx->tail < rx->size) {
+				rx->buffer[head++ & (rx->size - 1)] = c;
+			} else {
+				rx->stat.dropped++;
+			}
+		}
+	}
+	rx->head = head;
+	
+	USART_ICR(usart) = status & (USART_ICR_RX | USART_ICR_TMO | USART_ICR_ERR);
+}
+
+size_t usart_rx_available(uint32_t usart) {
+	struct usart_rx_ring_t *rx = _get_rx_ring(usart);
+	return rx->head - rx->tail;
+}
+
+size_t usart_read(uint32_t usart, void *data, size_t len, uint32_t timeout_ms) {
+	struct usart_rx_ring_t *rx = _get_rx_ring(usart);
+	uint8_t *dst = data;
+	size_t done = 0;
+	stopwatch_t start = stopwatch_get();
+	
+	while (done < len) {
+		uint32_t tail = rx->tail;
+		uint32_t avail = rx->head - tail;
+		
+		if (!avail) {
+			if (stopwatch_elapsed_ms(start) >= timeout_ms)
+				break;
+			continue;
+		}
+		
+		uint32_t offset = tail & (rx->size - 1);
+		uint32_t chunk = MIN(MIN(len - done, avail), rx->size - offset);
+		memcpy(dst + done, rx->buffer + offset, chunk);
+		rx->tail = tail + chunk;
+		done += chunk;
+	}
+	
+	return done;
+}
+
+void usart_rx_get_stat(uint32_t usart, struct usart_rx_stat_t *stat) {
+	bool irq_disabled = cpu_enable_irq(false);
+	*stat = _get_rx_ring(usart)->stat;
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
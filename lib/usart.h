@@ -15,9 +15,36 @@ enum usart_speed_t {
 	UART_SPEED_1500000 = 0x000001d0
 };
 
+#define USART_FIFO_SIZE			8
+#define USART_BG_MAX			0x1FFF
+#define USART_TX_FIFO_TRIGGER	4
+
+struct usart_rx_stat_t {
+	uint32_t overrun;		// hardware FIFO overrun
+	uint32_t framing;
+	uint32_t parity;
+	uint32_t dropped;		// bytes lost because ring buffer was full
+};
+
 // UART
 void usart_set_speed(uint32_t usart, enum usart_speed_t speed);
+// Keep the same baudrate after module clock change (BG/FDV are recomputed)
+void usart_update_clock(uint32_t usart, uint32_t old_freq, uint32_t new_freq);
 void usart_putc(uint32_t usart, char c);
 char usart_getc(uint32_t usart);
 void usart_print(uint32_t usart, const char *data);
 bool usart_has_byte(uint32_t usart);
+
+// Buffered TX (size must be power of 2), usart_tx_irq() must be called from NVIC_USARTx_TX_IRQ
+void usart_tx_init(uint32_t usart, uint8_t *buffer, uint32_t size);
+void usart_tx_irq(uint32_t usart);
+void usart_write(uint32_t usart, const void *data, size_t len);
+void usart_flush(uint32_t usart);
+
+// Buffered RX (size must be power of 2), usart_rx_irq() must be called from NVIC_USARTx_RX_IRQ, NVIC_USARTx_TMO_IRQ, NVIC_USARTx_ERR_IRQ
+// trigger_level - RX FIFO level for RX irq (1..USART_FIFO_SIZE), timeout - USART_TMO value for flushing a partially filled FIFO
+void usart_rx_init(uint32_t usart, uint8_t *buffer, uint32_t size, uint32_t trigger_level, uint32_t timeout);
+void usart_rx_irq(uint32_t usart);
+size_t usart_read(uint32_t usart, void *data, size_t len, uint32_t timeout_ms);
+size_t usart_rx_available(uint32_t usart);
+void usart_rx_get_stat(uint32_t usart, struct usart_rx_stat_t *stat);
@@ -1,11 +1,13 @@
 #include "wdt.h"
 
-static stopwatch_t start_execution = 0;
-static uint32_t wdt_timeout = 0;
+static stopwatch_t execution_deadline = 0;		// 0 - no limit
 
-static stopwatch_t last_wdt_serve = 0;
+static stopwatch_t next_wdt_serve = 0;
 static uint32_t wdt_interval = 0;
 
+static struct timer_t wdt_timer;
+static bool wdt_background = false;
+
 static void _set_einit(bool flag) {
 	uint32_t tmp = (((SCU_WDTCON0 & ~0x0E) | 0xf0));
 	tmp |= (SCU_WDTCON1 & 0x0c);
@@ -18,8 +20,12 @@ void wdt_init() {
 }
 
 void wdt_set_max_execution_time(uint32_t ms) {
-	start_execution = stopwatch_get();
-	wdt_timeout = ms;
+	execution_deadline = ms ? stopwatch_get() + (stopwatch_t) stopwatch_ticks_per_ms() * ms : 0;
+}
+
+// Deadline is precomputed, so wdt_serve() is one 64-bit compare when nothing is due
+static inline void _update_next_serve(stopwatch_t last) {
+	next_wdt_serve = last + (stopwatch_t) stopwatch_ticks_per_ms() * wdt_interval;
 }
 
 void wdt_init_custom(uint32_t interval) {
@@ -30,7 +36,7 @@ void wdt_init_custom(uint32_t interval) {
 	// Init external watchdog gpio (dialog)
 	#ifdef BOOT_EXTRAM
 		extern uint32_t _last_wdt_serve_from_boot;
-		last_wdt_serve = _last_wdt_serve_from_boot << 16;
+		_update_next_serve(_last_wdt_serve_from_boot << 16);
 		wdt_serve();
 	#else
 		// Disable internal watchdog (CPU)
@@ -39,17 +45,54 @@ void wdt_init_custom(uint32_t interval) {
 		_set_einit(1);
 		
 		GPIO_PIN(GPIO_PM_WADOG) = GPIO_PS_MANUAL | GPIO_DIR_OUT | GPIO_DATA_HIGH;
-		last_wdt_serve = stopwatch_get();
+		_update_next_serve(stopwatch_get());
 	#endif
 }
 
+static void _serve(stopwatch_t now) {
+	if (execution_deadline && now >= execution_deadline)
+		return;
+	
+	gpio_toggle(GPIO_PM_WADOG);
+	_update_next_serve(now);
+}
+
 void wdt_serve(void) {
-	if (stopwatch_elapsed_ms(last_wdt_serve) < wdt_interval)
+	// Served from timer IRQ
+	if (wdt_background)
 		return;
 	
-	if (wdt_timeout && stopwatch_elapsed_ms(start_execution) >= wdt_timeout)
+	stopwatch_t now = stopwatch_get();
+	if (now < next_wdt_serve)
 		return;
 	
-	gpio_toggle(GPIO_PM_WADOG);
-	last_wdt_serve = stopwatch_get();
+	_serve(now);
+}
+
+static void _wdt_timer_callback(struct timer_t *timer, void *ctx) {
+	(void) timer;
+	(void) ctx;
+	_serve(stopwatch_get());
+}
+
+void wdt_start_background(void) {
+	bool irq_disabled = cpu_enable_irq(false);
+	
+	wdt_background = true;
+	timer_setup(&wdt_timer, _wdt_timer_callback, NULL);
+	
+	// First toggle at the same time, as wdt_serve() would do it
+	stopwatch_t now = stopwatch_get();
+	uint32_t first_us = now < next_wdt_serve ? (uint32_t) (next_wdt_serve - now) / stopwatch_ticks_per_us() : 0;
+	timer_start(&wdt_timer, first_us, wdt_interval * 1000);
+	
+	if (!irq_disabled)
+		cpu_enable_irq(true);
+}
+
+void wdt_stop_background(void) {
+	if (!wdt_background)
+		return;
+	timer_stop(&wdt_timer);
+	wdt_background = false;
 }
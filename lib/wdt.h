@@ -6,3 +6,10 @@ void wdt_init(void);
 void wdt_init_custom(uint32_t interval);
 void wdt_serve(void);
 void wdt_set_max_execution_time(uint32_t ms);
+
+/*
+ * Watchdog is served from software timer (lib/timer.c), wdt_serve() becomes no-op.
+ * Requires timer_init() and timer_irq() called from NVIC_GPTU0_SRC0_IRQ; max execution time is still respected.
+ */
+void wdt_start_background(void);
+void wdt_stop_background(void);
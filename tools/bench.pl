@@ -0,0 +1,172 @@
+#!/usr/bin/env perl
+use warnings;
+use strict;
+use File::Slurp qw(read_file write_file);
+use Getopt::Long;
+use JSON::PP;
+
+# Host side of lib/bench.c: collects JSON lines from the device and compares result files
+
+$| = 1;
+
+my $json = JSON::PP->new->canonical;
+
+my %options = (
+	out		=> "",
+	input	=> "",
+	label	=> "",
+	metric	=> "median_ns",
+);
+
+my $cmd = shift @ARGV // "";
+
+GetOptions(
+	"out=s"		=> \$options{out},
+	"input=s"	=> \$options{input},
+	"label=s"	=> \$options{label},
+	"metric=s"	=> \$options{metric},
+);
+
+if ($cmd eq "run") {
+	die "--out is required\n" if !$options{out};
+	die "Command or --input is required\n" if !@ARGV && !$options{input};
+	my $records = $options{input} ? readCapture($options{input}) : runCommand(@ARGV);
+	writeResults($options{out}, $records);
+} elsif ($cmd eq "compare") {
+	die "Two or more result files are required\n" if @ARGV < 2;
+	compareResults(@ARGV);
+} else {
+	print "usage:\n";
+	print "  $0 run --out results.jsonl [--label name] -- ./run.sh [args]\n";
+	print "  $0 run --out results.jsonl [--label name] --input serial.log\n";
+	print "  $0 compare [--metric median_ns] base.jsonl new.jsonl [...]\n";
+	exit(1);
+}
+
+sub parseLine {
+	my ($line, $records) = @_;
+
+	# Console can have garbage before the record
+	return 0 if $line !~ /(\{"type":.*\})\s*$/;
+
+	my $record = eval { $json->decode($1) };
+	return 0 if !$record;
+
+	push @$records, $record;
+	return $record->{type} eq "end";
+}
+
+sub readCapture {
+	my ($file) = @_;
+
+	my @records;
+	for my $line (split(/\r?\n/, read_file($file, { binmode => ':raw' }))) {
+		# Last run in the capture wins
+		@records = () if $line =~ /"type":"env"/;
+		last if parseLine($line, \@records);
+	}
+
+	die "No benchmark results in $file\n" if !@records;
+	return \@records;
+}
+
+sub runCommand {
+	my @command = @_;
+
+	my @records;
+	my $pid = open(my $fp, "-|", @command) or die "Can't run @command: $!\n";
+	while (my $line = <$fp>) {
+		print $line;
+		$line =~ s/\r?\n$//;
+		last if parseLine($line, \@records);
+	}
+	kill('TERM', $pid);
+	close($fp);
+
+	die "No benchmark results from @command\n" if !@records;
+	return \@records;
+}
+
+sub gitRevision {
+	my $rev = `git rev-parse --short HEAD 2>/dev/null` // "";
+	chomp($rev);
+	return "" if !$rev;
+
+	my $dirty = `git status --porcelain --untracked-files=no 2>/dev/null` // "";
+	return $dirty ne "" ? "$rev-dirty" : $rev;
+}
+
+sub writeResults {
+	my ($file, $records) = @_;
+
+	my ($env) = grep { $_->{type} eq "env" } @$records;
+	warn "Warning: no env record, device output is incomplete\n" if !$env;
+	warn "Warning: no end record, device output is incomplete\n" if !grep { $_->{type} eq "end" } @$records;
+
+	if ($env) {
+		$env->{git} = gitRevision();
+		$env->{label} = $options{label} if $options{label};
+		$env->{time} = time();
+	}
+
+	write_file($file, join("", map { $json->encode($_)."\n" } @$records));
+	printf("%d results written to %s\n", scalar(grep { $_->{type} eq "bench" } @$records), $file);
+}
+
+sub readResults {
+	my ($file) = @_;
+
+	my %result = (env => {}, bench => {}, order => []);
+	for my $line (split(/\n/, read_file($file))) {
+		my $record = $json->decode($line);
+		if ($record->{type} eq "env") {
+			$result{env} = $record;
+		} elsif ($record->{type} eq "bench") {
+			push @{$result{order}}, $record->{name} if !exists $result{bench}->{$record->{name}};
+			$result{bench}->{$record->{name}} = $record;
+		}
+	}
+	return \%result;
+}
+
+sub compareResults {
+	my @files = @_;
+
+	my @results = map { readResults($_) } @files;
+	my $base = $results[0];
+
+	for (my $i = 0; $i < @files; $i++) {
+		my $env = $results[$i]->{env};
+		printf("[%d] %s: %s, %s, cpu %d MHz, cache %d%s\n", $i, $files[$i], $env->{git} // "?", $env->{boot} // "?",
+			($env->{cpu_hz} // 0) / 1000000, $env->{cache} // 0, $env->{label} ? ", $env->{label}" : "");
+	}
+
+	print "\n";
+	printf("%-24s", $options{metric});
+	printf(" %18s", "[$_]") for 0..$#files;
+	print "\n";
+
+	# Cases from all files, in the order of the first appearance
+	my %seen;
+	my @names = grep { !$seen{$_}++ } map { @{$_->{order}} } @results;
+
+	for my $name (@names) {
+		printf("%-24s", $name);
+		my $base_value = $base->{bench}->{$name} ? $base->{bench}->{$name}->{$options{metric}} : undef;
+		for my $result (@results) {
+			my $bench = $result->{bench}->{$name};
+			if (!$bench || !defined $bench->{$options{metric}}) {
+				printf(" %18s", "-");
+				next;
+			}
+
+			my $value = $bench->{$options{metric}};
+			if ($result == $base || !$base_value) {
+				printf(" %18.2f", $value);
+			} else {
+				printf(" %9.2f (%+5.1f%%)", $value, ($value - $base_value) * 100 / $base_value);
+			}
+		}
+		print "\n";
+	}
+}
@@ -0,0 +1,265 @@
+#!/usr/bin/env perl
+use warnings;
+use strict;
+use File::Basename;
+use File::Slurp qw(read_file);
+use Getopt::Long;
+use lib dirname(__FILE__).'/lib';
+use Sie::SerialPort;
+
+# Decoder for lib/log.c records: format strings are taken from the .log_fmt section of the .elf
+
+$| = 1;
+
+my $LOG_RECORD_MARKER = 0xFE;
+my $LOG_ARG_BITS = 3;
+my $LOG_FORMAT_VERSION = 1;
+
+my %ARG_TYPES = (
+	1	=> "u32",
+	2	=> "i32",
+	3	=> "u64",
+	4	=> "i64",
+	5	=> "str",
+);
+
+my %options = (
+	elf			=> "",
+	input		=> "",
+	device		=> "",
+	speed		=> 1600000,
+	timestamps	=> 1,
+);
+
+GetOptions(
+	"elf=s"			=> \$options{elf},
+	"input=s"		=> \$options{input},
+	"device=s"		=> \$options{device},
+	"speed=i"		=> \$options{speed},
+	"timestamps!"	=> \$options{timestamps},
+);
+
+if (!$options{elf}) {
+	print "usage: $0 --elf app.elf [--input serial.log | --device /dev/ttyUSB0 [--speed 1600000]] [--no-timestamps]\n";
+	print "  without --input and --device reads stdin, e.g. ./run.sh | $0 --elf app.elf\n";
+	exit(1);
+}
+
+my $formats = readFormats($options{elf});
+
+my %state = (
+	stm_hz		=> 0,
+	ticks		=> undef,
+	line_start	=> 1,
+);
+
+my $buffer = "";
+if ($options{device}) {
+	my $serial = Sie::SerialPort->new($options{device});
+	$serial->setSpeed($options{speed});
+	while (1) {
+		$buffer .= $serial->readChunk(4096, 100);
+		$buffer = decode($buffer, 0);
+	}
+} elsif ($options{input}) {
+	decode(scalar(read_file($options{input}, { binmode => ':raw' })), 1);
+} else {
+	binmode(STDIN);
+	while (sysread(STDIN, my $chunk, 4096)) {
+		$buffer = decode($buffer.$chunk, 0);
+	}
+	decode($buffer, 1);
+}
+
+# Returns the unprocessed tail: incomplete record at the end of the chunk
+sub decode {
+	my ($data, $eof) = @_;
+
+	my $marker = chr($LOG_RECORD_MARKER);
+	my $pos = 0;
+	while ($pos < length($data)) {
+		my $next = index($data, $marker, $pos);
+		if ($next < 0) {
+			printText(substr($data, $pos));
+			return "";
+		}
+
+		printText(substr($data, $pos, $next - $pos)) if $next > $pos;
+
+		my ($size, $text) = decodeRecord($data, $next + 1);
+		if (!defined $size) {
+			return substr($data, $next) if !$eof;
+			printText("[log: truncated record]\n");
+			return "";
+		}
+
+		if (!defined $text) {
+			# Not a known record, show the marker byte as is and resync on the next one
+			printText($marker);
+			$pos = $next + 1;
+			next;
+		}
+
+		printText($text);
+		$pos = $next + 1 + $size;
+	}
+	return "";
+}
+
+sub printText {
+	my ($text) = @_;
+
+	if (!$options{timestamps} || !defined $state{ticks}) {
+		print $text;
+		return;
+	}
+
+	# Timestamp of the last record at the start of each line
+	my $prefix = $state{stm_hz} ? sprintf("[%12.6f] ", $state{ticks} / $state{stm_hz}) : sprintf("[%12d] ", $state{ticks});
+	for my $line (split(/(?<=\n)/, $text)) {
+		print $prefix if $state{line_start};
+		print $line;
+		$state{line_start} = substr($line, -1) eq "\n";
+	}
+}
+
+# Returns (size, text), size is undef when more data is needed, text is undef for an invalid record
+sub decodeRecord {
+	my ($data, $start) = @_;
+
+	my $pos = $start;
+	my $header = readVarint($data, \$pos);
+	return if !defined $header;
+
+	my $id = $header >> 1;
+	my $entry = $formats->{$id};
+	return (0, undef) if !$entry;
+
+	my $delta;
+	if ($header & 1) {
+		$delta = readVarint($data, \$pos);
+		return if !defined $delta;
+	}
+
+	my @args;
+	for my $type (@{$entry->{types}}) {
+		my $value;
+		if ($type eq "str") {
+			my $len = readVarint($data, \$pos);
+			return if !defined $len;
+			return if $pos + $len > length($data);
+			$value = substr($data, $pos, $len);
+			$pos += $len;
+		} else {
+			$value = readVarint($data, \$pos);
+			return if !defined $value;
+			$value = $value & 1 ? -($value >> 1) - 1 : $value >> 1 if $type eq "i32" || $type eq "i64";
+		}
+		push @args, $value;
+	}
+
+	if ($id == 0) {
+		# Header from log_init(): STM frequency, format version, absolute STM value
+		my ($stm_hz, $version) = @args;
+		warn "Unsupported log format: v$version\n" if $version != $LOG_FORMAT_VERSION;
+		$state{stm_hz} = $stm_hz;
+		$state{ticks} = $delta;
+		$state{line_start} = 1;
+	} elsif (defined $delta) {
+		$state{ticks} = ($state{ticks} // 0) + $delta;
+	}
+
+	return ($pos - $start, render($entry, \@args));
+}
+
+sub readVarint {
+	my ($data, $pos) = @_;
+
+	my $value = 0;
+	my $shift = 0;
+	while ($$pos < length($data)) {
+		my $byte = ord(substr($data, $$pos++, 1));
+		$value |= ($byte & 0x7F) << $shift;
+		return $value if !($byte & 0x80);
+		$shift += 7;
+		return 0 if $shift > 63;
+	}
+	return undef;
+}
+
+# Same conversions as lib/printf.c
+sub render {
+	my ($entry, $args) = @_;
+
+	my @args = @$args;
+	my $fmt = $entry->{fmt};
+	$fmt =~ s{%([0-9]*)(l{0,2})([diuxXocsp%])}{
+		my ($width, $length, $conv) = ($1, $2, $3);
+		if ($conv eq "%") {
+			"%";
+		} else {
+			renderArg($width, $length eq "ll" ? 64 : 32, $conv, shift @args);
+		}
+	}ge;
+	return $fmt;
+}
+
+sub renderArg {
+	my ($width, $bits, $conv, $value) = @_;
+
+	return "[missing]" if !defined $value;
+	return sprintf("%${width}s", $value) if $conv eq "s";
+	return chr($value & 0xFF) if $conv eq "c";
+	return sprintf("0x%08X", $value & 0xFFFFFFFF) if $conv eq "p";
+
+	# Reinterpret as the C code would: unsigned arg with %d, negative arg with %x/%u
+	my ($signed, $unsigned) = $bits == 64 ? ("q", "Q") : ("l", "L");
+	$value = unpack($conv eq "d" || $conv eq "i" ? $signed : $unsigned, pack($unsigned, $value & ($bits == 64 ? ~0 : 0xFFFFFFFF)));
+	return sprintf("%${width}".($conv eq "i" ? "d" : $conv), $value);
+}
+
+sub readFormats {
+	my ($file) = @_;
+
+	my $elf = read_file($file, { binmode => ':raw' });
+	die "$file: not an ELF32 LE file\n" if substr($elf, 0, 6) ne "\x7FELF\x01\x01";
+
+	my ($shoff, $shentsize, $shnum, $shstrndx) = unpack("x32 V x10 v v v", $elf);
+	my @sections;
+	for (my $i = 0; $i < $shnum; $i++) {
+		my %section;
+		@section{qw(name type flags addr offset size)} = unpack("V V V V V V", substr($elf, $shoff + $i * $shentsize, 24));
+		push @sections, \%section;
+	}
+
+	my $strtab = $sections[$shstrndx];
+	my ($section) = grep {
+		unpack("Z*", substr($elf, $strtab->{offset} + $_->{name}, 64)) eq ".log_fmt"
+	} @sections;
+	die "$file: no .log_fmt section, LOG() is not used or the ld script is too old\n" if !$section;
+
+	my $data = substr($elf, $section->{offset}, $section->{size});
+	my %formats;
+	my $pos = 0;
+	while ($pos + 4 < length($data)) {
+		my ($types, $fmt) = unpack("V Z*", substr($data, $pos));
+
+		# Alignment padding
+		if (!$types && $fmt eq "") {
+			$pos += 4;
+			next;
+		}
+
+		my @types;
+		for (; $types; $types >>= $LOG_ARG_BITS) {
+			my $type = $ARG_TYPES{$types & ((1 << $LOG_ARG_BITS) - 1)} or die sprintf("$file: invalid arg type at 0x%X\n", $pos);
+			push @types, $type;
+		}
+		$formats{$pos / 4} = { fmt => $fmt, types => \@types };
+
+		# Entries are 4 byte aligned
+		$pos += (4 + length($fmt) + 1 + 3) & ~3;
+	}
+
+	return \%formats;
+}
@@ -0,0 +1,201 @@
+#!/usr/bin/env perl
+use warnings;
+use strict;
+use File::Slurp qw(read_file write_file);
+use Getopt::Long;
+
+# Decoder for lib/profiler.c dumps: flat profile and folded stacks (flamegraph.pl, speedscope)
+
+my $PROFILER_MAGIC = 0x464F5250;
+my $PROFILER_FLAG_LR = 1 << 0;
+my $HEADER_SIZE = 28;
+
+my %options = (
+	elf		=> "",
+	input	=> "",
+	folded	=> "",
+	top		=> 30,
+	lines	=> 0,
+	prefix	=> $ENV{PREFIX} // "arm-none-eabi-",
+);
+
+GetOptions(
+	"elf=s"		=> \$options{elf},
+	"input=s"	=> \$options{input},
+	"folded=s"	=> \$options{folded},
+	"top=i"		=> \$options{top},
+	"lines"		=> \$options{lines},
+	"prefix=s"	=> \$options{prefix},
+);
+
+if (!$options{elf} || !$options{input}) {
+	print "usage: $0 --elf app.elf --input serial.log [--folded app.folded] [--top N] [--lines] [--prefix arm-none-eabi-]\n";
+	print "  --input   raw serial capture with profiler_dump() output (last dump is used)\n";
+	print "  --folded  write folded stacks, caller;callee when dump has LR\n";
+	print "  --lines   flat profile by source line (addr2line)\n";
+	exit(1);
+}
+
+my $dump = readDump($options{input});
+my $symbols = readSymbols($options{elf});
+
+my $header = $dump->{header};
+printf("samples: %d, lost: %d, duration: %d ms, rate: %d Hz (effective %d Hz)\n",
+	$header->{count}, $header->{lost}, $header->{duration_us} / 1000, $header->{rate},
+	$header->{duration_us} ? ($header->{count} + $header->{lost}) * 1000000 / $header->{duration_us} : 0);
+
+exit(0) if !$header->{count};
+
+my %by_func;
+my %folded;
+for my $sample (@{$dump->{samples}}) {
+	my $func = symbolName($symbols, $sample->{pc});
+	$by_func{$func}++;
+
+	my $stack = $func;
+	if (defined $sample->{lr}) {
+		# LR is the return address, the call instruction is before it; LR can also hold garbage
+		my $caller = findSymbol($symbols, ($sample->{lr} & ~1) - 4);
+		$stack = "$caller;$func" if defined $caller && $caller ne $func;
+	}
+	$folded{$stack}++;
+}
+
+printFlat("function", \%by_func, $header->{count});
+
+if ($options{lines}) {
+	my %by_pc;
+	$by_pc{$_->{pc}}++ for @{$dump->{samples}};
+
+	my $lines = addr2line($options{elf}, [sort { $a <=> $b } keys %by_pc]);
+	my %by_line;
+	for my $pc (keys %by_pc) {
+		$by_line{$lines->{$pc}} += $by_pc{$pc};
+	}
+	printFlat("line", \%by_line, $header->{count});
+}
+
+if ($options{folded}) {
+	my $out = "";
+	$out .= "$_ $folded{$_}\n" for sort keys %folded;
+	write_file($options{folded}, $out);
+	print "\nFolded stacks written to $options{folded}\n";
+}
+
+sub printFlat {
+	my ($title, $counts, $total) = @_;
+
+	print "\n";
+	printf("%7s %8s  %s\n", "%", "samples", $title);
+
+	my @keys = sort { $counts->{$b} <=> $counts->{$a} || $a cmp $b } keys %$counts;
+	splice(@keys, $options{top}) if $options{top} > 0 && @keys > $options{top};
+
+	for my $key (@keys) {
+		printf("%6.2f%% %8d  %s\n", $counts->{$key} * 100 / $total, $counts->{$key}, $key);
+	}
+}
+
+sub readDump {
+	my ($file) = @_;
+
+	my $raw = read_file($file, { binmode => ':raw' });
+
+	my $pos = rindex($raw, "\nPROFILE ");
+	die "Profiler dump not found in $file\n" if $pos < 0;
+
+	my ($size) = substr($raw, $pos + 9, 16) =~ /^(\d+)\r?\n/ or die "Invalid dump marker\n";
+	my $data_start = index($raw, "\n", $pos + 1) + 1;
+	my $data = substr($raw, $data_start, $size);
+	die sprintf("Truncated dump: %d of %d bytes\n", length($data), $size) if length($data) < $size;
+
+	my %header;
+	@header{qw(magic version flags rate duration_us count lost checksum)} = unpack("V v v V V V V V", $data);
+	die sprintf("Invalid magic: %08X\n", $header{magic}) if $header{magic} != $PROFILER_MAGIC;
+	die "Unsupported version: $header{version}\n" if $header{version} != 1;
+
+	my @words = unpack("V*", substr($data, $HEADER_SIZE));
+	my $checksum = 0;
+	$checksum = ($checksum + $_) & 0xFFFFFFFF for @words;
+	die sprintf("Checksum mismatch: %08X != %08X\n", $checksum, $header{checksum}) if $checksum != $header{checksum};
+
+	my $with_lr = ($header{flags} & $PROFILER_FLAG_LR) != 0;
+	my @samples;
+	while (@words) {
+		my $pc = shift @words;
+		my $lr = $with_lr ? shift @words : undef;
+		push @samples, { pc => $pc, lr => $lr };
+	}
+
+	return { header => \%header, samples => \@samples };
+}
+
+sub readSymbols {
+	my ($elf) = @_;
+
+	my @symbols;
+	open(my $fp, "-|", $options{prefix}."nm", "-n", "-S", "-C", "--defined-only", $elf) or die "nm: $!\n";
+	while (my $line = <$fp>) {
+		# address [size] type name
+		next if $line !~ /^([0-9a-f]+)\s+(?:([0-9a-f]+)\s+)?([tTwW])\s+(.+?)\s*$/i;
+		push @symbols, { addr => hex($1), size => defined $2 ? hex($2) : 0, name => $4 };
+	}
+	close($fp);
+	die "No symbols in $elf\n" if !@symbols;
+
+	# Symbols without size end at the next one
+	for (my $i = 0; $i < @symbols; $i++) {
+		next if $symbols[$i]->{size};
+		my $next = $i + 1 < @symbols ? $symbols[$i + 1]->{addr} : $symbols[$i]->{addr} + 4;
+		$symbols[$i]->{size} = $next - $symbols[$i]->{addr};
+	}
+
+	return \@symbols;
+}
+
+sub symbolName {
+	my ($symbols, $addr) = @_;
+	return findSymbol($symbols, $addr) // sprintf("0x%08X", $addr);
+}
+
+sub findSymbol {
+	my ($symbols, $addr) = @_;
+
+	my ($lo, $hi) = (0, scalar(@$symbols) - 1);
+	my $found;
+	while ($lo <= $hi) {
+		my $mid = int(($lo + $hi) / 2);
+		if ($symbols->[$mid]->{addr} <= $addr) {
+			$found = $mid;
+			$lo = $mid + 1;
+		} else {
+			$hi = $mid - 1;
+		}
+	}
+
+	return undef if !defined $found;
+
+	my $sym = $symbols->[$found];
+	return undef if $addr >= $sym->{addr} + $sym->{size};
+	return $sym->{name};
+}
+
+sub addr2line {
+	my ($elf, $addrs) = @_;
+
+	my %lines;
+	my @args = ($options{prefix}."addr2line", "-e", $elf, "-f", "-C", "-s");
+	while (my @chunk = splice(@$addrs, 0, 1000)) {
+		open(my $fp, "-|", @args, map { sprintf("0x%X", $_) } @chunk) or die "addr2line: $!\n";
+		for my $addr (@chunk) {
+			my $func = <$fp> // "??";
+			my $line = <$fp> // "??:0";
+			chomp($func, $line);
+			$line =~ s/\s*\(discriminator \d+\)//;
+			$lines{$addr} = "$line ($func)";
+		}
+		close($fp);
+	}
+
+	return \%lines;
+}